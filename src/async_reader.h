@@ -0,0 +1,495 @@
+#ifndef ASYNC_READER_H_
+#define ASYNC_READER_H_
+
+#include "span.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#if defined(__linux__)
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#endif
+
+// Reads a file front to back in large blocks while the caller works on the previous ones.
+//
+// A fixed pool of aligned buffers cycles between the reader and the caller: queue_depth blocks are in flight, and when
+// next() hands out block N the buffer of block N - 1 is reused for block N - 1 + queue_depth. On Linux the reads go
+// through io_uring (raw system calls, liburing is not needed), elsewhere or when io_uring is not available a few
+// threads issue positional reads. The caller parses and voxelizes one block while the following ones are read, so a
+// load takes about the longer of the two instead of their sum.
+namespace async_reader {
+
+static const size_t Default_Block_Size  = size_t(16) << 20;
+static const size_t Default_Queue_Depth = 4;
+// O_DIRECT needs the buffers, offsets and sizes aligned to the logical block size of the device
+static const size_t Alignment = 4096;
+
+enum class Backend { Auto, IoUring, Pread };
+
+static const char *backend_name(Backend backend) { return backend == Backend::IoUring ? "io_uring" : "pread"; }
+
+static char *allocate_aligned(size_t size)
+{
+#if defined(_WIN32)
+    return static_cast<char *>(_aligned_malloc(size, Alignment));
+#else
+    return static_cast<char *>(std::aligned_alloc(Alignment, size));
+#endif
+}
+
+static void free_aligned(char *buffer)
+{
+#if defined(_WIN32)
+    _aligned_free(buffer);
+#else
+    std::free(buffer);
+#endif
+}
+
+#if defined(__linux__)
+// Submission and completion rings of an io_uring instance, used from a single thread
+class Ring
+{
+public:
+    Ring() = default;
+    ~Ring() { close(); }
+
+    Ring(const Ring &)            = delete;
+    Ring &operator=(const Ring &) = delete;
+
+    bool open(unsigned int entries)
+    {
+        io_uring_params params{};
+        m_fd = int(syscall(__NR_io_uring_setup, entries, &params));
+        if (m_fd < 0)
+            return false;
+
+        m_sq_size         = params.sq_off.array + params.sq_entries * sizeof(unsigned int);
+        m_cq_size         = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        const bool single = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+        if (single)
+            m_sq_size = m_cq_size = std::max(m_sq_size, m_cq_size);
+        m_sq = map(m_sq_size, IORING_OFF_SQ_RING);
+        m_cq = single ? m_sq : map(m_cq_size, IORING_OFF_CQ_RING);
+        m_sqes_size = params.sq_entries * sizeof(io_uring_sqe);
+        m_sqes      = static_cast<io_uring_sqe *>(map(m_sqes_size, IORING_OFF_SQES));
+        if (m_sq == nullptr || m_cq == nullptr || m_sqes == nullptr) {
+            close();
+            return false;
+        }
+
+        m_sq_tail  = reinterpret_cast<unsigned int *>(static_cast<char *>(m_sq) + params.sq_off.tail);
+        m_sq_mask  = *reinterpret_cast<unsigned int *>(static_cast<char *>(m_sq) + params.sq_off.ring_mask);
+        m_sq_array = reinterpret_cast<unsigned int *>(static_cast<char *>(m_sq) + params.sq_off.array);
+        m_cq_head  = reinterpret_cast<unsigned int *>(static_cast<char *>(m_cq) + params.cq_off.head);
+        m_cq_tail  = reinterpret_cast<unsigned int *>(static_cast<char *>(m_cq) + params.cq_off.tail);
+        m_cq_mask  = *reinterpret_cast<unsigned int *>(static_cast<char *>(m_cq) + params.cq_off.ring_mask);
+        m_cqes     = reinterpret_cast<io_uring_cqe *>(static_cast<char *>(m_cq) + params.cq_off.cqes);
+        return true;
+    }
+
+    void close()
+    {
+        if (m_sqes != nullptr)
+            munmap(m_sqes, m_sqes_size);
+        if (m_cq != nullptr && m_cq != m_sq)
+            munmap(m_cq, m_cq_size);
+        if (m_sq != nullptr)
+            munmap(m_sq, m_sq_size);
+        if (m_fd >= 0)
+            ::close(m_fd);
+        m_sq = m_cq = nullptr;
+        m_sqes      = nullptr;
+        m_fd        = -1;
+    }
+
+    // Queues a read of the iovec at the offset and submits it, the iovec must live until the read completes
+    bool submit_read(int fd, const iovec *vector, uint64_t offset, uint64_t user_data)
+    {
+        const unsigned int tail  = *m_sq_tail;
+        const unsigned int index = tail & m_sq_mask;
+        io_uring_sqe      &sqe   = m_sqes[index];
+        std::memset(&sqe, 0, sizeof(sqe));
+        sqe.opcode    = IORING_OP_READV;
+        sqe.fd        = fd;
+        sqe.addr      = reinterpret_cast<uint64_t>(vector);
+        sqe.len       = 1;
+        sqe.off       = offset;
+        sqe.user_data = user_data;
+        m_sq_array[index] = index;
+        __atomic_store_n(m_sq_tail, tail + 1, __ATOMIC_RELEASE);
+        return syscall(__NR_io_uring_enter, m_fd, 1, 0, 0, nullptr, 0) == 1;
+    }
+
+    // Calls complete(user_data, result) for every completed read, waiting for one first when asked to
+    template<typename Complete> bool reap(bool wait, Complete &&complete)
+    {
+        if (wait && syscall(__NR_io_uring_enter, m_fd, 0, 1, IORING_ENTER_GETEVENTS, nullptr, 0) < 0 && errno != EINTR)
+            return false;
+        unsigned int       head = *m_cq_head;
+        const unsigned int tail = __atomic_load_n(m_cq_tail, __ATOMIC_ACQUIRE);
+        for (; head != tail; ++head) {
+            const io_uring_cqe &cqe = m_cqes[head & m_cq_mask];
+            complete(cqe.user_data, cqe.res);
+        }
+        __atomic_store_n(m_cq_head, head, __ATOMIC_RELEASE);
+        return true;
+    }
+
+private:
+    void *map(size_t size, off_t offset)
+    {
+        void *data = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_fd, offset);
+        return data == MAP_FAILED ? nullptr : data;
+    }
+
+    int           m_fd{-1};
+    void         *m_sq{nullptr};
+    void         *m_cq{nullptr};
+    io_uring_sqe *m_sqes{nullptr};
+    size_t        m_sq_size{0}, m_cq_size{0}, m_sqes_size{0};
+    unsigned int *m_sq_tail{nullptr};
+    unsigned int *m_sq_array{nullptr};
+    unsigned int  m_sq_mask{0};
+    unsigned int *m_cq_head{nullptr};
+    unsigned int *m_cq_tail{nullptr};
+    unsigned int  m_cq_mask{0};
+    io_uring_cqe *m_cqes{nullptr};
+};
+#endif
+
+class BlockReader
+{
+public:
+    BlockReader() = default;
+    ~BlockReader() { close(); }
+
+    BlockReader(const BlockReader &)            = delete;
+    BlockReader &operator=(const BlockReader &) = delete;
+
+    // Opens the file and starts reading its first blocks. With direct the page cache is bypassed when the file system
+    // allows it, which is what a cold load of a file read once wants.
+    bool open(const std::string &filename, size_t block_size = Default_Block_Size, size_t queue_depth = Default_Queue_Depth,
+              Backend backend = Backend::Auto, bool direct = false)
+    {
+        close();
+        if (!open_file(filename, direct)) {
+            std::cerr << "Error opening file: " << filename << std::endl;
+            return false;
+        }
+        m_block_size = (std::max<size_t>(block_size, 1) + Alignment - 1) / Alignment * Alignment;
+        m_blocks     = (m_size + m_block_size - 1) / m_block_size;
+        m_slots.resize(std::max<size_t>(queue_depth, 1));
+        for (Slot &slot : m_slots) {
+            slot.buffer = allocate_aligned(m_block_size);
+            if (slot.buffer == nullptr) {
+                close();
+                return false;
+            }
+        }
+
+        m_backend = Backend::Pread;
+#if defined(__linux__)
+        if (backend != Backend::Pread && m_ring.open(unsigned(m_slots.size())))
+            m_backend = Backend::IoUring;
+#endif
+        if (backend == Backend::IoUring && m_backend != Backend::IoUring)
+            std::cerr << "io_uring is not available, reading with threads" << std::endl;
+        if (m_backend == Backend::Pread) {
+            const size_t threads = std::min<size_t>(m_slots.size(), 4);
+            for (size_t t = 0; t < threads; ++t) m_workers.emplace_back([this]() { work(); });
+        }
+
+        for (size_t block = 0; block < std::min(m_blocks, m_slots.size()); ++block) submit(block);
+        return true;
+    }
+
+    // Next block of the file, waiting for its read when needed. The previous block goes back to the reader, its buffer
+    // is reused for a block further ahead. Empty at the end of the file and after a failed read.
+    Span<const char> next()
+    {
+        if (m_current != No_Block && m_current + m_slots.size() < m_blocks && !m_failed)
+            submit(m_current + m_slots.size());
+        m_current = m_current == No_Block ? 0 : m_current + 1;
+        if (m_current >= m_blocks || m_failed)
+            return {};
+
+        Slot                                       &slot  = m_slots[m_current % m_slots.size()];
+        const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        const bool                                  read  = wait(slot);
+        m_wait_ms += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        if (!read || !complete_short_read(slot)) {
+            std::cerr << "Error reading block " << m_current << " of the file" << std::endl;
+            m_failed = true;
+            return {};
+        }
+        return {slot.buffer, block_length(m_current)};
+    }
+
+    void close()
+    {
+        // the reads in flight write into the buffers, they have to complete before the buffers are freed
+#if defined(__linux__)
+        if (m_backend == Backend::IoUring) {
+            for (Slot &slot : m_slots)
+                if (slot.in_flight)
+                    wait(slot);
+            m_ring.close();
+        }
+#endif
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_jobs.clear();
+            m_stop = true;
+        }
+        m_work_ready.notify_all();
+        for (std::thread &worker : m_workers) worker.join();
+        m_workers.clear();
+        m_stop = false;
+
+        for (Slot &slot : m_slots) free_aligned(slot.buffer);
+        m_slots.clear();
+        close_file();
+        m_size    = 0;
+        m_blocks  = 0;
+        m_current = No_Block;
+        m_failed  = false;
+        m_wait_ms = 0.0;
+    }
+
+    size_t  size() const { return m_size; }
+    size_t  block_size() const { return m_block_size; }
+    bool    failed() const { return m_failed; }
+    Backend backend() const { return m_backend; }
+    // Time next() spent waiting for reads, the part of the reading the caller's work did not hide
+    double  wait_ms() const { return m_wait_ms; }
+
+private:
+    static const size_t No_Block = SIZE_MAX;
+
+    struct Slot
+    {
+        char   *buffer{nullptr};
+        size_t  block{0};
+        int64_t result{0};
+        bool    in_flight{false};
+        bool    done{false};
+#if defined(__linux__)
+        iovec vector{};
+#endif
+    };
+
+    size_t block_length(size_t block) const { return std::min(m_block_size, m_size - block * m_block_size); }
+
+    // Direct reads transfer whole aligned blocks, the bytes past the end of the file are not returned
+    size_t request_length(size_t block) const
+    {
+        const size_t length = block_length(block);
+        return m_direct ? (length + Alignment - 1) / Alignment * Alignment : length;
+    }
+
+    void submit(size_t block)
+    {
+        Slot &slot     = m_slots[block % m_slots.size()];
+        slot.block     = block;
+        slot.result    = 0;
+        slot.done      = false;
+        slot.in_flight = true;
+#if defined(__linux__)
+        if (m_backend == Backend::IoUring) {
+            slot.vector = {slot.buffer, request_length(block)};
+            if (!m_ring.submit_read(m_fd, &slot.vector, uint64_t(block) * m_block_size, uint64_t(&slot - m_slots.data()))) {
+                slot.result = -1;
+                slot.done   = true;
+            }
+            return;
+        }
+#endif
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_jobs.push_back(size_t(&slot - m_slots.data()));
+        }
+        m_work_ready.notify_one();
+    }
+
+    bool wait(Slot &slot)
+    {
+#if defined(__linux__)
+        if (m_backend == Backend::IoUring) {
+            auto complete = [this](uint64_t index, int32_t result) {
+                m_slots[index].result = result;
+                m_slots[index].done   = true;
+            };
+            m_ring.reap(false, complete);
+            while (!slot.done)
+                if (!m_ring.reap(true, complete))
+                    return false;
+            slot.in_flight = false;
+            return slot.result >= 0;
+        }
+#endif
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_read_done.wait(lock, [&]() { return slot.done; });
+        slot.in_flight = false;
+        return slot.result >= 0;
+    }
+
+    // A read may return less than asked for before the end of the file, the rest is read here
+    bool complete_short_read(Slot &slot)
+    {
+        const size_t length = block_length(slot.block);
+        size_t       done   = size_t(slot.result);
+        while (done < length) {
+            const int64_t result = read_at(slot.buffer + done, request_length(slot.block) - done, uint64_t(slot.block) * m_block_size + done);
+            if (result <= 0)
+                return false;
+            done += size_t(result);
+        }
+        return true;
+    }
+
+    void work()
+    {
+        for (;;) {
+            size_t index;
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                m_work_ready.wait(lock, [this]() { return m_stop || !m_jobs.empty(); });
+                if (m_stop)
+                    return;
+                index = m_jobs.front();
+                m_jobs.pop_front();
+            }
+            Slot         &slot   = m_slots[index];
+            const size_t  length = block_length(slot.block);
+            size_t        done   = 0;
+            int64_t       result = 0;
+            while (done < length) {
+                result = read_at(slot.buffer + done, request_length(slot.block) - done, uint64_t(slot.block) * m_block_size + done);
+                if (result <= 0)
+                    break;
+                done += size_t(result);
+            }
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                slot.result = result < 0 ? result : int64_t(done);
+                slot.done   = true;
+            }
+            m_read_done.notify_all();
+        }
+    }
+
+#if defined(_WIN32)
+    bool open_file(const std::string &filename, bool)
+    {
+        m_file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+        LARGE_INTEGER size;
+        if (m_file == INVALID_HANDLE_VALUE || !GetFileSizeEx(m_file, &size)) {
+            close_file();
+            return false;
+        }
+        m_size   = size_t(size.QuadPart);
+        m_direct = false;
+        return true;
+    }
+
+    void close_file()
+    {
+        if (m_file != INVALID_HANDLE_VALUE)
+            CloseHandle(m_file);
+        m_file = INVALID_HANDLE_VALUE;
+    }
+
+    int64_t read_at(char *buffer, size_t size, uint64_t offset)
+    {
+        OVERLAPPED overlapped{};
+        overlapped.Offset     = DWORD(offset);
+        overlapped.OffsetHigh = DWORD(offset >> 32);
+        DWORD read            = 0;
+        return ReadFile(m_file, buffer, DWORD(std::min<size_t>(size, 1u << 30)), &read, &overlapped) ? int64_t(read) : -1;
+    }
+
+    HANDLE m_file{INVALID_HANDLE_VALUE};
+#else
+    bool open_file(const std::string &filename, bool direct)
+    {
+        m_direct = false;
+#if defined(O_DIRECT)
+        if (direct) {
+            m_fd     = ::open(filename.c_str(), O_RDONLY | O_DIRECT);
+            m_direct = m_fd >= 0;
+        }
+#endif
+        if (m_fd < 0)
+            m_fd = ::open(filename.c_str(), O_RDONLY);
+        struct stat st;
+        if (m_fd < 0 || fstat(m_fd, &st) != 0) {
+            close_file();
+            return false;
+        }
+        m_size = size_t(st.st_size);
+#if defined(POSIX_FADV_SEQUENTIAL)
+        if (!m_direct)
+            posix_fadvise(m_fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+        return true;
+    }
+
+    void close_file()
+    {
+        if (m_fd >= 0)
+            ::close(m_fd);
+        m_fd = -1;
+    }
+
+    int64_t read_at(char *buffer, size_t size, uint64_t offset) { return int64_t(pread(m_fd, buffer, size, off_t(offset))); }
+
+    int m_fd{-1};
+#endif
+
+    size_t            m_size{0};
+    size_t            m_block_size{0};
+    size_t            m_blocks{0};
+    size_t            m_current{No_Block};
+    bool              m_direct{false};
+    bool              m_failed{false};
+    double            m_wait_ms{0.0};
+    Backend           m_backend{Backend::Pread};
+    std::vector<Slot> m_slots;
+#if defined(__linux__)
+    Ring m_ring;
+#endif
+
+    // pread backend: the slots to read, guarded by m_mutex like the results of the slots
+    std::mutex               m_mutex;
+    std::condition_variable  m_work_ready, m_read_done;
+    std::deque<size_t>       m_jobs;
+    std::vector<std::thread> m_workers;
+    bool                     m_stop{false};
+};
+
+} // namespace async_reader
+
+#endif /* ASYNC_READER_H_ */
@@ -0,0 +1,143 @@
+// Arc-heavy synthetic print: every layer has rings of concentric loops laid out on a grid, written once with native
+// G2/G3 arcs and once flattened into short G1 chords the way a slicer without arc output writes them. Compares the
+// points (one instanced segment each when drawn) and the parse times, and checks that the tessellated arcs stay within
+// the tolerance and do not depend on where the chunks are cut.
+//
+// usage: arc_benchmark [layers] [tolerance_mm] [flattened_segment_mm] [iterations]
+
+#include "benchmark.h"
+#include "../parser.h"
+
+#include <cmath>
+#include <thread>
+
+static const float Cell         = 70.0f; // the rings are centered in the cells of a grid
+static const int   Grid         = 4;
+static const float Layer_Height = 0.2f;
+static const float Loop_Spacing = 0.45f;
+
+struct Corpus
+{
+    float       segment_length;
+    std::string arcs;
+    std::string lines;
+    size_t      arcs_count{0};
+};
+
+static glm::vec2 on_circle(glm::vec2 center, float radius, double angle)
+{
+    return center + radius * glm::vec2(float(std::cos(angle)), float(std::sin(angle)));
+}
+
+// Appends an arc of the given sweep (negative is clockwise) to both texts, by its center offset or by its radius
+static void add_arc(Corpus &corpus, glm::vec2 center, float radius, double start_angle, double sweep, bool by_radius)
+{
+    char            line[160];
+    const glm::vec2 from = on_circle(center, radius, start_angle);
+    const glm::vec2 to   = on_circle(center, radius, start_angle + sweep);
+    const float     e    = 0.05f * radius * float(std::abs(sweep));
+    const char     *code = sweep < 0.0 ? "G2" : "G3";
+    if (by_radius)
+        std::snprintf(line, sizeof(line), "%s X%.3f Y%.3f R%.3f E%.5f F1800\n", code, to.x, to.y, radius, e);
+    else if (std::abs(std::abs(sweep) - 2.0 * glm::pi<double>()) < 1e-9)
+        std::snprintf(line, sizeof(line), "%s I%.3f J%.3f E%.5f F1800\n", code, center.x - from.x, center.y - from.y, e);
+    else
+        std::snprintf(line, sizeof(line), "%s X%.3f Y%.3f I%.3f J%.3f E%.5f F1800\n", code, to.x, to.y, center.x - from.x, center.y - from.y, e);
+    corpus.arcs += line;
+    ++corpus.arcs_count;
+
+    const size_t segments = std::max<size_t>(1, size_t(std::ceil(radius * std::abs(sweep) / corpus.segment_length)));
+    for (size_t k = 1; k <= segments; ++k) {
+        const glm::vec2 p = on_circle(center, radius, start_angle + sweep * double(k) / double(segments));
+        std::snprintf(line, sizeof(line), "G1 X%.3f Y%.3f E%.5f F1800\n", p.x, p.y, e / float(segments));
+        corpus.lines += line;
+    }
+}
+
+// Every ring is an outer full circle followed by loops of four quarter arcs, alternately given by center and by
+// radius. Even layers turn clockwise, odd ones counterclockwise.
+static Corpus make_corpus(size_t layers, float segment_length)
+{
+    Corpus corpus;
+    corpus.segment_length = segment_length;
+    const std::string header = "; generated by arc_benchmark\nG90\nM83\n;TYPE:External perimeter\n;HEIGHT:0.2\n;WIDTH:0.45\n";
+    corpus.arcs  = header;
+    corpus.lines = header;
+    char line[160];
+    for (size_t layer = 0; layer < layers; ++layer) {
+        const float  z         = Layer_Height * float(layer + 1);
+        const double direction = layer % 2 == 0 ? -1.0 : 1.0;
+        for (int ring = 0; ring < Grid * Grid; ++ring) {
+            const glm::vec2 center{Cell * (float(ring % Grid) + 0.5f), Cell * (float(ring / Grid) + 0.5f)};
+            const float     outer = 3.0f + 2.0f * float(ring);
+            for (int loop = 0; loop < 3; ++loop) {
+                const float     radius = outer - Loop_Spacing * float(loop);
+                const glm::vec2 start  = on_circle(center, radius, 0.0);
+                std::snprintf(line, sizeof(line), "G1 X%.3f Y%.3f Z%.3f F9000\n", start.x, start.y, z);
+                corpus.arcs += line;
+                corpus.lines += line;
+                if (loop == 0) {
+                    add_arc(corpus, center, radius, 0.0, direction * 2.0 * glm::pi<double>(), false);
+                    continue;
+                }
+                for (int quarter = 0; quarter < 4; ++quarter)
+                    add_arc(corpus, center, radius, direction * quarter * 0.5 * glm::pi<double>(), direction * 0.5 * glm::pi<double>(), quarter % 2 == 1);
+            }
+        }
+    }
+    return corpus;
+}
+
+// Every extrusion lies on the ring of its cell: both ends on the same circle and the middle of the chord no further
+// inside than the tolerance, allowing for the 3 decimals of the text
+static bool within_tolerance(const std::vector<gcode::PathPoint> &points, float tolerance, float &max_deviation)
+{
+    const float rounding = 2e-3f;
+    max_deviation        = 0.0f;
+    for (size_t i = 0; i + 1 < points.size(); ++i) {
+        if (!points[i].is_extrude_move())
+            continue;
+        const glm::vec2 a(points[i].position), b(points[i + 1].position);
+        const glm::vec2 center = Cell * (glm::floor(a / Cell) + 0.5f);
+        const float     radius = glm::length(a - center);
+        if (std::abs(glm::length(b - center) - radius) > rounding)
+            return false;
+        max_deviation = std::max(max_deviation, radius - glm::length(0.5f * (a + b) - center));
+    }
+    return max_deviation <= tolerance + rounding;
+}
+
+int main(int argc, char *argv[])
+{
+    const size_t layers         = argc > 1 ? std::stoul(argv[1]) : 200;
+    const float  tolerance      = argc > 2 ? std::stof(argv[2]) : parser::Default_Arc_Tolerance;
+    const float  segment_length = argc > 3 ? std::stof(argv[3]) : 0.1f;
+    const size_t iterations     = argc > 4 ? std::stoul(argv[4]) : 3;
+
+    const Corpus corpus = make_corpus(layers, segment_length);
+
+    std::vector<gcode::PathPoint> arcs, lines;
+    const double lines_ms = benchmark::best_of(iterations, [&]() { lines = parser::parse(corpus.lines.data(), corpus.lines.size()); });
+    const double arcs_ms  = benchmark::best_of(iterations, [&]() {
+        arcs = parser::parse(corpus.arcs.data(), corpus.arcs.size(), parser::Default_Chunk_Size, tolerance);
+    });
+
+    // small chunks start in the middle of rings, the arcs have to find their start in the previous chunk
+    const std::vector<gcode::PathPoint> chunked = parser::parse(corpus.arcs.data(), corpus.arcs.size(), 4096, tolerance);
+    const bool  chunked_equal = chunked.size() == arcs.size() && std::memcmp(chunked.data(), arcs.data(), arcs.size() * sizeof(gcode::PathPoint)) == 0;
+    float       arcs_deviation, lines_deviation;
+    const bool  arcs_within  = within_tolerance(arcs, tolerance, arcs_deviation);
+    const bool  lines_within = within_tolerance(lines, 1.0f, lines_deviation);
+
+    std::cout << layers << " layers, " << corpus.arcs_count << " arcs, " << std::thread::hardware_concurrency() << " hardware threads" << std::endl;
+    std::printf("%-40s %10zu points %8.1f MB text, max deviation %.4f mm\n", "flattened G1", lines.size(),
+                double(corpus.lines.size()) / (1024.0 * 1024.0), lines_deviation);
+    std::printf("%-40s %10zu points %8.1f MB text, max deviation %.4f mm\n", "G2/G3 tessellated", arcs.size(),
+                double(corpus.arcs.size()) / (1024.0 * 1024.0), arcs_deviation);
+    benchmark::report("parse flattened G1", lines_ms, corpus.lines.size());
+    benchmark::report("parse G2/G3 and tessellate", arcs_ms, corpus.arcs.size());
+    std::printf("segments drawn: %.1f%% of the flattened path\n", 100.0 * double(arcs.size()) / double(lines.size()));
+    std::cout << "within tolerance: " << (arcs_within && lines_within ? "yes" : "NO") << ", 4 kB chunks == single: " << (chunked_equal ? "yes" : "NO")
+              << std::endl;
+    return arcs_within && lines_within && chunked_equal ? 0 : 1;
+}
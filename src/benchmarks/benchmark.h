@@ -0,0 +1,155 @@
+#ifndef BENCHMARK_H_
+#define BENCHMARK_H_
+
+#include "../gcode.h"
+
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace benchmark {
+
+class Timer
+{
+    std::chrono::steady_clock::time_point m_start{std::chrono::steady_clock::now()};
+
+public:
+    void   reset() { m_start = std::chrono::steady_clock::now(); }
+    double elapsed_ms() const { return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - m_start).count(); }
+};
+
+// Runs the callable the given number of times and returns the best time in milliseconds
+template<typename Callable> double best_of(size_t iterations, Callable &&callable)
+{
+    double best = std::numeric_limits<double>::max();
+    for (size_t i = 0; i < iterations; ++i) {
+        Timer timer;
+        callable();
+        best = std::min(best, timer.elapsed_ms());
+    }
+    return best;
+}
+
+static void report(const std::string &name, double ms, size_t bytes = 0)
+{
+    std::printf("%-40s %10.2f ms", name.c_str(), ms);
+    if (bytes > 0)
+        std::printf(" %10.1f MB/s", double(bytes) / (1024.0 * 1024.0) / (ms / 1000.0));
+    std::printf("\n");
+}
+
+// Print-like synthetic path: every layer has a few square perimeters followed by a zig-zag infill,
+// layers are connected by travel moves.
+static std::vector<gcode::PathPoint> make_synthetic_path(size_t points_count)
+{
+    std::vector<gcode::PathPoint> points;
+    points.reserve(points_count);
+
+    const float layer_height = 0.2f;
+    const float size         = 60.0f;
+    const float step         = 0.5f;
+    size_t      layer        = 0;
+
+    auto add = [&](glm::vec3 position, unsigned int role, unsigned int type) {
+        gcode::PathPoint p;
+        p.position = position;
+        p.encode_flags(role, type);
+        p.height         = layer_height;
+        p.width          = 0.45f;
+        p.speed          = type == 8 ? 200.0f : 40.0f + float(role) * 5.0f;
+        p.fanspeed       = layer < 2 ? 0.0f : 100.0f;
+        p.temperature    = layer < 2 ? 215.0f : 210.0f;
+        p.volumetricrate = p.speed * p.width * p.height;
+        p.extruderid     = 0;
+        p.colorid        = unsigned(layer / 100);
+        points.push_back(p);
+    };
+
+    while (points.size() < points_count) {
+        const float z = float(layer + 1) * layer_height;
+        for (unsigned int perimeter = 0; perimeter < 3 && points.size() < points_count; ++perimeter) {
+            const float o    = float(perimeter) * 0.45f;
+            const float a    = o, b = size - o;
+            const unsigned role = perimeter == 0 ? 2 : 1;
+            add({a, a, z}, 0, 8);
+            for (float t = a; t < b && points.size() < points_count; t += step) add({t, a, z}, role, 10);
+            for (float t = a; t < b && points.size() < points_count; t += step) add({b, t, z}, role, 10);
+            for (float t = b; t > a && points.size() < points_count; t -= step) add({t, b, z}, role, 10);
+            for (float t = b; t > a && points.size() < points_count; t -= step) add({a, t, z}, role, 10);
+        }
+        add({2.0f, 2.0f, z}, 0, 8);
+        for (float y = 2.0f; y < size - 2.0f && points.size() < points_count; y += 1.0f) {
+            add({2.0f, y, z}, 4, 10);
+            add({size - 2.0f, y, z}, 4, 10);
+        }
+        ++layer;
+    }
+    points.resize(points_count);
+    return points;
+}
+
+// Legacy dump layout: size_t count followed by count raw PathPoint records
+static bool write_legacy_dump(const std::string &filename, const std::vector<gcode::PathPoint> &points)
+{
+    std::ofstream file(filename, std::ios::binary);
+    if (!file)
+        return false;
+    const size_t size = points.size();
+    file.write(reinterpret_cast<const char *>(&size), sizeof(size));
+    file.write(reinterpret_cast<const char *>(points.data()), std::streamsize(points.size() * sizeof(gcode::PathPoint)));
+    return bool(file);
+}
+
+// G-code text for the given path in the flavour PrusaSlicer writes it (G90, M83, ;TYPE: ;HEIGHT: ;WIDTH: comments).
+// The move starting at point i uses the attributes of point i, so parsing it back yields an extra first point at the origin.
+static std::string make_gcode(const std::vector<gcode::PathPoint> &points)
+{
+    static const char *role_names[] = {"None",         "Perimeter",      "External perimeter", "Overhang perimeter", "Internal infill",
+                                       "Solid infill", "Top solid infill", "Ironing",          "Bridge infill",      "Gap fill",
+                                       "Skirt/Brim",   "Support material", "Support material interface", "Wipe tower", "Custom"};
+    std::string gcode = "; generated by benchmark\nG90\nM83\n";
+    gcode.reserve(points.size() * 48);
+    char       line[128];
+    int        role = -1;
+    float      height = -1.0f, width = -1.0f, fan = -1.0f, temperature = -1.0f;
+    auto       append = [&](int length) { gcode.append(line, size_t(length)); };
+    if (!points.empty())
+        append(std::snprintf(line, sizeof(line), "G1 X%.3f Y%.3f Z%.3f F9000\n", points[0].position.x, points[0].position.y, points[0].position.z));
+    for (size_t i = 0; i + 1 < points.size(); ++i) {
+        const gcode::PathPoint &p = points[i];
+        const gcode::PathPoint &n = points[i + 1];
+        if (p.is_extrude_move() && int(p.role_from_flags()) != role) {
+            role = int(p.role_from_flags());
+            append(std::snprintf(line, sizeof(line), ";TYPE:%s\n", role_names[role]));
+        }
+        if (p.is_extrude_move() && p.height != height) append(std::snprintf(line, sizeof(line), ";HEIGHT:%g\n", height = p.height));
+        if (p.is_extrude_move() && p.width != width) append(std::snprintf(line, sizeof(line), ";WIDTH:%g\n", width = p.width));
+        if (p.fanspeed != fan) append(std::snprintf(line, sizeof(line), "M106 S%d\n", int(255.0f * (fan = p.fanspeed) / 100.0f + 0.5f)));
+        if (p.temperature != temperature) append(std::snprintf(line, sizeof(line), "M104 S%d\n", int(temperature = p.temperature)));
+        if (p.is_extrude_move()) {
+            const float e = 0.05f * glm::length(n.position - p.position) + 0.001f;
+            append(std::snprintf(line, sizeof(line), "G1 X%.3f Y%.3f Z%.3f E%.5f F%d\n", n.position.x, n.position.y, n.position.z, e, int(p.speed * 60.0f)));
+        } else {
+            append(std::snprintf(line, sizeof(line), "G1 X%.3f Y%.3f Z%.3f F%d\n", n.position.x, n.position.y, n.position.z, int(p.speed * 60.0f)));
+        }
+    }
+    return gcode;
+}
+
+// Uses the file given on the command line, or writes a synthetic dump with the requested number of points
+static std::string input_or_synthetic(int argc, char *argv[], size_t default_points)
+{
+    if (argc > 1)
+        return argv[1];
+    const std::string filename = "synthetic_" + std::to_string(default_points) + ".bin";
+    std::cout << "No input given, writing " << default_points << " synthetic points to " << filename << std::endl;
+    write_legacy_dump(filename, make_synthetic_path(default_points));
+    return filename;
+}
+
+} // namespace benchmark
+
+#endif /* BENCHMARK_H_ */
@@ -0,0 +1,290 @@
+// Time to the first frame when opening binary G-code: the blocks decoded in parallel and streamed into the parser
+// against the former route of converting the file to a legacy dump first and loading that. Without an input the
+// synthetic G-code is encoded with every compression (and MeatPack) and the decoded points are checked against
+// parsing the plain text.
+//
+// usage: bgcode_benchmark [bgcode_file] [iterations]
+
+#include "benchmark.h"
+#include "../bgcode.h"
+#include "../streaming.h"
+
+#include <cstdio>
+#include <thread>
+
+static bool same_points(Span<const gcode::PathPoint> a, Span<const gcode::PathPoint> b)
+{
+    return a.size() == b.size() && std::memcmp(a.data(), b.data(), a.size() * sizeof(gcode::PathPoint)) == 0;
+}
+
+// MeatPack with spaces omitted, as PrusaSlicer writes it, comments are kept
+static std::string meatpack_encode(const std::string &text)
+{
+    auto nibble = [](char c) -> int {
+        if (c >= '0' && c <= '9')
+            return c - '0';
+        switch (c) {
+        case '.': return 10;
+        case 'E': return 11;
+        case '\n': return 12;
+        case 'G': return 13;
+        case 'X': return 14;
+        }
+        return 15;
+    };
+
+    std::string stripped;
+    stripped.reserve(text.size());
+    bool comment = false;
+    for (char c : text) {
+        comment = c == ';' || (comment && c != '\n');
+        if (comment || c != ' ')
+            stripped.push_back(c);
+    }
+
+    std::string out = {char(0xFF), char(0xFF), char(251), char(0xFF), char(0xFF), char(247)};
+    for (size_t i = 0; i < stripped.size();) {
+        const char first = stripped[i];
+        if (first == '\n' || i + 1 == stripped.size()) {
+            const int n = nibble(first);
+            out.push_back(char(n == 15 ? 0xFF : n));
+            if (n == 15)
+                out.push_back(first);
+            i += 1;
+            continue;
+        }
+        const char second = stripped[i + 1];
+        const int  a = nibble(first), b = nibble(second);
+        out.push_back(char(a | (b << 4)));
+        if (a == 15)
+            out.push_back(first);
+        if (b == 15)
+            out.push_back(second);
+        i += 2;
+    }
+    return out;
+}
+
+// Greedy LZSS in the heatshrink bit format, matches are searched through a hash chain of the last two bytes
+static std::string heatshrink_encode(const std::string &in, unsigned int window_bits, unsigned int lookahead_bits)
+{
+    const size_t window = size_t(1) << window_bits, max_length = size_t(1) << lookahead_bits;
+    std::string  out;
+    uint32_t     bits = 0, bit_count = 0;
+    auto         put  = [&](uint32_t value, unsigned int count) {
+        for (unsigned int i = count; i-- > 0;) {
+            bits = (bits << 1) | ((value >> i) & 1);
+            if (++bit_count == 8) {
+                out.push_back(char(bits));
+                bits = bit_count = 0;
+            }
+        }
+    };
+
+    std::vector<int64_t> head(1 << 16, -1), previous(in.size(), -1);
+    auto                 key = [&](size_t i) { return (uint8_t(in[i]) << 8) | uint8_t(in[i + 1]); };
+    for (size_t i = 0; i < in.size();) {
+        size_t best_length = 0, best_distance = 0;
+        if (i + 1 < in.size()) {
+            int64_t candidate = head[key(i)];
+            for (int tries = 0; candidate >= 0 && i - size_t(candidate) <= window && tries < 16; ++tries, candidate = previous[candidate]) {
+                size_t length = 0;
+                while (length < max_length && i + length < in.size() && in[size_t(candidate) + length] == in[i + length]) ++length;
+                if (length > best_length) {
+                    best_length   = length;
+                    best_distance = i - size_t(candidate);
+                }
+            }
+        }
+        const size_t advance = best_length >= 2 ? best_length : 1;
+        if (best_length >= 2) {
+            put(0, 1);
+            put(uint32_t(best_distance - 1), window_bits);
+            put(uint32_t(best_length - 1), lookahead_bits);
+        } else {
+            put(1, 1);
+            put(uint8_t(in[i]), 8);
+        }
+        for (size_t j = i; j < i + advance && j + 1 < in.size(); ++j) {
+            previous[j]  = head[key(j)];
+            head[key(j)] = int64_t(j);
+        }
+        i += advance;
+    }
+    if (bit_count > 0)
+        put(0, 8 - bit_count);
+    return out;
+}
+
+struct Encoding
+{
+    const char            *name;
+    bgcode::Compression    compression;
+    bgcode::GCodeEncoding  encoding;
+};
+
+static void append_block(std::string &file, bgcode::BlockType type, bgcode::Compression compression, uint16_t encoding, const std::string &data,
+                         const std::string &payload, size_t parameters_size = 2)
+{
+    auto put = [](std::string &s, auto value) { s.append(reinterpret_cast<const char *>(&value), sizeof(value)); };
+
+    std::string block;
+    put(block, uint16_t(type));
+    put(block, uint16_t(compression));
+    put(block, uint32_t(data.size()));
+    if (compression != bgcode::Compression::None)
+        put(block, uint32_t(payload.size()));
+    put(block, encoding);
+    block.append(parameters_size - 2, '\0');
+    block += payload;
+    put(block, uint32_t(crc32_z(0L, reinterpret_cast<const Bytef *>(block.data()), block.size())));
+    file += block;
+}
+
+// 64 kB G-code blocks cut at line ends, preceded by the file metadata and a thumbnail
+static std::string encode_bgcode(const std::string &text, const Encoding &encoding)
+{
+    std::string file(bgcode::Magic, sizeof(bgcode::Magic));
+    file.append("\x01\x00\x00\x00\x01\x00", 6); // version 1, CRC32
+    append_block(file, bgcode::BlockType::FileMetadata, bgcode::Compression::None, 0, "Producer=bgcode_benchmark\n", "Producer=bgcode_benchmark\n");
+    append_block(file, bgcode::BlockType::Thumbnail, bgcode::Compression::None, 0, std::string(16, '\x7f'), std::string(16, '\x7f'), 6);
+
+    std::vector<std::pair<size_t, size_t>> pieces;
+    for (size_t begin = 0; begin < text.size();) {
+        size_t end = std::min(begin + 65536, text.size());
+        if (end < text.size())
+            end = text.rfind('\n', end - 1) + 1;
+        pieces.emplace_back(begin, end);
+        begin = end;
+    }
+    std::vector<std::string> data(pieces.size()), payloads(pieces.size());
+    std::vector<size_t>      slots(pieces.size());
+    std::iota(slots.begin(), slots.end(), 0);
+    std::for_each(std::execution::par, slots.begin(), slots.end(), [&](size_t s) {
+        data[s] = text.substr(pieces[s].first, pieces[s].second - pieces[s].first);
+        if (encoding.encoding != bgcode::GCodeEncoding::None)
+            data[s] = meatpack_encode(data[s]);
+        switch (encoding.compression) {
+        case bgcode::Compression::None: payloads[s] = data[s]; break;
+        case bgcode::Compression::Deflate: {
+            uLongf size = compressBound(uLong(data[s].size()));
+            payloads[s].resize(size);
+            compress2(reinterpret_cast<Bytef *>(payloads[s].data()), &size, reinterpret_cast<const Bytef *>(data[s].data()), uLong(data[s].size()),
+                      Z_DEFAULT_COMPRESSION);
+            payloads[s].resize(size);
+            break;
+        }
+        case bgcode::Compression::Heatshrink_11_4: payloads[s] = heatshrink_encode(data[s], 11, 4); break;
+        case bgcode::Compression::Heatshrink_12_4: payloads[s] = heatshrink_encode(data[s], 12, 4); break;
+        }
+    });
+    for (size_t s = 0; s < pieces.size(); ++s)
+        append_block(file, bgcode::BlockType::GCode, encoding.compression, uint16_t(encoding.encoding), data[s], payloads[s]);
+    return file;
+}
+
+struct StreamTimes
+{
+    double                        first_batch_ms{0.0};
+    double                        all_ms{0.0};
+    std::vector<gcode::PathPoint> points;
+};
+
+static StreamTimes stream_file(const std::string &filename)
+{
+    StreamTimes           times;
+    benchmark::Timer      timer;
+    streaming::PathStream stream;
+    gcode::PathStore      columns;
+    columns.loaded_columns = gcode::All_Columns;
+    if (!stream.open(filename))
+        return times;
+    while (true) {
+        const bool finished = stream.finished();
+        if (stream.poll(columns) && times.first_batch_ms == 0.0)
+            times.first_batch_ms = timer.elapsed_ms();
+        if (finished)
+            break;
+        std::this_thread::yield();
+    }
+    times.all_ms = timer.elapsed_ms();
+    times.points = gcode::to_path_points(columns);
+    return times;
+}
+
+static bool run(const std::string &filename, size_t iterations, const std::vector<gcode::PathPoint> *expected)
+{
+    loader::MappedFile probe;
+    if (!probe.open(filename)) {
+        std::cerr << "Cannot open " << filename << std::endl;
+        return false;
+    }
+    const size_t bytes = probe.size();
+    probe.close();
+
+    std::vector<gcode::PathPoint> parsed;
+    const double                  parse_ms = benchmark::best_of(iterations, [&]() { parsed = bgcode::parse_file(filename); });
+
+    StreamTimes streamed;
+    for (size_t i = 0; i < iterations; ++i) {
+        StreamTimes times = stream_file(filename);
+        if (i == 0 || times.first_batch_ms < streamed.first_batch_ms)
+            streamed = std::move(times);
+    }
+
+    // the former route: convert the whole file to a legacy dump, then stream the dump
+    const std::string dump_filename = filename + ".bin";
+    double            converted_first_ms = std::numeric_limits<double>::max(), converted_all_ms = 0.0;
+    for (size_t i = 0; i < iterations; ++i) {
+        benchmark::Timer timer;
+        benchmark::write_legacy_dump(dump_filename, bgcode::parse_file(filename));
+        const double      convert_ms = timer.elapsed_ms();
+        const StreamTimes times      = stream_file(dump_filename);
+        if (convert_ms + times.first_batch_ms < converted_first_ms) {
+            converted_first_ms = convert_ms + times.first_batch_ms;
+            converted_all_ms   = convert_ms + times.all_ms;
+        }
+    }
+    std::remove(dump_filename.c_str());
+
+    const bool stream_equal   = same_points(parsed, streamed.points);
+    const bool expected_equal = expected == nullptr || same_points(parsed, *expected);
+    std::printf("%s: %.1f MB, %zu points\n", filename.c_str(), double(bytes) / (1024.0 * 1024.0), parsed.size());
+    benchmark::report("  decode + parse (blocking)", parse_ms, bytes);
+    benchmark::report("  streamed: first batch", streamed.first_batch_ms);
+    benchmark::report("  streamed: all points", streamed.all_ms, bytes);
+    benchmark::report("  convert to dump first: first batch", converted_first_ms);
+    benchmark::report("  convert to dump first: all points", converted_all_ms);
+    std::cout << "  streamed == blocking: " << (stream_equal ? "yes" : "NO")
+              << (expected == nullptr ? "" : (expected_equal ? ", matches the plain G-code" : ", DIFFERS from the plain G-code")) << std::endl;
+    return stream_equal && expected_equal;
+}
+
+int main(int argc, char *argv[])
+{
+    const size_t iterations = argc > 2 ? std::stoul(argv[2]) : 3;
+    std::cout << std::thread::hardware_concurrency() << " hardware threads" << std::endl;
+    if (argc > 1)
+        return run(argv[1], iterations, nullptr) ? 0 : 1;
+
+    const std::string                   text     = benchmark::make_gcode(benchmark::make_synthetic_path(4'000'000));
+    const std::vector<gcode::PathPoint> expected = parser::parse(text.data(), text.size());
+    std::cout << "No input given, encoding " << text.size() / (1024 * 1024) << " MB of synthetic G-code" << std::endl;
+
+    const Encoding encodings[] = {
+        {"none", bgcode::Compression::None, bgcode::GCodeEncoding::None},
+        {"deflate", bgcode::Compression::Deflate, bgcode::GCodeEncoding::None},
+        {"deflate_meatpack", bgcode::Compression::Deflate, bgcode::GCodeEncoding::MeatPackComments},
+        {"heatshrink11_meatpack", bgcode::Compression::Heatshrink_11_4, bgcode::GCodeEncoding::MeatPackComments},
+        {"heatshrink12_meatpack", bgcode::Compression::Heatshrink_12_4, bgcode::GCodeEncoding::MeatPackComments},
+    };
+    bool ok = true;
+    for (const Encoding &encoding : encodings) {
+        const std::string filename = std::string("synthetic_") + encoding.name + ".bgcode";
+        const std::string file     = encode_bgcode(text, encoding);
+        std::ofstream(filename, std::ios::binary).write(file.data(), std::streamsize(file.size()));
+        ok = run(filename, iterations, &expected) && ok;
+        std::remove(filename.c_str());
+    }
+    return ok ? 0 : 1;
+}
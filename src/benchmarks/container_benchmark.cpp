@@ -0,0 +1,58 @@
+// Read and write throughput of the legacy PathPoint dump and of the columnar path container,
+// including a read of only the columns needed for the default "Feature type" view.
+//
+// usage: container_benchmark [dump_file] [iterations]
+
+#include "benchmark.h"
+#include "../container.h"
+#include "../loader.h"
+
+int main(int argc, char *argv[])
+{
+    const std::string filename   = benchmark::input_or_synthetic(argc, argv, 20'000'000);
+    const size_t      iterations = argc > 2 ? std::stoul(argv[2]) : 3;
+
+    const std::vector<gcode::PathPoint> points  = loader::readPathPoints(filename);
+    const gcode::PathStore              columns = gcode::to_columns(points);
+    const size_t                        bytes   = points.size() * sizeof(gcode::PathPoint);
+
+    const std::string legacy_out    = filename + ".legacy.tmp";
+    const std::string container_out = filename + ".gcpc.tmp";
+
+    const double write_legacy    = benchmark::best_of(iterations, [&]() { benchmark::write_legacy_dump(legacy_out, points); });
+    const double write_container = benchmark::best_of(iterations, [&]() { container::write(container_out, columns); });
+
+    size_t       sink        = 0;
+    const double read_legacy = benchmark::best_of(iterations, [&]() { sink += loader::readPathPoints(legacy_out).size(); });
+    const double read_all    = benchmark::best_of(iterations, [&]() {
+        gcode::PathStore loaded;
+        container::read(container_out, loaded);
+        sink += loaded.count;
+    });
+    const unsigned int geometry_mask = gcode::column_bit(gcode::Column::Position) | gcode::column_bit(gcode::Column::Flags) |
+                                       gcode::column_bit(gcode::Column::Height) | gcode::column_bit(gcode::Column::Width);
+    const double read_geometry = benchmark::best_of(iterations, [&]() {
+        gcode::PathStore loaded;
+        container::read(container_out, loaded, geometry_mask);
+        sink += loaded.count;
+    });
+
+    // round trip check
+    gcode::PathStore loaded;
+    container::read(container_out, loaded);
+    const std::vector<gcode::PathPoint> round_trip = gcode::to_path_points(loaded);
+    const bool equal = round_trip.size() == points.size() &&
+                       std::memcmp(round_trip.data(), points.data(), points.size() * sizeof(gcode::PathPoint)) == 0;
+
+    std::cout << points.size() << " points, warm page cache, round trip " << (equal ? "OK" : "FAILED") << std::endl;
+    benchmark::report("legacy write", write_legacy, bytes);
+    benchmark::report("container write", write_container, bytes);
+    benchmark::report("legacy read", read_legacy, bytes);
+    benchmark::report("container read, all columns", read_all, bytes);
+    benchmark::report("container read, geometry columns", read_geometry, bytes);
+    std::cout << "(" << sink << ")" << std::endl;
+
+    std::remove(legacy_out.c_str());
+    std::remove(container_out.c_str());
+    return equal ? 0 : 1;
+}
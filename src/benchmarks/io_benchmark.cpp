@@ -0,0 +1,113 @@
+// Loading of a G-code file read in blocks through the asynchronous reader: raw read bandwidth of every backend, parse
+// time of the text already in memory, the sequential read-then-parse the viewer did before, and the overlapped
+// pipeline which parses a block while the next ones are read. The file is evicted from the page cache before every
+// timed read, so the reads are cold as long as the kernel honours the hint. Without an input a synthetic file is
+// written.
+//
+// The overlap ratio is the part of the shorter of reading and parsing hidden behind the other:
+// (read + parse - overlapped) / min(read, parse), 1 when the pipeline takes as long as the longer of the two.
+//
+// usage: io_benchmark [gcode_file] [block_mb] [queue_depth] [direct]
+
+#include "benchmark.h"
+#include "../async_reader.h"
+#include "../loader.h"
+#include "../parser.h"
+
+#include <thread>
+
+// Drops the cached pages of the file, which are clean after the first read
+static bool evict(const std::string &filename)
+{
+#if defined(POSIX_FADV_DONTNEED)
+    const int fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+    fdatasync(fd);
+    const bool evicted = posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED) == 0;
+    ::close(fd);
+    return evicted;
+#else
+    return false;
+#endif
+}
+
+int main(int argc, char *argv[])
+{
+    std::string filename = argc > 1 ? argv[1] : "";
+    const size_t block_size = argc > 2 ? std::stoul(argv[2]) << 20 : parser::read_block_size();
+    const size_t depth      = argc > 3 ? std::stoul(argv[3]) : async_reader::Default_Queue_Depth;
+    const bool   direct     = argc > 4 && std::string(argv[4]) == "direct";
+    if (filename.empty()) {
+        filename = "synthetic_io.gcode";
+        std::cout << "No input given, writing synthetic G-code to " << filename << std::endl;
+        std::ofstream(filename, std::ios::binary) << benchmark::make_gcode(benchmark::make_synthetic_path(8'000'000));
+    }
+
+    // raw bandwidth, the blocks are only touched
+    size_t          file_size = 0;
+    double          read_ms   = 0.0;
+    volatile size_t touched   = 0;
+    for (async_reader::Backend backend : {async_reader::Backend::IoUring, async_reader::Backend::Pread}) {
+        evict(filename);
+        async_reader::BlockReader reader;
+        benchmark::Timer          timer;
+        if (!reader.open(filename, block_size, depth, backend, direct)) {
+            std::cerr << "Cannot open " << filename << std::endl;
+            return 1;
+        }
+        if (reader.backend() != backend)
+            continue;
+        for (Span<const char> block = reader.next(); !block.empty(); block = reader.next()) touched = touched + size_t(block[block.size() - 1]);
+        const double ms = timer.elapsed_ms();
+        file_size       = reader.size();
+        read_ms         = read_ms == 0.0 ? ms : std::min(read_ms, ms);
+        benchmark::report(std::string("read only, ") + async_reader::backend_name(backend), ms, file_size);
+    }
+
+    // the text in memory, parsed the way the viewer parses a whole file
+    std::string text;
+    {
+        loader::MappedFile file;
+        if (!file.open(filename))
+            return 1;
+        text.assign(file.data(), file.size());
+    }
+    std::vector<gcode::PathPoint> expected;
+    const double parse_ms = benchmark::best_of(1, [&]() { expected = parser::parse(text.data(), text.size()); });
+    text = std::string();
+    benchmark::report("parse from memory", parse_ms, file_size);
+
+    // the former loading: the whole file is read, then parsed
+    evict(filename);
+    std::vector<gcode::PathPoint> sequential;
+    benchmark::Timer              sequential_timer;
+    {
+        std::ifstream file(filename, std::ios::binary);
+        std::string   whole(file_size, '\0');
+        file.read(whole.data(), std::streamsize(file_size));
+        sequential = parser::parse(whole.data(), whole.size());
+    }
+    const double sequential_ms = sequential_timer.elapsed_ms();
+    benchmark::report("read, then parse", sequential_ms, file_size);
+
+    // blocks parsed while the next ones are read
+    evict(filename);
+    async_reader::BlockReader     reader;
+    std::vector<gcode::PathPoint> overlapped;
+    benchmark::Timer              overlapped_timer;
+    reader.open(filename, block_size, depth, async_reader::Backend::Auto, direct);
+    const bool   parsed        = parser::parse_blocks(reader, overlapped, [](std::vector<gcode::PathPoint> &) { return true; });
+    const double overlapped_ms = overlapped_timer.elapsed_ms();
+    benchmark::report(std::string("overlapped read and parse, ") + async_reader::backend_name(reader.backend()), overlapped_ms, file_size);
+
+    const double overlap = std::clamp((read_ms + parse_ms - overlapped_ms) / std::min(read_ms, parse_ms), 0.0, 1.0);
+    const bool   equal   = parsed && overlapped.size() == expected.size() && sequential.size() == expected.size() &&
+                       std::memcmp(overlapped.data(), expected.data(), expected.size() * sizeof(gcode::PathPoint)) == 0;
+    std::printf("%zu MB in blocks of %zu MB, queue depth %zu%s, %u hardware threads\n", file_size >> 20, reader.block_size() >> 20, depth,
+                direct ? ", direct" : "", std::thread::hardware_concurrency());
+    std::printf("overlap ratio %.2f, waited for reads %.1f ms, %.0f%% of the sequential time\n", overlap, reader.wait_ms(),
+                100.0 * overlapped_ms / sequential_ms);
+    std::cout << "overlapped == in memory: " << (equal ? "yes" : "NO") << std::endl;
+    return equal ? 0 : 1;
+}
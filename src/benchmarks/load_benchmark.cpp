@@ -0,0 +1,65 @@
+// Compares loading of the legacy PathPoint dump: the original per-record read, the single bulk read
+// used as fallback and the memory mapped zero-copy loader.
+//
+// usage: load_benchmark [dump_file] [iterations]
+
+#include "benchmark.h"
+#include "../loader.h"
+
+// The original reader, one file.read per PathPoint
+static std::vector<gcode::PathPoint> read_per_record(const std::string &filename)
+{
+    std::vector<gcode::PathPoint> pathPoints;
+    std::ifstream                 file(filename, std::ios::binary);
+    size_t                        size;
+    file.read(reinterpret_cast<char *>(&size), sizeof(size));
+    pathPoints.resize(size);
+    for (auto &point : pathPoints) {
+        file.read(reinterpret_cast<char *>(&point), sizeof(point));
+    }
+    return pathPoints;
+}
+
+// Touches every record the way SceneBox::update does, so lazily mapped pages are paid for as well
+static glm::vec3 scan(Span<const gcode::PathPoint> points)
+{
+    glm::vec3 max{-FLT_MAX};
+    for (const gcode::PathPoint &p : points) max = glm::max(max, p.position);
+    return max;
+}
+
+int main(int argc, char *argv[])
+{
+    const std::string filename   = benchmark::input_or_synthetic(argc, argv, 20'000'000);
+    const size_t      iterations = argc > 2 ? std::stoul(argv[2]) : 3;
+
+    loader::MappedFile probe;
+    if (!probe.open(filename)) {
+        std::cerr << "Cannot open " << filename << std::endl;
+        return 1;
+    }
+    const size_t bytes = probe.size();
+    probe.close();
+
+    glm::vec3 sink{0};
+    double    per_record = benchmark::best_of(iterations, [&]() {
+        const std::vector<gcode::PathPoint> points = read_per_record(filename);
+        sink += scan(points);
+    });
+    double    bulk       = benchmark::best_of(iterations, [&]() {
+        const std::vector<gcode::PathPoint> points = loader::readPathPoints(filename);
+        sink += scan(points);
+    });
+    double    mapped     = benchmark::best_of(iterations, [&]() {
+        loader::PathPointsFile file;
+        file.open(filename);
+        sink += scan(file.points());
+    });
+
+    std::cout << "file: " << filename << ", " << bytes / sizeof(gcode::PathPoint) << " points, warm page cache" << std::endl;
+    benchmark::report("per-record read", per_record, bytes);
+    benchmark::report("bulk read (fallback)", bulk, bytes);
+    benchmark::report("memory mapped", mapped, bytes);
+    std::cout << "speedup mapped vs per-record: " << per_record / mapped << "x (" << sink.x << ")" << std::endl;
+    return 0;
+}
@@ -0,0 +1,61 @@
+// Throughput of the G-code parser, single chunk (sequential) against newline aligned chunks parsed in parallel.
+// Without an input, G-code is generated from a synthetic path and the parsed points are checked against it.
+//
+// usage: parser_benchmark [gcode_file] [iterations]
+
+#include "benchmark.h"
+#include "../parser.h"
+
+#include <thread>
+
+static bool same_points(const std::vector<gcode::PathPoint> &a, const std::vector<gcode::PathPoint> &b)
+{
+    return a.size() == b.size() && std::memcmp(a.data(), b.data(), a.size() * sizeof(gcode::PathPoint)) == 0;
+}
+
+int main(int argc, char *argv[])
+{
+    const size_t iterations = argc > 2 ? std::stoul(argv[2]) : 3;
+
+    std::vector<gcode::PathPoint> source;
+    std::string                   text;
+    if (argc > 1) {
+        loader::MappedFile file;
+        if (!file.open(argv[1])) {
+            std::cerr << "Cannot open " << argv[1] << std::endl;
+            return 1;
+        }
+        text.assign(file.data(), file.size());
+    } else {
+        source = benchmark::make_synthetic_path(8'000'000);
+        text   = benchmark::make_gcode(source);
+    }
+
+    std::vector<gcode::PathPoint> sequential, parallel;
+    const double sequential_ms = benchmark::best_of(iterations, [&]() { sequential = parser::parse(text.data(), text.size(), text.size()); });
+    const double parallel_ms   = benchmark::best_of(iterations, [&]() { parallel = parser::parse(text.data(), text.size()); });
+
+    // chunks small enough to cut through the start G-code exercise the modal state fix-up
+    const bool chunked_equal  = same_points(sequential, parser::parse(text.data(), text.size(), 4096));
+    const bool parallel_equal = same_points(sequential, parallel);
+
+    bool source_equal = true;
+    if (!source.empty()) {
+        source_equal = sequential.size() == source.size() + 1;
+        for (size_t i = 0; source_equal && i < source.size(); ++i) {
+            const gcode::PathPoint &expected = source[i];
+            const gcode::PathPoint &parsed   = sequential[i + 1];
+            source_equal = glm::length(expected.position - parsed.position) < 1e-3f && (i + 1 == source.size() || expected.flags == parsed.flags);
+            if (!source_equal)
+                std::cout << "point " << i << " differs from the source path" << std::endl;
+        }
+    }
+
+    std::cout << text.size() / (1024 * 1024) << " MB of G-code, " << sequential.size() << " points, "
+              << std::thread::hardware_concurrency() << " hardware threads" << std::endl;
+    benchmark::report("sequential (single chunk)", sequential_ms, text.size());
+    benchmark::report("parallel chunks", parallel_ms, text.size());
+    std::cout << "parallel == sequential: " << (parallel_equal ? "yes" : "NO") << ", 4 kB chunks == sequential: " << (chunked_equal ? "yes" : "NO")
+              << (source.empty() ? "" : (source_equal ? ", matches source path" : ", DIFFERS from source path")) << std::endl;
+    return parallel_equal && chunked_equal && source_equal ? 0 : 1;
+}
@@ -0,0 +1,154 @@
+// Per-pass scans of the path, before and after the structure-of-arrays PathStore: every pass runs once the way it
+// used to over the 48-byte PathPoint records and once over the columns of the store, and both results are compared.
+// The passes are the value ranges of the legend, the scene bounding box, the enabled lines of the view filters and the
+// colors of a few visualization types. The MB columns count the bytes every pass streams through.
+//
+// usage: store_benchmark [dump_file] [iterations]
+
+#include "benchmark.h"
+#include "../loader.h"
+
+using Ranges = std::array<gcode::Range, 6>;
+
+static Ranges current_ranges()
+{
+    return {gcode::width_range, gcode::height_range, gcode::speed_range, gcode::fanspeed_range, gcode::temperature_range, gcode::volumetricrate_range};
+}
+
+// The former passes, reading whole PathPoint records
+
+static Ranges aos_ranges(const std::vector<gcode::PathPoint> &points)
+{
+    Ranges ranges;
+    for (const gcode::PathPoint &p : points) {
+        const bool extrude = p.is_extrude_move();
+        if (extrude) {
+            ranges[0].update(p.width);
+            ranges[1].update(p.height);
+            ranges[3].update(p.fanspeed);
+            ranges[4].update(p.temperature);
+            ranges[5].update(p.volumetricrate);
+        }
+        if (config::use_travel_moves_data || extrude)
+            ranges[2].update(p.speed);
+    }
+    return ranges;
+}
+
+static std::pair<glm::vec3, glm::vec3> aos_bounds(const std::vector<gcode::PathPoint> &points)
+{
+    glm::vec3 min(FLT_MAX), max(-FLT_MAX);
+    for (const gcode::PathPoint &p : points) {
+        min.x = std::min(min.x, p.position.x);
+        min.y = std::min(min.y, p.position.y);
+        min.z = std::min(min.z, p.position.z);
+        max.x = std::max(max.x, p.position.x);
+        max.y = std::max(max.y, p.position.y);
+        max.z = std::max(max.z, p.position.z);
+    }
+    return {min, max};
+}
+
+static bitset::BitSet<> aos_enabled_lines(const std::vector<gcode::PathPoint> &points, const bitset::BitSet<> &valid)
+{
+    bitset::BitSet<> enabled = valid;
+    for (size_t i = 0; i < points.size(); i++) {
+        const bool         is_travel = points[i].is_travel_move();
+        const unsigned int role      = points[i].role_from_flags();
+        if (!config::view_travel_paths && is_travel) enabled.reset(i);
+        if (!config::view_perimeters && (role == 2)) enabled.reset(i);
+        if (!config::view_inner_perimeters && (role == 1 || role == 3)) enabled.reset(i);
+        if (!config::view_internal_infill && (role == 4)) enabled.reset(i);
+        if (!config::view_solid_infills && (role == 5 || role == 6 || role == 8)) enabled.reset(i);
+        if (!config::view_supports && (role == 11 || role == 12)) enabled.reset(i);
+    }
+    return enabled;
+}
+
+static std::vector<uint8_t> aos_colors(const std::vector<gcode::PathPoint> &points)
+{
+    auto select_color = [&](const gcode::PathPoint &p) -> unsigned int {
+        const unsigned int role      = p.role_from_flags();
+        const bool         is_travel = p.is_travel_move();
+        const unsigned int travel    = gcode::Palette_Travel_First + role;
+        switch (config::visualization_type) {
+        case 0: return is_travel ? travel : role;
+        case 1: return is_travel ? travel : gcode::height_range.get_palette_index_at(p.height);
+        case 2: return is_travel ? travel : gcode::width_range.get_palette_index_at(p.width);
+        case 3: return gcode::speed_range.get_palette_index_at(p.speed);
+        case 4: return is_travel ? travel : gcode::fanspeed_range.get_palette_index_at(p.fanspeed);
+        case 5: return is_travel ? travel : gcode::temperature_range.get_palette_index_at(p.temperature);
+        case 6: return is_travel ? travel : gcode::volumetricrate_range.get_palette_index_at(p.volumetricrate);
+        case 9: return gcode::Palette_Tool_First + p.extruderid;
+        case 10: return gcode::Palette_Tool_First + p.colorid % gcode::Tools_Colors.size();
+        }
+        return gcode::Palette_Error;
+    };
+    std::vector<uint8_t> colors(points.size());
+    for (size_t i = 0; i < points.size(); i++) colors[i] = uint8_t(select_color(points[i]));
+    return colors;
+}
+
+static void report_pass(const std::string &name, double aos_ms, double store_ms, size_t aos_bytes, size_t store_bytes, bool equal)
+{
+    std::printf("%-28s %10.2f ms -> %8.2f ms %6.1fx   %7.1f -> %7.1f MB read   %s\n", name.c_str(), aos_ms, store_ms, aos_ms / store_ms,
+                double(aos_bytes) / (1024.0 * 1024.0), double(store_bytes) / (1024.0 * 1024.0), equal ? "equal" : "DIFFERENT");
+}
+
+int main(int argc, char *argv[])
+{
+    const std::string filename   = benchmark::input_or_synthetic(argc, argv, 20'000'000);
+    const size_t      iterations = argc > 2 ? std::stoul(argv[2]) : 5;
+
+    const std::vector<gcode::PathPoint> points = loader::readPathPoints(filename);
+    const gcode::PathStore              store  = gcode::to_columns(points);
+    const size_t                        count  = points.size();
+    const size_t                        aos    = count * sizeof(gcode::PathPoint);
+    std::cout << count << " points" << std::endl;
+    bool all_equal = true;
+
+    Ranges       aos_result;
+    const double ranges_aos   = benchmark::best_of(iterations, [&]() { aos_result = aos_ranges(points); });
+    const double ranges_store = benchmark::best_of(iterations, [&]() { gcode::set_ranges(store); });
+    const bool   ranges_equal = aos_result == current_ranges();
+    report_pass("ranges", ranges_aos, ranges_store, aos, count * 6 * (sizeof(unsigned int) + sizeof(float)), ranges_equal);
+    all_equal &= ranges_equal;
+
+    std::pair<glm::vec3, glm::vec3> aos_box;
+    glm::vec3                       min, max;
+    const double bounds_aos   = benchmark::best_of(iterations, [&]() { aos_box = aos_bounds(points); });
+    const double bounds_store = benchmark::best_of(iterations, [&]() {
+        min = glm::vec3(FLT_MAX);
+        max = glm::vec3(-FLT_MAX);
+        gcode::update_bounds(min, max, store.position);
+    });
+    const bool bounds_equal = aos_box.first == min && aos_box.second == max;
+    report_pass("bounding box", bounds_aos, bounds_store, aos, count * sizeof(glm::vec3), bounds_equal);
+    all_equal &= bounds_equal;
+
+    // the last point starts no segment
+    gcode::BufferedPath path;
+    path.valid_lines_bitset = bitset::BitSet<>(count);
+    for (size_t i = 0; i + 1 < count; ++i) path.valid_lines_bitset.set(i);
+    config::view_travel_paths     = false;
+    config::view_internal_infill  = false;
+    config::view_inner_perimeters = false;
+    bitset::BitSet<> aos_enabled;
+    const double enabled_aos   = benchmark::best_of(iterations, [&]() { aos_enabled = aos_enabled_lines(points, path.valid_lines_bitset); });
+    const double enabled_store = benchmark::best_of(iterations, [&]() { gcode::updateEnabledLines(path, store); });
+    const bool   enabled_equal = aos_enabled.blocks == path.enabled_lines_bitset.blocks;
+    report_pass("enabled lines", enabled_aos, enabled_store, aos, count * sizeof(unsigned int), enabled_equal);
+    all_equal &= enabled_equal;
+
+    for (int type : {0, 1, 3, 9}) {
+        config::visualization_type = type;
+        std::vector<uint8_t> aos_result_colors, store_colors;
+        const double colors_aos   = benchmark::best_of(iterations, [&]() { aos_result_colors = aos_colors(points); });
+        const double colors_store = benchmark::best_of(iterations, [&]() { store_colors = gcode::computePathColors(store); });
+        const bool   colors_equal = aos_result_colors == store_colors;
+        const size_t store_bytes  = count * (sizeof(unsigned int) + (type == 0 ? 0 : sizeof(float)));
+        report_pass("colors, visualization " + std::to_string(type), colors_aos, colors_store, aos, store_bytes, colors_equal);
+        all_equal &= colors_equal;
+    }
+    return all_equal ? 0 : 1;
+}
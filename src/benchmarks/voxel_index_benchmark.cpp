@@ -0,0 +1,212 @@
+// Index of the segments crossing every visibility box, before and after the compressed sparse rows: the former index
+// kept a hash map from the box coordinates to their id and a vector of segments per box, the BoxSegmentIndex keeps the
+// memberships of all the boxes as runs of consecutive segments in a few contiguous arrays. Both are built from the same
+// path, then filtered the way render() filters the segments of the hot boxes, a segment at a time for the former and a
+// run at a time for the new one, and the visible segments of both are compared. The box ids of the two
+// differ, the new index numbers the boxes of a level in Morton order, so the hot boxes are picked by their coordinates.
+//
+// The compressed rows are built in parallel; they are built again with 1, 2, 4... threads up to the hardware threads
+// to show how the build scales.
+//
+// Every index is built in a child process of its own, so that its peak resident memory is measured alone. The peak of
+// a child which only loaded the path is the baseline the others are compared to.
+//
+// usage: voxel_index_benchmark [dump_file] [iterations]
+
+#include "benchmark.h"
+#include "../loader.h"
+
+#if __has_include(<tbb/global_control.h>)
+#include <tbb/global_control.h>
+#define HAS_TBB_GLOBAL_CONTROL
+#endif
+
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+// The former segment list of a box, 32 bit offsets in their chunk of 2^32 segments
+struct SegmentList
+{
+    std::vector<uint32_t> offsets;
+    std::vector<size_t>   chunk_starts;
+
+    bool   empty() const { return offsets.empty(); }
+    size_t back() const { return chunk_starts.size() << 32 | offsets.back(); }
+
+    void push_back(size_t index)
+    {
+        while ((index >> 32) > chunk_starts.size()) chunk_starts.push_back(offsets.size());
+        offsets.push_back(uint32_t(index));
+    }
+
+    template<typename Function> void for_each(Function &&function) const
+    {
+        size_t position = 0;
+        for (size_t chunk = 0; chunk <= chunk_starts.size(); ++chunk) {
+            const size_t end = chunk < chunk_starts.size() ? chunk_starts[chunk] : offsets.size();
+            for (; position < end; ++position) function(chunk << 32 | offsets[position]);
+        }
+    }
+};
+
+struct Result
+{
+    double   build_ms{0.0}, filter_ms{0.0};
+    size_t   boxes{0}, memberships{0}, visible{0};
+    uint64_t checksum{0};
+};
+
+// Segments of the hot boxes, as render() sets them, summarized by their count and a checksum
+template<typename SetVisible>
+static double filter(size_t count, const std::vector<glm::ivec3> &boxes, size_t iterations, Result &result, SetVisible &&set_visible)
+{
+    // a fourth of the boxes are hot, box 0 is the empty one
+    std::vector<GLint> heat(boxes.size(), 0);
+    for (size_t b = 1; b < boxes.size(); ++b) heat[b] = ((boxes[b].x * 73856093) ^ (boxes[b].y * 19349663) ^ (boxes[b].z * 83492791)) % 4 == 0;
+    bitset::BitSet<std::atomic_size_t> visible(count);
+    const double                       ms = benchmark::best_of(iterations, [&]() {
+        visible.clear();
+        std::for_each(std::execution::par_unseq, heat.begin(), heat.end(), [&](GLint &h) {
+            if (h > 0)
+                set_visible(uint32_t(&h - heat.data()), visible);
+        });
+    });
+    for (size_t b = 0; b < visible.blocks.size(); ++b) {
+        const uint64_t block = visible.blocks[b];
+        result.visible += size_t(__builtin_popcountll(block));
+        result.checksum = (result.checksum ^ block) * 0x100000001b3ull + b;
+    }
+    return ms;
+}
+
+// Runs the measure in a child process, returns its result and the peak resident memory of the child in MB
+template<typename Measure> static std::pair<Result, double> in_child(Measure &&measure)
+{
+    int channel[2];
+    if (pipe(channel) != 0)
+        return {};
+    const pid_t child = fork();
+    if (child == 0) {
+        close(channel[0]);
+        const Result result = measure();
+        const bool   sent   = write(channel[1], &result, sizeof(result)) == ssize_t(sizeof(result));
+        _exit(sent ? 0 : 1);
+    }
+    close(channel[1]);
+    Result result;
+    const bool received = read(channel[0], &result, sizeof(result)) == ssize_t(sizeof(result));
+    close(channel[0]);
+    int           status = 0;
+    struct rusage usage {};
+    wait4(child, &status, 0, &usage);
+    if (!received) {
+        std::cerr << "The measuring process failed" << std::endl;
+        std::exit(1);
+    }
+    return {result, double(usage.ru_maxrss) / 1024.0};
+}
+
+int main(int argc, char *argv[])
+{
+    const std::string filename   = benchmark::input_or_synthetic(argc, argv, 20'000'000);
+    const size_t      iterations = argc > 2 ? std::stoul(argv[2]) : 5;
+
+    // the records are dropped once in columns, they are not part of the baseline
+    const gcode::PathStore columns = [&filename]() {
+        const std::vector<gcode::PathPoint> points = loader::readPathPoints(filename);
+        return gcode::to_columns(points);
+    }();
+    const size_t                count    = columns.count;
+    const Span<const glm::vec3> position = columns.view<gcode::Column::Position>();
+    const glm::ivec3            empty_box{std::numeric_limits<int>::min()};
+    std::cout << count << " points, voxel size " << config::voxel_size << " mm" << std::endl;
+    if (count < 2)
+        return 1;
+
+    // the valid segments of appendExtrusionPaths
+    bitset::BitSet<> valid(count);
+    for (size_t i = 0; i + 1 < count; ++i)
+        if (gcode::extract_type_from_flags(columns.flags[i]) != 8)
+            valid.set(i);
+
+    const auto [baseline, baseline_mb] = in_child([]() { return Result{}; });
+
+    const auto [former, former_mb] = in_child([&]() {
+        Result                                          result;
+        std::unordered_map<glm::ivec3, uint32_t>        ids;
+        std::vector<std::pair<glm::ivec3, SegmentList>> boxes;
+        benchmark::Timer                                timer;
+        ids[empty_box] = 0;
+        boxes.push_back({empty_box, {}});
+        for (size_t i = 0; i + 1 < count; ++i) {
+            if (!valid[i])
+                continue;
+            for (const glm::ivec3 &coords : gcode::get_covered_voxels(position[i], position[i + 1])) {
+                auto [it, inserted] = ids.try_emplace(coords, uint32_t(boxes.size()));
+                if (inserted)
+                    boxes.push_back({coords, {}});
+                SegmentList &segments = boxes[it->second].second;
+                if (segments.empty() || segments.back() != i)
+                    segments.push_back(i);
+            }
+        }
+        result.build_ms = timer.elapsed_ms();
+        result.boxes    = boxes.size();
+        std::vector<glm::ivec3> coords(boxes.size());
+        for (size_t b = 0; b < boxes.size(); ++b) {
+            result.memberships += boxes[b].second.offsets.size();
+            coords[b] = boxes[b].first;
+        }
+        result.filter_ms = filter(count, coords, iterations, result, [&boxes](uint32_t box, auto &visible) {
+            boxes[box].second.for_each([&visible](size_t segment) { visible.set_atomic(segment); });
+        });
+        return result;
+    });
+
+    // the build only with the given threads, and the filtering when asked
+    auto build_rows = [&](size_t threads, bool filtering) {
+#ifdef HAS_TBB_GLOBAL_CONTROL
+        tbb::global_control parallelism(tbb::global_control::max_allowed_parallelism, threads);
+#endif
+        Result              result;
+        gcode::BufferedPath path;
+        path.valid_lines_bitset = valid;
+        benchmark::Timer timer;
+        path.visibility_box_ids[empty_box] = 0;
+        path.visibility_box_coords.push_back(empty_box);
+        gcode::indexVisibilityBoxes(path, position, 0, count - 1);
+        result.build_ms    = timer.elapsed_ms();
+        result.boxes       = path.visibility_box_coords.size();
+        result.memberships = path.visibility_box_segments.size();
+        if (!filtering)
+            return result;
+        std::printf("compressed rows: %zu levels, %zu runs of %.2f segments, %.1f MB of rows\n", path.visibility_box_segments.levels.size(),
+                    path.visibility_box_segments.runs(), double(result.memberships) / double(std::max<size_t>(1, path.visibility_box_segments.runs())),
+                    double(path.visibility_box_segments.memory_bytes()) / (1024.0 * 1024.0));
+        std::fflush(stdout);
+        result.filter_ms = filter(count, path.visibility_box_coords, iterations, result, [&path](uint32_t box, auto &visible) {
+            path.visibility_box_segments.for_each_run(box, [&visible](size_t first, size_t count) { visible.set_range_atomic(first, first + count); });
+        });
+        return result;
+    };
+    const size_t hardware_threads = std::max(1u, std::thread::hardware_concurrency());
+    const auto [rows, rows_mb]    = in_child([&]() { return build_rows(hardware_threads, true); });
+
+    std::printf("%-28s %10s %10s %14s %10s %12s\n", "index", "build ms", "filter ms", "memberships", "peak MB", "index MB");
+    for (const auto &[name, result, mb] : {std::tuple{"hash map and segment lists", former, former_mb}, std::tuple{"compressed sparse rows", rows, rows_mb}})
+        std::printf("%-28s %10.1f %10.2f %14zu %10.1f %12.1f\n", name, result.build_ms, result.filter_ms, result.memberships, mb, mb - baseline_mb);
+    std::printf("%zu boxes, %zu visible segments, baseline %.1f MB\n", rows.boxes, rows.visible, baseline_mb);
+    const bool equal = former.boxes == rows.boxes && former.memberships == rows.memberships && former.visible == rows.visible &&
+                       former.checksum == rows.checksum;
+    std::cout << "compressed rows == former index: " << (equal ? "yes" : "NO") << std::endl;
+
+    std::printf("%-10s %10s %10s\n", "threads", "build ms", "speedup");
+    double one_thread_ms = 0.0;
+    for (size_t threads = 1; threads <= hardware_threads; threads = threads == hardware_threads ? threads + 1 : std::min(2 * threads, hardware_threads)) {
+        const double ms = in_child([&]() { return build_rows(threads, false); }).first.build_ms;
+        one_thread_ms   = threads == 1 ? ms : one_thread_ms;
+        std::printf("%-10zu %10.1f %10.2f\n", threads, ms, one_thread_ms / ms);
+    }
+    return equal ? 0 : 1;
+}
@@ -0,0 +1,152 @@
+// Voxel walks of the segments, one segment at a time by get_covered_voxels and in batches by walk_segments, which must
+// give the same voxels in the same order. They are compared on:
+//  - every segment between the points of a lattice around a voxel corner, once near the origin and once far from it:
+//    on every axis the quarters of the voxel size and the floats next to the voxel boundaries, so that the walks meet
+//    the boundaries exactly and within a rounding error,
+//  - random segments up to 20 voxels long,
+//  - the segments of the path, which are also timed.
+//
+// usage: voxel_walk_benchmark [dump_file] [iterations]
+
+#include "benchmark.h"
+#include "../loader.h"
+
+struct Comparison
+{
+    size_t segments{0}, voxels{0}, different{0};
+};
+
+// Walks the segments position[i] -> position[i + 1] of the indices both ways and counts the segments walked differently
+static Comparison compare(const std::vector<glm::vec3> &position, const std::vector<size_t> &segments)
+{
+    Comparison              comparison;
+    std::vector<glm::ivec3> voxels;
+    std::vector<uint32_t>   counts(segments.size());
+    gcode::walk_segments(position.data(), segments.data(), segments.size(), voxels, counts.data());
+    const glm::ivec3 *voxel = voxels.data();
+    for (size_t s = 0; s < segments.size(); voxel += counts[s], ++s) {
+        const std::vector<glm::ivec3> reference = gcode::get_covered_voxels(position[segments[s]], position[segments[s] + 1]);
+        if (reference.size() != counts[s] || !std::equal(reference.begin(), reference.end(), voxel)) {
+            if (comparison.different++ < 5)
+                std::printf("  different walk from (%.9g %.9g %.9g) to (%.9g %.9g %.9g)\n", position[segments[s]].x, position[segments[s]].y,
+                            position[segments[s]].z, position[segments[s] + 1].x, position[segments[s] + 1].y, position[segments[s] + 1].z);
+        }
+    }
+    comparison.segments = segments.size();
+    comparison.voxels   = voxels.size();
+    return comparison;
+}
+
+static bool report(const std::string &name, const Comparison &comparison)
+{
+    std::printf("%-36s %12zu segments %12zu voxels %8zu different\n", name.c_str(), comparison.segments, comparison.voxels, comparison.different);
+    return comparison.different == 0;
+}
+
+// Every segment between two points of the lattice around the voxel corner
+static Comparison compare_lattice(const glm::vec3 &corner)
+{
+    const float        size = config::voxel_size;
+    std::vector<float> values[3];
+    for (int axis = 0; axis < 3; ++axis) {
+        for (int quarter = -4; quarter <= 4; ++quarter) values[axis].push_back(corner[axis] + float(quarter) * 0.25f * size);
+        for (float boundary : {corner[axis] - size, corner[axis], corner[axis] + size}) {
+            values[axis].push_back(std::nextafter(boundary, -FLT_MAX));
+            values[axis].push_back(std::nextafter(boundary, FLT_MAX));
+        }
+    }
+    std::vector<glm::vec3> points;
+    for (float x : values[0])
+        for (float y : values[1])
+            for (float z : values[2]) points.push_back({x, y, z});
+
+    Comparison total;
+    for (const glm::vec3 &start : points) {
+        std::vector<glm::vec3> position;
+        std::vector<size_t>    segments;
+        for (const glm::vec3 &end : points) {
+            segments.push_back(position.size());
+            position.push_back(start);
+            position.push_back(end);
+        }
+        const Comparison comparison = compare(position, segments);
+        total.segments += comparison.segments;
+        total.voxels += comparison.voxels;
+        total.different += comparison.different;
+    }
+    return total;
+}
+
+int main(int argc, char *argv[])
+{
+    const std::string filename   = benchmark::input_or_synthetic(argc, argv, 20'000'000);
+    const size_t      iterations = argc > 2 ? std::stoul(argv[2]) : 5;
+    bool              equal      = true;
+
+    std::printf("voxel size %g mm\n", config::voxel_size);
+    equal &= report("lattice at the origin", compare_lattice(glm::vec3(0.0f)));
+    equal &= report("lattice far from the origin", compare_lattice(glm::vec3(150.0f, -200.0f, 40.0f) * config::voxel_size));
+
+    std::mt19937                          rng(42);
+    std::uniform_real_distribution<float> coordinate(-100.0f, 100.0f), offset(-10.0f * config::voxel_size, 10.0f * config::voxel_size);
+    std::vector<glm::vec3>                random_position;
+    std::vector<size_t>                   random_segments;
+    for (size_t s = 0; s < 1'000'000; ++s) {
+        const glm::vec3 start(coordinate(rng), coordinate(rng), coordinate(rng));
+        random_segments.push_back(random_position.size());
+        random_position.push_back(start);
+        random_position.push_back(start + glm::vec3(offset(rng), offset(rng), offset(rng)));
+    }
+    equal &= report("random segments", compare(random_position, random_segments));
+
+    // the drawn segments of the path
+    const gcode::PathStore columns = [&filename]() {
+        const std::vector<gcode::PathPoint> points = loader::readPathPoints(filename);
+        return gcode::to_columns(points);
+    }();
+    const std::vector<glm::vec3> position(columns.position.begin(), columns.position.end());
+    std::vector<size_t>          segments;
+    for (size_t i = 0; i + 1 < columns.count; ++i)
+        if (gcode::extract_type_from_flags(columns.flags[i]) != 8)
+            segments.push_back(i);
+    const Comparison path = compare(position, segments);
+    equal &= report("path segments", path);
+    size_t single = 0;
+    for (size_t i : segments) single += gcode::voxel_coords(position[i]) == gcode::voxel_coords(position[i + 1]);
+    std::printf("%.1f%% of the path segments within a voxel, %.2f voxels a segment\n", 100.0 * double(single) / double(segments.size()),
+                double(path.voxels) / double(segments.size()));
+
+    volatile size_t touched   = 0;
+    const double    scalar_ms = benchmark::best_of(iterations, [&]() {
+        size_t sum = 0;
+        for (size_t i : segments)
+            for (const glm::ivec3 &voxel : gcode::get_covered_voxels(position[i], position[i + 1])) sum += size_t(voxel.x);
+        touched = sum;
+    });
+    std::vector<glm::ivec3> voxels;
+    std::vector<uint32_t>   counts;
+    const double            batched_ms = benchmark::best_of(iterations, [&]() {
+        size_t           sum   = 0;
+        constexpr size_t Batch = 4096;
+        for (size_t first = 0; first < segments.size(); first += Batch) {
+            const size_t count = std::min(Batch, segments.size() - first);
+            counts.resize(count);
+            voxels.clear();
+            gcode::walk_segments(position.data(), segments.data() + first, count, voxels, counts.data());
+            for (const glm::ivec3 &voxel : voxels) sum += size_t(voxel.x);
+        }
+        touched = sum;
+    });
+#if defined(__AVX__)
+    const char *lanes = "AVX, 4 lanes";
+#elif defined(__SSE2__) || defined(_M_X64)
+    const char *lanes = "SSE2, 2 lanes";
+#else
+    const char *lanes = "scalar";
+#endif
+    std::printf("%-36s %10.1f ms %8.1f Msegments/s\n", "get_covered_voxels", scalar_ms, double(segments.size()) / scalar_ms / 1000.0);
+    std::printf("%-36s %10.1f ms %8.1f Msegments/s %6.2fx\n", (std::string("walk_segments, ") + lanes).c_str(), batched_ms,
+                double(segments.size()) / batched_ms / 1000.0, scalar_ms / batched_ms);
+    std::cout << "walk_segments == get_covered_voxels: " << (equal ? "yes" : "NO") << std::endl;
+    return equal ? 0 : 1;
+}
@@ -0,0 +1,305 @@
+#ifndef BGCODE_H_
+#define BGCODE_H_
+
+#include "gcode.h"
+#include "loader.h"
+#include "parser.h"
+
+#include <zlib.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <execution>
+#include <iostream>
+#include <numeric>
+#include <string>
+#include <vector>
+
+// Reader of Prusa binary G-code (.bgcode).
+//
+// The file is a 10 byte header ("GCDE", u32 version, u16 checksum type) followed by blocks. Every block has a header
+// (u16 type, u16 compression, u32 uncompressed size, u32 compressed size when compressed), parameters (u16 encoding,
+// thumbnails have 6 bytes), its data and a CRC32 of all of these when the file has checksums. The G-code blocks are
+// compressed independently (Deflate or Heatshrink) and may be MeatPack encoded, so they are decoded in parallel
+// and the resulting text goes through the regular G-code parser.
+namespace bgcode {
+
+static const char     Magic[4]         = {'G', 'C', 'D', 'E'};
+static const uint32_t Version          = 1;
+static const size_t   File_Header_Size = 10;
+
+enum class BlockType : uint16_t { FileMetadata, GCode, SlicerMetadata, PrinterMetadata, PrintMetadata, Thumbnail };
+enum class Compression : uint16_t { None, Deflate, Heatshrink_11_4, Heatshrink_12_4 };
+enum class GCodeEncoding : uint16_t { None, MeatPack, MeatPackComments };
+enum class ChecksumType : uint16_t { None, CRC32 };
+
+struct Block
+{
+    BlockType   type;
+    Compression compression;
+    uint16_t    encoding;
+    uint32_t    uncompressed_size;
+    size_t      begin;       // offset of the block header
+    size_t      data_offset; // offset of the (compressed) data
+    size_t      data_size;
+    size_t      end;         // offset past the checksum
+};
+
+struct FileInfo
+{
+    uint32_t           version{0};
+    ChecksumType       checksum{ChecksumType::None};
+    std::vector<Block> blocks;
+};
+
+template<typename T> static T get(const char *p)
+{
+    T value;
+    std::memcpy(&value, p, sizeof(T));
+    return value;
+}
+
+static bool has_magic(const char *data, size_t size) { return size >= sizeof(Magic) && std::memcmp(data, Magic, sizeof(Magic)) == 0; }
+
+// Walks the block headers, the data is not touched
+static bool read_structure(const char *data, size_t size, FileInfo &info)
+{
+    info = {};
+    if (size < File_Header_Size || !has_magic(data, size)) {
+        std::cerr << "Not a binary G-code file" << std::endl;
+        return false;
+    }
+    info.version  = get<uint32_t>(data + 4);
+    info.checksum = static_cast<ChecksumType>(get<uint16_t>(data + 8));
+    if (info.version > Version || info.checksum > ChecksumType::CRC32) {
+        std::cerr << "Unsupported binary G-code version " << info.version << std::endl;
+        return false;
+    }
+
+    const size_t checksum_size = info.checksum == ChecksumType::CRC32 ? 4 : 0;
+    size_t       offset        = File_Header_Size;
+    while (offset < size) {
+        if (size - offset < 8)
+            break;
+        Block block;
+        block.begin             = offset;
+        block.type              = static_cast<BlockType>(get<uint16_t>(data + offset));
+        block.compression       = static_cast<Compression>(get<uint16_t>(data + offset + 2));
+        block.uncompressed_size = get<uint32_t>(data + offset + 4);
+        size_t header_size      = 8;
+        block.data_size         = block.uncompressed_size;
+        if (block.compression != Compression::None) {
+            if (size - offset < 12)
+                break;
+            block.data_size = get<uint32_t>(data + offset + 8);
+            header_size     = 12;
+        }
+        const size_t parameters_size = block.type == BlockType::Thumbnail ? 6 : 2;
+        if (block.type > BlockType::Thumbnail || block.compression > Compression::Heatshrink_12_4 ||
+            size - offset < header_size + parameters_size + block.data_size + checksum_size) {
+            break;
+        }
+        block.encoding    = get<uint16_t>(data + offset + header_size);
+        block.data_offset = offset + header_size + parameters_size;
+        block.end         = block.data_offset + block.data_size + checksum_size;
+        info.blocks.push_back(block);
+        offset = block.end;
+    }
+    if (offset != size) {
+        std::cerr << "Binary G-code block at offset " << offset << " is invalid or truncated" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// LZSS stream of heatshrink: a 1 bit tag, then either an 8 bit literal or a window_bits back reference index
+// followed by a lookahead_bits count, most significant bit first
+static bool heatshrink_decode(const uint8_t *in, size_t in_size, unsigned int window_bits, unsigned int lookahead_bits, size_t out_size,
+                              std::string &out)
+{
+    out.clear();
+    out.reserve(out_size);
+    size_t bit_position = 0;
+    auto   get_bits     = [&](unsigned int count, uint32_t &value) {
+        if (bit_position + count > in_size * 8)
+            return false;
+        value = 0;
+        for (unsigned int i = 0; i < count; ++i, ++bit_position)
+            value = (value << 1) | ((in[bit_position >> 3] >> (7 - (bit_position & 7))) & 1);
+        return true;
+    };
+
+    uint32_t tag, value, count;
+    while (out.size() < out_size && get_bits(1, tag)) {
+        if (tag != 0) {
+            if (!get_bits(8, value))
+                break;
+            out.push_back(char(value));
+        } else {
+            if (!get_bits(window_bits, value) || !get_bits(lookahead_bits, count))
+                break;
+            // the window of the decoder starts zero filled
+            const size_t distance = size_t(value) + 1;
+            for (uint32_t i = 0; i <= count && out.size() < out_size; ++i)
+                out.push_back(distance <= out.size() ? out[out.size() - distance] : '\0');
+        }
+    }
+    return out.size() == out_size;
+}
+
+// MeatPack packs two characters of the most frequent ones in a byte, 0xF marks a character sent as a full byte
+// after the packed one. 0xFF 0xFF introduces a command, which switches the packing or the space omission.
+static void meatpack_decode(const uint8_t *in, size_t in_size, std::string &out)
+{
+    enum : uint8_t { Signal = 0xFF, Enable_Packing = 251, Disable_Packing = 250, Reset_All = 249, Enable_No_Spaces = 247, Disable_No_Spaces = 246 };
+    static const char Lookup[16] = {'0', '1', '2', '3', '4', '5', '6', '7', '8', '9', '.', ' ', '\n', 'G', 'X', '\0'};
+
+    out.clear();
+    out.reserve(in_size * 2);
+    bool   packing = false, no_spaces = false, command_next = false;
+    size_t signal_count = 0, full_chars = 0;
+    char   held         = 0;
+
+    auto unpack = [&](uint8_t nibble) { return nibble == 0xB && no_spaces ? 'E' : Lookup[nibble]; };
+    auto handle = [&](uint8_t c) {
+        if (!packing) {
+            out.push_back(char(c));
+        } else if (full_chars > 0) {
+            out.push_back(char(c));
+            if (held != 0) {
+                out.push_back(held);
+                held = 0;
+            }
+            --full_chars;
+        } else if ((c & 0x0F) == 0x0F) {
+            ++full_chars;
+            if ((c & 0xF0) == 0xF0)
+                ++full_chars;
+            else
+                held = unpack(c >> 4);
+        } else {
+            const char first = unpack(c & 0x0F);
+            out.push_back(first);
+            if (first != '\n') {
+                if ((c & 0xF0) == 0xF0)
+                    ++full_chars;
+                else
+                    out.push_back(unpack(c >> 4));
+            }
+        }
+    };
+
+    for (size_t i = 0; i < in_size; ++i) {
+        const uint8_t c = in[i];
+        if (c == Signal) {
+            if (signal_count > 0) {
+                command_next = true;
+                signal_count = 0;
+            } else {
+                ++signal_count;
+            }
+        } else if (command_next) {
+            switch (c) {
+            case Enable_Packing: packing = true; break;
+            case Disable_Packing:
+            case Reset_All: packing = false; break;
+            case Enable_No_Spaces: no_spaces = true; break;
+            case Disable_No_Spaces: no_spaces = false; break;
+            }
+            command_next = false;
+        } else {
+            if (signal_count > 0) {
+                handle(Signal);
+                signal_count = 0;
+            }
+            handle(c);
+        }
+    }
+}
+
+// Decompresses and decodes a G-code block into text, verifying its checksum
+static bool decode_gcode_block(const char *data, const Block &block, ChecksumType checksum, std::string &out)
+{
+    if (checksum == ChecksumType::CRC32) {
+        const size_t covered  = block.data_offset + block.data_size - block.begin;
+        const uLong  computed = crc32_z(0L, reinterpret_cast<const Bytef *>(data + block.begin), covered);
+        if (uint32_t(computed) != get<uint32_t>(data + block.data_offset + block.data_size)) {
+            std::cerr << "Checksum mismatch in binary G-code block at offset " << block.begin << std::endl;
+            return false;
+        }
+    }
+
+    const uint8_t *in = reinterpret_cast<const uint8_t *>(data + block.data_offset);
+    std::string    decompressed;
+    bool           ok = true;
+    switch (block.compression) {
+    case Compression::None: decompressed.assign(data + block.data_offset, block.data_size); break;
+    case Compression::Deflate: {
+        decompressed.resize(block.uncompressed_size);
+        uLongf size = block.uncompressed_size;
+        ok          = uncompress(reinterpret_cast<Bytef *>(decompressed.data()), &size, in, uLong(block.data_size)) == Z_OK &&
+             size == block.uncompressed_size;
+        break;
+    }
+    case Compression::Heatshrink_11_4: ok = heatshrink_decode(in, block.data_size, 11, 4, block.uncompressed_size, decompressed); break;
+    case Compression::Heatshrink_12_4: ok = heatshrink_decode(in, block.data_size, 12, 4, block.uncompressed_size, decompressed); break;
+    }
+    if (!ok) {
+        std::cerr << "Cannot decompress binary G-code block at offset " << block.begin << std::endl;
+        return false;
+    }
+
+    if (static_cast<GCodeEncoding>(block.encoding) == GCodeEncoding::None)
+        out = std::move(decompressed);
+    else
+        meatpack_decode(reinterpret_cast<const uint8_t *>(decompressed.data()), decompressed.size(), out);
+    return true;
+}
+
+// Text of the G-code blocks among blocks [first, last), decoded in parallel and concatenated in order
+static bool decode_gcode(const char *data, const FileInfo &info, size_t first, size_t last, std::string &text)
+{
+    std::vector<size_t> indices;
+    for (size_t i = first; i < last; ++i)
+        if (info.blocks[i].type == BlockType::GCode)
+            indices.push_back(i);
+
+    std::vector<std::string> texts(indices.size());
+    std::vector<char>        decoded(indices.size());
+    std::vector<size_t>      slots(indices.size());
+    std::iota(slots.begin(), slots.end(), 0);
+    std::for_each(std::execution::par, slots.begin(), slots.end(),
+                  [&](size_t s) { decoded[s] = decode_gcode_block(data, info.blocks[indices[s]], info.checksum, texts[s]); });
+
+    size_t size = text.size();
+    for (const std::string &t : texts) size += t.size();
+    text.reserve(size);
+    for (const std::string &t : texts) text += t;
+    return std::all_of(decoded.begin(), decoded.end(), [](char ok) { return ok != 0; });
+}
+
+static bool is_bgcode_file(const std::string &filename)
+{
+    std::ifstream file(filename, std::ios::binary);
+    char          magic[sizeof(Magic)] = {};
+    return file.read(magic, sizeof(magic)) && has_magic(magic, sizeof(magic));
+}
+
+static std::vector<gcode::PathPoint> parse_file(const std::string &filename, size_t chunk_size = parser::Default_Chunk_Size)
+{
+    loader::MappedFile file;
+    if (!file.open(filename)) {
+        std::cerr << "Error opening file: " << filename << std::endl;
+        return {};
+    }
+    FileInfo    info;
+    std::string text;
+    if (!read_structure(file.data(), file.size(), info) || !decode_gcode(file.data(), info, 0, info.blocks.size(), text))
+        return {};
+    return parser::parse(text.data(), text.size(), chunk_size);
+}
+
+} // namespace bgcode
+
+#endif /* BGCODE_H_ */
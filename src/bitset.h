@@ -1,7 +1,11 @@
 #ifndef BITSET_H_
 #define BITSET_H_
 
+#include <algorithm>
 #include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
 #include <vector>
 
 namespace bitset {
@@ -16,26 +20,53 @@ template<typename T = unsigned long long>
 class BitSet
 {
 public:
-    BitSet(unsigned int size) : size(size), blocks(1 + (size / (sizeof(T) * 8))) { clear(); }
+    BitSet(size_t size) : size(size), blocks(1 + (size / (sizeof(T) * 8))) { clear(); }
 
     BitSet() : size(0), blocks(0) {}
 
     void clear()
     {
-        for (unsigned int i = 0; i < blocks.size(); ++i) {
+        for (size_t i = 0; i < blocks.size(); ++i) {
             blocks[i] &= T(0);
         }
     }
 
     void setAll()
     {
-        for (unsigned int i = 0; i < blocks.size(); ++i) {
+        for (size_t i = 0; i < blocks.size(); ++i) {
             blocks[i] |= ~T(0);
         }
     }
 
+    // Grows the set, new bits are cleared. The blocks grow geometrically, so growing by small steps is
+    // proportional to the added bits.
+    template<typename U = T> inline typename std::enable_if<!is_atomic<U>, void>::type grow(size_t new_size)
+    {
+        assert(new_size >= size);
+        clear_range(size, new_size);
+        blocks.resize(1 + (new_size / (sizeof(T) * 8)), T(0));
+        size = new_size;
+    }
+
+    // Atomic blocks cannot be moved, so they are copied to a twice larger vector when they run out.
+    // The set may then hold more blocks than its size needs, they stay cleared.
+    template<typename U = T> inline typename std::enable_if<is_atomic<U>, void>::type grow(size_t new_size)
+    {
+        assert(new_size >= size);
+        clear_range(size, new_size);
+        const size_t needed = 1 + (new_size / (sizeof(T) * 8));
+        if (needed > blocks.size()) {
+            std::vector<T> grown(std::max(needed, 2 * blocks.size()));
+            for (size_t i = 0; i < grown.size(); ++i) {
+                grown[i].store(i < blocks.size() ? blocks[i].load(std::memory_order_relaxed) : 0, std::memory_order_relaxed);
+            }
+            blocks.swap(grown);
+        }
+        size = new_size;
+    }
+
     //return true if bit changed
-    bool set(unsigned int index)
+    bool set(size_t index)
     {
         const auto [block_idx, bit_idx] = get_coords(index);
         T mask = (T(1) << bit_idx);
@@ -45,7 +76,7 @@ public:
     }
 
     //return true if bit changed
-    bool reset(unsigned int index)
+    bool reset(size_t index)
     {
         const auto [block_idx, bit_idx] = get_coords(index);
         T mask = (T(1) << bit_idx);
@@ -54,35 +85,26 @@ public:
          return flip;
     }
 
-    bool operator[](unsigned int index) const
+    bool operator[](size_t index) const
     {
         const auto [block_idx, bit_idx] = get_coords(index);
         return ((blocks[block_idx] >> bit_idx) & 1) != 0;
     }
 
-    template<typename D, typename U = T>
-    inline typename std::enable_if<!is_atomic<U>, void>::type get_enabled_indices(std::vector<D> &dest) const
-    {
-        for (unsigned int block_idx = 0; block_idx < blocks.size(); ++block_idx) {
-            T block = blocks[block_idx];
-            while (block != 0) {
-                unsigned int bit_idx = __builtin_ctzll(block); // Find the index of the least significant bit
-                unsigned int index   = block_idx * (sizeof(T) * 8) + bit_idx;
-                dest.push_back(index);
-                block &= (block - 1); // Clear the least significant bit
-            }
-        }
-    }
-
-    template<typename D, typename U = T>
-    inline typename std::enable_if<is_atomic<U>, void>::type get_enabled_indices(std::vector<D> &dest) const
+    // Appends the indices of the set bits in [begin, end) to dest, as offsets from begin. begin is a multiple of the
+    // block size, so that a large set can be collected in pieces whose offsets fit in 32 bits.
+    template<typename D> void get_enabled_indices(std::vector<D> &dest, size_t begin = 0, size_t end = SIZE_MAX) const
     {
-        for (unsigned int block_idx = 0; block_idx < blocks.size(); ++block_idx) {
-            T block = blocks[block_idx].load();
+        assert(begin % (sizeof(T) * 8) == 0);
+        const size_t last_block = std::min(blocks.size(), end / (sizeof(T) * 8) + 1);
+        for (size_t block_idx = begin / (sizeof(T) * 8); block_idx < last_block; ++block_idx) {
+            auto block = block_value(block_idx);
             while (block != 0) {
                 unsigned int bit_idx = __builtin_ctzll(block); // Find the index of the least significant bit
-                unsigned int index   = block_idx * (sizeof(T) * 8) + bit_idx;
-                dest.push_back(index);
+                size_t       index   = block_idx * (sizeof(T) * 8) + bit_idx;
+                if (index >= end)
+                    break;
+                dest.push_back(D(index - begin));
                 block &= (block - 1); // Clear the least significant bit
             }
         }
@@ -92,14 +114,19 @@ public:
     BitSet& operator&=(const BitSet<U> &other)
     {
         static_assert(sizeof(T) == sizeof(U), "Type1 and Type2 must be of the same size.");
-        for (unsigned int i = 0; i < blocks.size(); ++i) {
+        // grown sets may hold a different number of blocks
+        const size_t common = std::min(blocks.size(), other.blocks.size());
+        for (size_t i = 0; i < common; ++i) {
             blocks[i] &= other.blocks[i];
         }
+        for (size_t i = common; i < blocks.size(); ++i) {
+            blocks[i] &= T(0);
+        }
         return *this;
     }
 
     // Atomic set operation (enabled only for atomic types), return true if bit changed
-    template<typename U = T> inline typename std::enable_if<is_atomic<U>, bool>::type set_atomic(unsigned int index)
+    template<typename U = T> inline typename std::enable_if<is_atomic<U>, bool>::type set_atomic(size_t index)
     {
         const auto [block_idx, bit_idx] = get_coords(index);
         T mask                          = static_cast<T>(1) << bit_idx;
@@ -108,7 +135,7 @@ public:
     }
 
     // Atomic reset operation (enabled only for atomic types), return true if bit changed
-    template<typename U = T> inline typename std::enable_if<is_atomic<U>, bool>::type reset_atomic(unsigned int index)
+    template<typename U = T> inline typename std::enable_if<is_atomic<U>, bool>::type reset_atomic(size_t index)
     {
         const auto [block_idx, bit_idx] = get_coords(index);
         T mask                          = ~(static_cast<T>(1) << bit_idx);
@@ -116,15 +143,52 @@ public:
         return oldval xor (oldval and mask);
     }
 
-    std::pair<unsigned int, unsigned int> get_coords(unsigned int index) const
+    // Atomic set of the bits [begin, end), a block at a time (enabled only for atomic types)
+    template<typename U = T> inline typename std::enable_if<is_atomic<U>, void>::type set_range_atomic(size_t begin, size_t end)
+    {
+        using V = typename U::value_type;
+        while (begin < end) {
+            const auto [block_idx, bit_idx] = get_coords(begin);
+            const size_t bits               = std::min<size_t>(sizeof(T) * 8 - bit_idx, end - begin);
+            const V      mask               = (bits == sizeof(T) * 8 ? ~V(0) : (V(1) << bits) - 1) << bit_idx;
+            blocks[block_idx].fetch_or(mask, std::memory_order_relaxed);
+            begin += bits;
+        }
+    }
+
+    // Clears the bits [begin, end) which are backed by the current blocks, setAll() also sets the bits past size
+    void clear_range(size_t begin, size_t end)
+    {
+        const size_t capacity = blocks.size() * sizeof(T) * 8;
+        end = std::min(end, capacity);
+        while (begin < end && begin % (sizeof(T) * 8) != 0) {
+            reset(begin++);
+        }
+        for (; begin + sizeof(T) * 8 <= end; begin += sizeof(T) * 8) {
+            blocks[begin / (sizeof(T) * 8)] &= T(0);
+        }
+        while (begin < end) {
+            reset(begin++);
+        }
+    }
+
+    std::pair<size_t, unsigned int> get_coords(size_t index) const
     {
-        unsigned int block_idx = index / (sizeof(T) * 8);
+        size_t       block_idx = index / (sizeof(T) * 8);
         unsigned int bit_idx   = index % (sizeof(T) * 8);
         return std::make_pair(block_idx, bit_idx);
     }
 
-    unsigned int   size;
+    size_t         size;
     std::vector<T> blocks;
+
+private:
+    template<typename U = T> inline typename std::enable_if<!is_atomic<U>, T>::type block_value(size_t block_idx) const { return blocks[block_idx]; }
+
+    template<typename U = T> inline typename std::enable_if<is_atomic<U>, typename U::value_type>::type block_value(size_t block_idx) const
+    {
+        return blocks[block_idx].load();
+    }
 };
 
 } // namespace bitset
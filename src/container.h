@@ -0,0 +1,285 @@
+#ifndef CONTAINER_H_
+#define CONTAINER_H_
+
+#include "gcode.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Versioned columnar container for path data.
+//
+// All integers are little endian, independent of the host.
+//   Header       magic "GCPC", u32 version, u64 points count, u32 columns count, u32 reserved
+//   Column table columns count entries of: u32 column id, u32 element type, u32 components, u32 reserved, u64 offset, u64 size
+//   Data         column blobs, each starting at a multiple of Column_Alignment from the file start
+// Unknown column ids are skipped by readers, so columns can be added without bumping the version.
+namespace container {
+
+static const char     Magic[4]         = {'G', 'C', 'P', 'C'};
+static const uint32_t Version          = 1;
+static const uint64_t Column_Alignment = 64;
+static const size_t   Header_Size      = 24;
+static const size_t   Column_Entry_Size = 32;
+
+enum class ElementType : uint32_t { Float32 = 1, UInt32 = 2 };
+
+static ElementType element_type(gcode::Column column)
+{
+    switch (column) {
+    case gcode::Column::Flags:
+    case gcode::Column::ExtruderId:
+    case gcode::Column::ColorId: return ElementType::UInt32;
+    default: return ElementType::Float32;
+    }
+}
+
+static uint32_t components(gcode::Column column) { return column == gcode::Column::Position ? 3 : 1; }
+
+static bool host_is_little_endian()
+{
+    const uint32_t value = 1;
+    uint8_t        first;
+    std::memcpy(&first, &value, 1);
+    return first == 1;
+}
+
+// Columns only hold 4 byte elements, so swapping 4 byte words covers all of them
+static void swap_words(void *data, size_t bytes)
+{
+    uint8_t *p = static_cast<uint8_t *>(data);
+    for (size_t i = 0; i + 4 <= bytes; i += 4) {
+        std::swap(p[i], p[i + 3]);
+        std::swap(p[i + 1], p[i + 2]);
+    }
+}
+
+template<typename T> static void put(std::vector<uint8_t> &out, T value)
+{
+    for (size_t i = 0; i < sizeof(T); ++i) out.push_back(uint8_t(uint64_t(value) >> (8 * i)));
+}
+
+template<typename T> static T get(const uint8_t *in)
+{
+    uint64_t value = 0;
+    for (size_t i = 0; i < sizeof(T); ++i) value |= uint64_t(in[i]) << (8 * i);
+    return T(value);
+}
+
+struct ColumnEntry
+{
+    gcode::Column column;
+    ElementType   type;
+    uint32_t      components;
+    uint64_t      offset;
+    uint64_t      size;
+};
+
+struct Header
+{
+    uint32_t                 version{0};
+    uint64_t                 points_count{0};
+    std::vector<ColumnEntry> columns;
+};
+
+static bool has_magic(const char *data, size_t size) { return size >= sizeof(Magic) && std::memcmp(data, Magic, sizeof(Magic)) == 0; }
+
+static bool is_container(const std::string &filename)
+{
+    std::ifstream file(filename, std::ios::binary);
+    char          magic[sizeof(Magic)];
+    return file.read(magic, sizeof(magic)) && has_magic(magic, sizeof(magic));
+}
+
+// Parses header and column table, validating them against the file size
+static bool parse_header(const uint8_t *data, size_t file_size, Header &header)
+{
+    if (file_size < Header_Size || !has_magic(reinterpret_cast<const char *>(data), file_size)) {
+        std::cerr << "Not a path container" << std::endl;
+        return false;
+    }
+    header.version       = get<uint32_t>(data + 4);
+    header.points_count  = get<uint64_t>(data + 8);
+    const uint32_t count = get<uint32_t>(data + 16);
+    if (header.version > Version) {
+        std::cerr << "Unsupported path container version " << header.version << std::endl;
+        return false;
+    }
+    if (Header_Size + uint64_t(count) * Column_Entry_Size > file_size) {
+        std::cerr << "Path container column table is truncated" << std::endl;
+        return false;
+    }
+
+    for (uint32_t i = 0; i < count; ++i) {
+        const uint8_t *entry = data + Header_Size + i * Column_Entry_Size;
+        const uint32_t id    = get<uint32_t>(entry);
+        ColumnEntry    column{static_cast<gcode::Column>(id), static_cast<ElementType>(get<uint32_t>(entry + 4)), get<uint32_t>(entry + 8),
+                           get<uint64_t>(entry + 16), get<uint64_t>(entry + 24)};
+        if (id >= static_cast<uint32_t>(gcode::Column::Count))
+            continue;
+        if (column.type != element_type(column.column) || column.components != components(column.column) ||
+            column.size != header.points_count * gcode::PathStore::element_size(column.column) || column.offset + column.size > file_size) {
+            std::cerr << "Invalid path container column " << id << std::endl;
+            return false;
+        }
+        header.columns.push_back(column);
+    }
+    return true;
+}
+
+// Writes the loaded columns of the given PathStore
+static bool write(const std::string &filename, const gcode::PathStore &columns)
+{
+    std::vector<uint32_t> present;
+    for (uint32_t c = 0; c < static_cast<uint32_t>(gcode::Column::Count); ++c)
+        if (columns.has(static_cast<gcode::Column>(c)))
+            present.push_back(c);
+
+    std::vector<uint8_t> header;
+    header.insert(header.end(), Magic, Magic + sizeof(Magic));
+    put<uint32_t>(header, Version);
+    put<uint64_t>(header, columns.count);
+    put<uint32_t>(header, uint32_t(present.size()));
+    put<uint32_t>(header, 0);
+
+    auto align = [](uint64_t offset) { return (offset + Column_Alignment - 1) / Column_Alignment * Column_Alignment; };
+
+    uint64_t offset = align(Header_Size + present.size() * Column_Entry_Size);
+    for (uint32_t c : present) {
+        const gcode::Column column = static_cast<gcode::Column>(c);
+        const uint64_t      size   = columns.count * gcode::PathStore::element_size(column);
+        put<uint32_t>(header, c);
+        put<uint32_t>(header, static_cast<uint32_t>(element_type(column)));
+        put<uint32_t>(header, components(column));
+        put<uint32_t>(header, 0);
+        put<uint64_t>(header, offset);
+        put<uint64_t>(header, size);
+        offset = align(offset + size);
+    }
+
+    std::ofstream file(filename, std::ios::binary);
+    if (!file) {
+        std::cerr << "Error opening file: " << filename << std::endl;
+        return false;
+    }
+    file.write(reinterpret_cast<const char *>(header.data()), std::streamsize(header.size()));
+
+    const bool           swap = !host_is_little_endian();
+    std::vector<uint8_t> swapped;
+    const char           padding[Column_Alignment] = {};
+    for (uint32_t c : present) {
+        const gcode::Column column = static_cast<gcode::Column>(c);
+        const size_t        size   = columns.count * gcode::PathStore::element_size(column);
+        file.write(padding, std::streamsize(align(uint64_t(file.tellp())) - uint64_t(file.tellp())));
+        const char *data = static_cast<const char *>(columns.column_data(column));
+        if (swap) {
+            swapped.assign(data, data + size);
+            swap_words(swapped.data(), size);
+            data = reinterpret_cast<const char *>(swapped.data());
+        }
+        file.write(data, std::streamsize(size));
+    }
+    return bool(file);
+}
+
+// Reader of a path container, columns are read from the file straight into PathStore.
+// The file stays open, so columns which were skipped can be loaded later by load_columns.
+class Reader
+{
+public:
+    bool open(const std::string &filename)
+    {
+        m_header = {};
+        m_file   = std::ifstream(filename, std::ios::binary | std::ios::ate);
+        if (!m_file) {
+            std::cerr << "Error opening file: " << filename << std::endl;
+            return false;
+        }
+        const size_t file_size = size_t(m_file.tellg());
+        m_file.seekg(0);
+
+        // header and column table only
+        std::vector<uint8_t> table(std::min<size_t>(file_size, Header_Size));
+        m_file.read(reinterpret_cast<char *>(table.data()), std::streamsize(table.size()));
+        if (table.size() == Header_Size) {
+            const uint64_t count = get<uint32_t>(table.data() + 16);
+            table.resize(size_t(std::min<uint64_t>(file_size, Header_Size + count * Column_Entry_Size)));
+            m_file.read(reinterpret_cast<char *>(table.data() + Header_Size), std::streamsize(table.size() - Header_Size));
+        }
+        return m_file && parse_header(table.data(), file_size, m_header);
+    }
+
+    size_t points_count() const { return size_t(m_header.points_count); }
+
+    unsigned int available_columns() const
+    {
+        unsigned int mask = 0;
+        for (const ColumnEntry &entry : m_header.columns) mask |= gcode::column_bit(entry.column);
+        return mask;
+    }
+
+    // Loads the requested columns which are present in the file, returns false if some of them are missing
+    bool load_columns(gcode::PathStore &columns, unsigned int mask)
+    {
+        columns.count = points_count();
+        for (const ColumnEntry &entry : m_header.columns) {
+            if ((mask & gcode::column_bit(entry.column)) == 0 || columns.has(entry.column))
+                continue;
+            if (!read_column(entry, columns.resize_column(entry.column), 0, columns.count))
+                return false;
+        }
+        return (columns.loaded_columns & mask) == mask;
+    }
+
+    // Loads the rows [first, first + count) of the requested columns, the columns hold only these rows afterwards
+    bool load_rows(gcode::PathStore &columns, unsigned int mask, size_t first, size_t count)
+    {
+        assert(first + count <= points_count());
+        columns.count          = count;
+        columns.loaded_columns = 0;
+        for (const ColumnEntry &entry : m_header.columns) {
+            if ((mask & gcode::column_bit(entry.column)) == 0)
+                continue;
+            if (!read_column(entry, columns.resize_column(entry.column), first, count))
+                return false;
+        }
+        return (columns.loaded_columns & mask) == mask;
+    }
+
+private:
+    bool read_column(const ColumnEntry &entry, void *dest, size_t first, size_t count)
+    {
+        const size_t element_size = gcode::PathStore::element_size(entry.column);
+        m_file.seekg(std::streamoff(entry.offset + first * element_size));
+        if (!m_file.read(static_cast<char *>(dest), std::streamsize(count * element_size))) {
+            std::cerr << "Error reading path container column " << static_cast<unsigned int>(entry.column) << std::endl;
+            m_file.clear();
+            return false;
+        }
+        if (!host_is_little_endian())
+            swap_words(dest, count * element_size);
+        return true;
+    }
+
+    std::ifstream m_file;
+    Header        m_header;
+};
+
+// Reads the requested columns of a path container
+static bool read(const std::string &filename, gcode::PathStore &columns, unsigned int mask = gcode::All_Columns)
+{
+    Reader reader;
+    if (!reader.open(filename))
+        return false;
+    if (!reader.load_columns(columns, mask))
+        std::cerr << "Some columns are missing in " << filename << std::endl;
+    return true;
+}
+
+} // namespace container
+
+#endif /* CONTAINER_H_ */
@@ -8,10 +8,14 @@
 #include "bitset.h"
 #include "glad/glad.h"
 #include "glm/geometric.hpp"
+#include "glm/gtc/constants.hpp"
 #include "globals.h"
 #include "camera.h"
+#include "span.h"
 
 #include <cstddef>
+#include <cstdint>
+#include <cstring>
 #include <math.h>
 #include <unordered_map>
 #include <unordered_set>
@@ -21,6 +25,16 @@
 #include <algorithm>
 #include <array>
 #include <limits>
+#include <execution>
+#include <numeric>
+#include <new>
+#include <thread>
+#include <tuple>
+#if defined(__AVX__)
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#endif
 
 namespace gcode {
 
@@ -28,13 +42,22 @@ static unsigned int extract_role_from_flags(unsigned int flags) { return flags &
 static unsigned int extract_type_from_flags(unsigned int flags) { return (flags >> 8) & 0xFF; }
 
 GLuint gcodeVAO, vertexBuffer;
+// the segment drawn indexed: its 8 corners and vertex_data as the indices of its triangles
+GLuint gcodeIndexedVAO, cornersBuffer, cornerIndicesBuffer;
 GLuint visibilityFramebuffer, instanceIdsTexture, depthTexture;
 GLuint quadVAO;
+GLuint paletteTexture, paletteBuffer;
 
 GLuint pathSSBObindPoint = 5;
 
 GLint vid_loc = 0;
 
+// Segments drawn with one binding of the point textures. The shaders index them with ints and a binding is limited by
+// the texture buffer size, init() lowers it to the limits of the driver. Larger scenes are drawn in several chunks,
+// every chunk binds the textures at its first point.
+size_t draw_chunk_segments             = size_t(1) << 30;
+GLint  texture_buffer_offset_alignment = 1;
+
 //     /1-------6\    
 //    / |       | \  
 //   2  0-------5  7
@@ -52,6 +75,10 @@ int vertex_data[] = {
         5, 7, 6, // back spike
         };
 
+// The corners indexed by vertex_data, the vertex shader runs once per corner when the post-transform cache keeps them
+size_t corner_data_size = 8;
+int corner_data[] = { 0, 1, 2, 3, 4, 5, 6, 7 };
+
 glm::vec3 unit_box_vertices[] = {
     // Front face
     glm::ivec3(0, 0, 1), // Bottom-left
@@ -111,6 +138,346 @@ struct PathPoint
     bool is_extrude_move() const { return extract_type_from_flags(flags) == 10; }
 };
 
+// Attributes of PathPoint, in the order of its members
+enum class Column : unsigned int { Position, Flags, Height, Width, Speed, FanSpeed, Temperature, VolumetricRate, ExtruderId, ColorId, Count };
+
+static constexpr unsigned int column_bit(Column column) { return 1u << static_cast<unsigned int>(column); }
+static constexpr unsigned int All_Columns = (1u << static_cast<unsigned int>(Column::Count)) - 1;
+// Columns every visualization needs: the geometry and the feature type
+static constexpr unsigned int Core_Columns =
+    column_bit(Column::Position) | column_bit(Column::Flags) | column_bit(Column::Height) | column_bit(Column::Width);
+
+// Columns the given visualization type colors by, on top of the core ones
+static unsigned int visualization_columns(int visualization_type)
+{
+    switch (visualization_type) {
+    case 3: return column_bit(Column::Speed);
+    case 4: return column_bit(Column::FanSpeed);
+    case 5: return column_bit(Column::Temperature);
+    case 6: return column_bit(Column::VolumetricRate);
+    case 9: return column_bit(Column::ExtruderId);
+    case 10: return column_bit(Column::ColorId);
+    default: return 0;
+    }
+}
+
+// Column the given visualization type colors by, Count for the feature type and the types without colors
+static Column colored_column(int visualization_type)
+{
+    switch (visualization_type) {
+    case 1: return Column::Height;
+    case 2: return Column::Width;
+    case 3: return Column::Speed;
+    case 4: return Column::FanSpeed;
+    case 5: return Column::Temperature;
+    case 6: return Column::VolumetricRate;
+    case 9: return Column::ExtruderId;
+    case 10: return Column::ColorId;
+    default: return Column::Count;
+    }
+}
+
+// Columns of unsigned integers, the other attribute columns hold floats
+static bool is_id_column(Column column) { return column == Column::Flags || column == Column::ExtruderId || column == Column::ColorId; }
+
+// Element type of every column
+template<Column C> struct ColumnType { using type = float; };
+template<> struct ColumnType<Column::Position> { using type = glm::vec3; };
+template<> struct ColumnType<Column::Flags> { using type = unsigned int; };
+template<> struct ColumnType<Column::ExtruderId> { using type = unsigned int; };
+template<> struct ColumnType<Column::ColorId> { using type = unsigned int; };
+template<Column C> using column_type = typename ColumnType<C>::type;
+
+// Allocator of the columns, aligned on cache lines so that the scans over them start on a full vector register
+template<typename T> struct ColumnAllocator
+{
+    static constexpr size_t Alignment = 64;
+    using value_type                  = T;
+
+    ColumnAllocator() = default;
+    template<typename U> ColumnAllocator(const ColumnAllocator<U> &) {}
+
+    T   *allocate(size_t n) { return static_cast<T *>(::operator new(n * sizeof(T), std::align_val_t(Alignment))); }
+    void deallocate(T *p, size_t) { ::operator delete(p, std::align_val_t(Alignment)); }
+
+    template<typename U> bool operator==(const ColumnAllocator<U> &) const { return true; }
+    template<typename U> bool operator!=(const ColumnAllocator<U> &) const { return false; }
+};
+
+template<typename T> using ColumnVector = std::vector<T, ColumnAllocator<T>>;
+
+// Structure-of-arrays storage of the path: every attribute of PathPoint in its own contiguous array, so that a pass
+// reads only the bytes of the attributes it uses. Only the columns present in loaded_columns are filled.
+struct PathStore
+{
+    size_t                     count{0};
+    unsigned int               loaded_columns{0};
+    ColumnVector<glm::vec3>    position;
+    ColumnVector<unsigned int> flags;
+    ColumnVector<float>        height;
+    ColumnVector<float>        width;
+    ColumnVector<float>        speed;
+    ColumnVector<float>        fanspeed;
+    ColumnVector<float>        temperature;
+    ColumnVector<float>        volumetricrate;
+    ColumnVector<unsigned int> extruderid;
+    ColumnVector<unsigned int> colorid;
+
+    bool has(Column column) const { return (loaded_columns & column_bit(column)) != 0; }
+
+    // Raw storage of a column, resized to count elements
+    void *resize_column(Column column)
+    {
+        loaded_columns |= column_bit(column);
+        switch (column) {
+        case Column::Position: position.resize(count); return position.data();
+        case Column::Flags: flags.resize(count); return flags.data();
+        case Column::Height: height.resize(count); return height.data();
+        case Column::Width: width.resize(count); return width.data();
+        case Column::Speed: speed.resize(count); return speed.data();
+        case Column::FanSpeed: fanspeed.resize(count); return fanspeed.data();
+        case Column::Temperature: temperature.resize(count); return temperature.data();
+        case Column::VolumetricRate: volumetricrate.resize(count); return volumetricrate.data();
+        case Column::ExtruderId: extruderid.resize(count); return extruderid.data();
+        case Column::ColorId: colorid.resize(count); return colorid.data();
+        default: assert(false); return nullptr;
+        }
+    }
+
+    const void *column_data(Column column) const { return const_cast<PathStore *>(this)->column_data(column); }
+    void       *column_data(Column column)
+    {
+        switch (column) {
+        case Column::Position: return position.data();
+        case Column::Flags: return flags.data();
+        case Column::Height: return height.data();
+        case Column::Width: return width.data();
+        case Column::Speed: return speed.data();
+        case Column::FanSpeed: return fanspeed.data();
+        case Column::Temperature: return temperature.data();
+        case Column::VolumetricRate: return volumetricrate.data();
+        case Column::ExtruderId: return extruderid.data();
+        case Column::ColorId: return colorid.data();
+        default: assert(false); return nullptr;
+        }
+    }
+
+    static size_t element_size(Column column) { return column == Column::Position ? sizeof(glm::vec3) : sizeof(float); }
+
+    // Typed view of a column, empty when it is not loaded
+    template<Column C> Span<const column_type<C>> view() const
+    {
+        return {static_cast<const column_type<C> *>(column_data(C)), has(C) ? count : 0};
+    }
+
+    // Appends the attributes of the points to the loaded columns, the others stay empty
+    void append(Span<const PathPoint> points)
+    {
+        const size_t first = count;
+        count += points.size();
+        auto fill = [&](Column column, auto &values, auto member) {
+            if (!has(column))
+                return;
+            values.resize(count);
+            for (size_t i = 0; i < points.size(); ++i) values[first + i] = points[i].*member;
+        };
+        fill(Column::Position, position, &PathPoint::position);
+        fill(Column::Flags, flags, &PathPoint::flags);
+        fill(Column::Height, height, &PathPoint::height);
+        fill(Column::Width, width, &PathPoint::width);
+        fill(Column::Speed, speed, &PathPoint::speed);
+        fill(Column::FanSpeed, fanspeed, &PathPoint::fanspeed);
+        fill(Column::Temperature, temperature, &PathPoint::temperature);
+        fill(Column::VolumetricRate, volumetricrate, &PathPoint::volumetricrate);
+        fill(Column::ExtruderId, extruderid, &PathPoint::extruderid);
+        fill(Column::ColorId, colorid, &PathPoint::colorid);
+    }
+
+    // Appends the rows of other to the loaded columns, the ones other does not hold are zero
+    void append(const PathStore &other)
+    {
+        const size_t first = count;
+        count += other.count;
+        for (unsigned int c = 0; c < static_cast<unsigned int>(Column::Count); ++c) {
+            const Column column = static_cast<Column>(c);
+            if (!has(column))
+                continue;
+            resize_column(column);
+            if (other.has(column))
+                std::memcpy(static_cast<char *>(column_data(column)) + first * element_size(column), other.column_data(column),
+                            other.count * element_size(column));
+        }
+    }
+
+    // Copies the columns of other which are in the mask into the rows [first, first + other.count)
+    void copy_columns(const PathStore &other, unsigned int mask, size_t first)
+    {
+        assert(first + other.count <= count);
+        for (unsigned int c = 0; c < static_cast<unsigned int>(Column::Count); ++c) {
+            const Column column = static_cast<Column>(c);
+            if ((mask & column_bit(column)) == 0 || !other.has(column))
+                continue;
+            if (!has(column))
+                resize_column(column);
+            std::memcpy(static_cast<char *>(column_data(column)) + first * element_size(column), other.column_data(column),
+                        other.count * element_size(column));
+        }
+    }
+
+    // Takes over the loaded columns of other which are in the mask, other holds as many points
+    void take_columns(PathStore &&other, unsigned int mask)
+    {
+        assert(other.count == count);
+        auto take = [&](Column column, auto &values, auto &other_values) {
+            if ((mask & column_bit(column)) == 0 || !other.has(column))
+                return;
+            values = std::move(other_values);
+            loaded_columns |= column_bit(column);
+        };
+        take(Column::Position, position, other.position);
+        take(Column::Flags, flags, other.flags);
+        take(Column::Height, height, other.height);
+        take(Column::Width, width, other.width);
+        take(Column::Speed, speed, other.speed);
+        take(Column::FanSpeed, fanspeed, other.fanspeed);
+        take(Column::Temperature, temperature, other.temperature);
+        take(Column::VolumetricRate, volumetricrate, other.volumetricrate);
+        take(Column::ExtruderId, extruderid, other.extruderid);
+        take(Column::ColorId, colorid, other.colorid);
+    }
+};
+
+static PathStore to_columns(Span<const PathPoint> points, unsigned int mask = All_Columns)
+{
+    PathStore columns;
+    columns.loaded_columns = mask;
+    columns.append(points);
+    return columns;
+}
+
+// Columns which were not loaded are zero filled
+static std::vector<PathPoint> to_path_points(const PathStore &columns)
+{
+    std::vector<PathPoint> points(columns.count, PathPoint{});
+    for (size_t i = 0; i < columns.count; ++i) {
+        PathPoint &p = points[i];
+        if (columns.has(Column::Position)) p.position = columns.position[i];
+        if (columns.has(Column::Flags)) p.flags = columns.flags[i];
+        if (columns.has(Column::Height)) p.height = columns.height[i];
+        if (columns.has(Column::Width)) p.width = columns.width[i];
+        if (columns.has(Column::Speed)) p.speed = columns.speed[i];
+        if (columns.has(Column::FanSpeed)) p.fanspeed = columns.fanspeed[i];
+        if (columns.has(Column::Temperature)) p.temperature = columns.temperature[i];
+        if (columns.has(Column::VolumetricRate)) p.volumetricrate = columns.volumetricrate[i];
+        if (columns.has(Column::ExtruderId)) p.extruderid = columns.extruderid[i];
+        if (columns.has(Column::ColorId)) p.colorid = columns.colorid[i];
+    }
+    return points;
+}
+
+// Extends the bounding box by the positions. They are read as a flat array of floats in groups of 8 points, every
+// lane keeps the running minimum and maximum of one axis so that the loop maps to vector min/max instructions.
+static void update_bounds(glm::vec3 &min, glm::vec3 &max, Span<const glm::vec3> positions)
+{
+    constexpr size_t Lanes = 8 * 3;
+    float            lanes_min[Lanes], lanes_max[Lanes];
+    for (size_t l = 0; l < Lanes; ++l) {
+        lanes_min[l] = min[int(l % 3)];
+        lanes_max[l] = max[int(l % 3)];
+    }
+    static_assert(sizeof(glm::vec3) == 3 * sizeof(float), "positions are read as floats");
+    const float *values = reinterpret_cast<const float *>(positions.data());
+    const size_t size   = 3 * positions.size();
+    size_t       i      = 0;
+    for (; i + Lanes <= size; i += Lanes) {
+        for (size_t l = 0; l < Lanes; ++l) {
+            lanes_min[l] = values[i + l] < lanes_min[l] ? values[i + l] : lanes_min[l];
+            lanes_max[l] = values[i + l] > lanes_max[l] ? values[i + l] : lanes_max[l];
+        }
+    }
+    for (size_t l = 0; l < Lanes; ++l) {
+        min[int(l % 3)] = std::min(min[int(l % 3)], lanes_min[l]);
+        max[int(l % 3)] = std::max(max[int(l % 3)], lanes_max[l]);
+    }
+    for (; i < size; ++i) {
+        min[int(i % 3)] = std::min(min[int(i % 3)], values[i]);
+        max[int(i % 3)] = std::max(max[int(i % 3)], values[i]);
+    }
+}
+
+// Compact GPU encoding of the positions. Consecutive points lie close to each other along the path, they are grouped by
+// Position_Chunk_Points and every chunk has a float origin, its minimum corner, and a step. A point is stored as three
+// 16 bit multiples of the step from the origin: 6 bytes per point and 16 per chunk instead of 12 bytes per point. The
+// step is the chosen precision, or the smallest one covering the chunk when it spans more than 65535 steps (long travels).
+static constexpr size_t Position_Chunk_Points = 64;
+
+struct QuantizedPositions
+{
+    std::vector<uint16_t>  offsets; // 3 per point
+    std::vector<glm::vec4> chunks;  // origin and step
+    float                  max_error{0.0f};
+};
+
+// Encodes the positions from the first point of the given chunk on
+static QuantizedPositions quantize_positions(Span<const glm::vec3> positions, size_t first_chunk, float precision)
+{
+    const size_t       first = std::min(first_chunk * Position_Chunk_Points, positions.size());
+    QuantizedPositions result;
+    result.offsets.resize(3 * (positions.size() - first));
+    result.chunks.resize((positions.size() - first + Position_Chunk_Points - 1) / Position_Chunk_Points);
+    std::vector<float> errors(result.chunks.size());
+    std::vector<size_t> chunk_indices(result.chunks.size());
+    std::iota(chunk_indices.begin(), chunk_indices.end(), size_t(0));
+    std::for_each(std::execution::par, chunk_indices.begin(), chunk_indices.end(), [&](size_t c) {
+        const size_t begin = first + c * Position_Chunk_Points;
+        const size_t end   = std::min(begin + Position_Chunk_Points, positions.size());
+        glm::vec3    min(FLT_MAX), max(-FLT_MAX);
+        update_bounds(min, max, positions.subspan(begin, end - begin));
+        const glm::vec3 extent = max - min;
+        const float     step   = std::max(precision, std::max(extent.x, std::max(extent.y, extent.z)) / float(UINT16_MAX));
+        result.chunks[c]       = glm::vec4(min, step);
+        float error            = 0.0f;
+        for (size_t i = begin; i < end; ++i) {
+            const glm::vec3 q = glm::clamp(glm::round((positions[i] - min) / step), glm::vec3(0.0f), glm::vec3(float(UINT16_MAX)));
+            uint16_t       *o = &result.offsets[3 * (i - first)];
+            o[0]              = uint16_t(q.x);
+            o[1]              = uint16_t(q.y);
+            o[2]              = uint16_t(q.z);
+            // decoded the way the vertex shader does
+            const glm::vec3 d = glm::abs(min + step * q - positions[i]);
+            error             = std::max(error, std::max(d.x, std::max(d.y, d.z)));
+        }
+        errors[c] = error;
+    });
+    result.max_error = errors.empty() ? 0.0f : *std::max_element(errors.begin(), errors.end());
+    return result;
+}
+
+// Height, width and turn angle of a point packed in one 32 bit texel: 11 bit unorm height and width over
+// [0, Max_Packed_Extent] mm, steps of 2 um, and a 10 bit angle over [-pi, pi], steps of 6 mrad. Straight continuations,
+// angle 0, are exact. The vertex shader decodes them the same way as unpack_height_width_angle.
+static constexpr float    Max_Packed_Extent = 4.0f;
+static constexpr uint32_t Packed_Extent_Max = (1u << 11) - 1;
+static constexpr uint32_t Packed_Angle_Zero = (1u << 9) - 1;
+
+static uint32_t pack_height_width_angle(glm::vec3 height_width_angle)
+{
+    auto extent = [](float value) {
+        return uint32_t(std::clamp(std::round(value * (float(Packed_Extent_Max) / Max_Packed_Extent)), 0.0f, float(Packed_Extent_Max)));
+    };
+    const float    pi    = glm::pi<float>();
+    const uint32_t angle = uint32_t(std::clamp(std::round(height_width_angle.z * (float(Packed_Angle_Zero) / pi)), -float(Packed_Angle_Zero),
+                                               float(Packed_Angle_Zero)) + float(Packed_Angle_Zero));
+    return extent(height_width_angle.x) | extent(height_width_angle.y) << 11 | angle << 22;
+}
+
+static glm::vec3 unpack_height_width_angle(uint32_t bits)
+{
+    const float step = Max_Packed_Extent / float(Packed_Extent_Max);
+    return {float(bits & Packed_Extent_Max) * step, float((bits >> 11) & Packed_Extent_Max) * step,
+            (float(bits >> 22) - float(Packed_Angle_Zero)) * (glm::pi<float>() / float(Packed_Angle_Zero))};
+}
+
 const std::vector<std::array<float, 3>> Extrusion_Role_Colors{ {
     { 0.90f, 0.70f, 0.70f },   // None
     { 1.00f, 0.90f, 0.30f },   // Perimeter
@@ -157,19 +524,64 @@ const std::vector<std::array<float, 3>> Tools_Colors{ {
     { 0.984f, 0.922f, 0.490f }
 } };
 
+// Palette of the color buffer, every point stores the index of its color: the extrusion roles, the travels, the tools
+// and the error color first, then levels of the range colors evenly spaced from the minimum to the maximum of a range
+constexpr size_t  Palette_Size         = 256;
+constexpr uint8_t Palette_Travel_First = 16;
+constexpr uint8_t Palette_Tool_First   = 20;
+constexpr uint8_t Palette_Error        = 31;
+constexpr uint8_t Palette_Range_First  = 32;
+constexpr size_t  Palette_Range_Levels = Palette_Size - Palette_Range_First;
+
 class Range
 {
     float m_min{ FLT_MAX };
     float m_max{ -FLT_MAX };
 
+    // Integer with the order of the float, the magnitude bits of negative values are flipped
+    static int32_t order_key(float value) {
+        int32_t bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+        return bits ^ ((bits >> 31) & INT32_MAX);
+    }
+    static float from_order_key(int32_t key) {
+        const int32_t bits = key ^ ((key >> 31) & INT32_MAX);
+        float         value;
+        std::memcpy(&value, &bits, sizeof(value));
+        return value;
+    }
+
 public:
     void reset() { m_min = FLT_MAX; m_max = -FLT_MAX; }
 
+    float min() const { return m_min; }
+    float max() const { return m_max; }
+
+    bool operator==(const Range &other) const { return m_min == other.m_min && m_max == other.m_max; }
+
     void update(float value) {
         m_min = std::min(m_min, value);
         m_max = std::max(m_max, value);
     }
 
+    // Extends the range by the values[i], i >= first, for which included(i) holds, NaN values are skipped like above.
+    // The floats are compared through integer keys in the same order: the compiler vectorizes an integer min/max
+    // reduction, a float one only with -ffinite-math-only.
+    template<typename Included> void update(Span<const float> values, size_t first, Included &&included) {
+        int32_t low = INT32_MAX, high = INT32_MIN;
+        for (size_t i = first; i < values.size(); ++i) {
+            const float   value = values[i];
+            const int32_t mask  = -int32_t(bool(included(i)) & (value == value));
+            const int32_t key   = order_key(value);
+            low                 = std::min(low, (key & mask) | (INT32_MAX & ~mask));
+            high                = std::max(high, (key & mask) | (INT32_MIN & ~mask));
+        }
+        if (low <= high) {
+            update(from_order_key(low));
+            update(from_order_key(high));
+        }
+    }
+
     float step_size(bool logarithmic = false) const {
       if (m_max < m_min)
           return 0.0f;
@@ -179,18 +591,8 @@ public:
           return (m_max - m_min) / ((float)Range_Colors.size() - 1.0f);
     }
 
-    std::array<float, 3> get_color_at(float value, bool logarithmic = false) const {
-        // std::lerp is available with c++20
-        auto lerp = [](const std::array<float, 3>& a, const std::array<float, 3>& b, float t) {
-            t = std::clamp(t, 0.0f, 1.0f);
-            std::array<float, 3> ret;
-            for (int i = 0; i < 3; ++i) {
-                ret[i] = (1.0f - t) * a[i] + t * b[i];
-            }
-            return ret;
-        };
-
-        // Input value scaled to the colors range
+    // Input value scaled to the colors range, from 0 to Range_Colors.size() - 1
+    float scaled(float value, bool logarithmic = false) const {
         float global_t = 0.0f;
         const float step = step_size(logarithmic);
         value = std::clamp(value, m_min, m_max);
@@ -200,6 +602,20 @@ public:
             else
                 global_t = (value - m_min) / step;
         }
+        return global_t;
+    }
+
+    // Color at a scaled value
+    static std::array<float, 3> color_at_scaled(float global_t) {
+        // std::lerp is available with c++20
+        auto lerp = [](const std::array<float, 3>& a, const std::array<float, 3>& b, float t) {
+            t = std::clamp(t, 0.0f, 1.0f);
+            std::array<float, 3> ret;
+            for (int i = 0; i < 3; ++i) {
+                ret[i] = (1.0f - t) * a[i] + t * b[i];
+            }
+            return ret;
+        };
 
         const size_t color_max_idx = Range_Colors.size() - 1;
 
@@ -210,6 +626,16 @@ public:
         // Interpolate between the low and high colors to find exactly which color the input value should get
         return lerp(Range_Colors[color_low_idx], Range_Colors[color_high_idx], global_t - static_cast<float>(color_low_idx));
     }
+
+    std::array<float, 3> get_color_at(float value, bool logarithmic = false) const {
+        return color_at_scaled(scaled(value, logarithmic));
+    }
+
+    // Palette index of the color at the value, the nearest of the range levels of the palette
+    uint8_t get_palette_index_at(float value, bool logarithmic = false) const {
+        const float level = scaled(value, logarithmic) * float(Palette_Range_Levels - 1) / float(Range_Colors.size() - 1);
+        return uint8_t(Palette_Range_First + std::lround(level));
+    }
 };
 
 Range width_range;
@@ -219,7 +645,29 @@ Range fanspeed_range;
 Range temperature_range;
 Range volumetricrate_range;
 
-void set_ranges(const std::vector<PathPoint>& path_points)
+// Extends the ranges of the loaded columns by the points starting at first, returns true if any of them changed
+bool update_ranges(const PathStore &columns, size_t first = 0)
+{
+    const std::array<Range, 6> old_ranges = {width_range, height_range, speed_range, fanspeed_range, temperature_range, volumetricrate_range};
+
+    // one pass per column, each reading only that column and the flags
+    const Span<const unsigned int> flags   = columns.view<Column::Flags>();
+    auto                           extrude = [flags](size_t i) { return extract_type_from_flags(flags[i]) == 10; };
+    width_range.update(columns.view<Column::Width>(), first, extrude);
+    height_range.update(columns.view<Column::Height>(), first, extrude);
+    fanspeed_range.update(columns.view<Column::FanSpeed>(), first, extrude);
+    temperature_range.update(columns.view<Column::Temperature>(), first, extrude);
+    volumetricrate_range.update(columns.view<Column::VolumetricRate>(), first, extrude);
+    if (config::use_travel_moves_data)
+        speed_range.update(columns.view<Column::Speed>(), first, [](size_t) { return true; });
+    else
+        speed_range.update(columns.view<Column::Speed>(), first, extrude);
+
+    const std::array<Range, 6> new_ranges = {width_range, height_range, speed_range, fanspeed_range, temperature_range, volumetricrate_range};
+    return old_ranges != new_ranges;
+}
+
+void set_ranges(const PathStore &columns)
 {
     width_range.reset();
     height_range.reset();
@@ -228,160 +676,654 @@ void set_ranges(const std::vector<PathPoint>& path_points)
     temperature_range.reset();
     volumetricrate_range.reset();
 
-    for (size_t i = 0; i < path_points.size(); i++) {
-        const PathPoint& p = path_points[i];
-        if (p.is_extrude_move()) {
-            width_range.update(p.width);
-            height_range.update(p.height);
-            fanspeed_range.update(p.fanspeed);
-            temperature_range.update(p.temperature);
-            volumetricrate_range.update(p.volumetricrate);
-        }
-        if (config::use_travel_moves_data || p.is_extrude_move())
-            speed_range.update(p.speed);
+    update_ranges(columns);
+}
+
+// Visualization types colored by one of the ranges above
+static bool uses_ranges(int visualization_type) { return visualization_type >= 1 && visualization_type <= 6; }
+
+// Range the given visualization type colors by, nullptr for the types without one
+static const Range *visualization_range(int visualization_type)
+{
+    switch (visualization_type) {
+    case 1: return &height_range;
+    case 2: return &width_range;
+    case 3: return &speed_range;
+    case 4: return &fanspeed_range;
+    case 5: return &temperature_range;
+    case 6: return &volumetricrate_range;
+    default: return nullptr;
     }
 }
 
+// Hash of voxel coordinates mixing the bits of every axis into the whole hash. The hash of glm puts the neighbouring
+// voxels of a print in the same buckets.
+struct VoxelHash
+{
+    size_t operator()(const glm::ivec3 &voxel) const
+    {
+        const uint64_t hash = uint64_t(uint32_t(voxel.x)) * 0x9e3779b97f4a7c15ull ^ uint64_t(uint32_t(voxel.y)) * 0xc2b2ae3d27d4eb4full ^
+                              uint64_t(uint32_t(voxel.z)) * 0x165667b19e3779f9ull;
+        return size_t(hash ^ hash >> 32);
+    }
+};
+
+// Segments crossing every visibility box, as compressed sparse rows of runs. A level indexes the consecutive segments
+// [first_segment, end_segment): row r lists the segments of one box in increasing order, as the runs
+// row_starts[r] to row_starts[r + 1] - 1. A run is up to Max_Run consecutive segments, from the 32-bit offset
+// runs[n] from first_segment on, run_lengths[n] + 1 of them: the consecutive segments of a line mostly cross the same
+// boxes. The boxes of the rows are increasing, a dense level has a row for every box from first_box on, some of them
+// empty, and keeps no box ids.
+//
+// Segments are indexed in levels of Level_Segments. A level indexing fewer segments, as the small appends of a
+// streamed scene give, is merged with the next one while that one holds at least half as many memberships, so there
+// are a logarithmic number of them besides the full levels.
+struct BoxSegmentIndex
+{
+    static constexpr size_t   Level_Segments = size_t(1) << 22;
+    static constexpr uint32_t Segment_Entry  = uint32_t(1) << 31;
+    static constexpr size_t   Max_Run        = 256;
+
+    struct Level
+    {
+        size_t                first_segment{0}, end_segment{0};
+        uint32_t              first_box{0};
+        std::vector<uint32_t> boxes; // the box of every row, empty for a dense level
+        std::vector<size_t>   row_starts{0};
+        std::vector<uint32_t> runs;
+        std::vector<uint8_t>  run_lengths;
+        size_t                memberships{0};
+
+        size_t   rows() const { return row_starts.size() - 1; }
+        uint32_t box(size_t row) const { return boxes.empty() ? first_box + uint32_t(row) : boxes[row]; }
+
+        // Row of the box, rows() when the level has none
+        size_t find(uint32_t box) const
+        {
+            if (boxes.empty())
+                return box >= first_box && box - first_box < rows() ? box - first_box : rows();
+            const auto it = std::lower_bound(boxes.begin(), boxes.end(), box);
+            return it != boxes.end() && *it == box ? size_t(it - boxes.begin()) : rows();
+        }
+
+        // Appends the run of the segments [offset, offset + count) to the last row, joined with the last run when it
+        // continues it
+        void push_run(uint32_t offset, size_t count, size_t row_start)
+        {
+            memberships += count;
+            if (runs.size() > row_start && runs.back() + run_lengths.back() + 1 == offset) {
+                const size_t joined = std::min(count, Max_Run - 1 - run_lengths.back());
+                run_lengths.back() += uint8_t(joined);
+                offset += uint32_t(joined);
+                count -= joined;
+            }
+            for (; count > 0; offset += uint32_t(std::min(count, Max_Run)), count -= std::min(count, Max_Run)) {
+                runs.push_back(offset);
+                run_lengths.push_back(uint8_t(std::min(count, Max_Run) - 1));
+            }
+        }
+    };
+
+    std::vector<Level> levels;
+
+    size_t size() const
+    {
+        size_t memberships = 0;
+        for (const Level &level : levels) memberships += level.memberships;
+        return memberships;
+    }
+
+    size_t runs() const
+    {
+        size_t runs = 0;
+        for (const Level &level : levels) runs += level.runs.size();
+        return runs;
+    }
+
+    size_t memory_bytes() const
+    {
+        size_t bytes = levels.capacity() * sizeof(Level);
+        for (const Level &level : levels)
+            bytes += level.boxes.capacity() * sizeof(uint32_t) + level.row_starts.capacity() * sizeof(size_t) +
+                     level.runs.capacity() * sizeof(uint32_t) + level.run_lengths.capacity() * sizeof(uint8_t);
+        return bytes;
+    }
+
+    // Calls the function with the first segment and the count of every run of the box, in increasing order
+    template<typename Function> void for_each_run(uint32_t box, Function &&function) const
+    {
+        for (const Level &level : levels) {
+            const size_t row = level.find(box);
+            if (row == level.rows())
+                continue;
+            for (size_t n = level.row_starts[row]; n < level.row_starts[row + 1]; ++n)
+                function(level.first_segment + level.runs[n], size_t(level.run_lengths[n]) + 1);
+        }
+    }
+
+    // Calls the function with every segment of the box, in increasing order
+    template<typename Function> void for_each(uint32_t box, Function &&function) const
+    {
+        for_each_run(box, [&function](size_t first, size_t count) {
+            for (size_t segment = first; segment < first + count; ++segment) function(segment);
+        });
+    }
+
+    // Adds the level of at most Level_Segments segments [first_segment, end_segment). Every entry is either the offset
+    // of a segment from first_segment marked with Segment_Entry, or a box crossed by the last marked segment.
+    void append(const std::vector<uint32_t> &entries, size_t first_segment, size_t end_segment)
+    {
+        uint32_t min_box = UINT32_MAX, max_box = 0;
+        size_t   memberships = 0;
+        for (uint32_t entry : entries) {
+            if (entry & Segment_Entry)
+                continue;
+            min_box = std::min(min_box, entry);
+            max_box = std::max(max_box, entry);
+            ++memberships;
+        }
+        if (memberships == 0)
+            return;
+
+        // the rows are counted, then the segments are placed in them and encoded as runs
+        Level level;
+        level.first_segment = first_segment;
+        level.end_segment   = end_segment;
+        level.first_box     = min_box;
+        if (size_t(max_box - min_box) >= memberships) {
+            for (uint32_t entry : entries)
+                if (!(entry & Segment_Entry))
+                    level.boxes.push_back(entry);
+            std::sort(level.boxes.begin(), level.boxes.end());
+            level.boxes.erase(std::unique(level.boxes.begin(), level.boxes.end()), level.boxes.end());
+        }
+        level.row_starts.assign((level.boxes.empty() ? size_t(max_box - min_box) + 1 : level.boxes.size()) + 1, 0);
+        for (uint32_t entry : entries)
+            if (!(entry & Segment_Entry))
+                ++level.row_starts[level.find(entry) + 1];
+        std::partial_sum(level.row_starts.begin(), level.row_starts.end(), level.row_starts.begin());
+        std::vector<size_t>   next(level.row_starts.begin(), level.row_starts.end() - 1);
+        std::vector<uint32_t> segments(memberships);
+        uint32_t              segment = 0;
+        for (uint32_t entry : entries) {
+            if (entry & Segment_Entry)
+                segment = entry & ~Segment_Entry;
+            else
+                segments[next[level.find(entry)]++] = segment;
+        }
+        set_runs(level, segments);
+        append(std::move(level));
+    }
+
+    // Adds a level following the previous ones
+    void append(Level &&level)
+    {
+        assert(level.end_segment - level.first_segment <= Level_Segments && (levels.empty() || levels.back().end_segment <= level.first_segment));
+        if (level.runs.empty())
+            return;
+        levels.push_back(std::move(level));
+
+        while (levels.size() > 1) {
+            const Level &older = levels[levels.size() - 2], &newer = levels.back();
+            if (older.end_segment - older.first_segment >= Level_Segments || 2 * newer.memberships < older.memberships)
+                break;
+            Level merged = merge(older, newer);
+            levels.pop_back();
+            levels.back() = std::move(merged);
+        }
+    }
+
+    // Encodes the segments of the rows as runs, the row_starts of the level index the segments before and the runs
+    // after. The rows are encoded in parallel.
+    static void set_runs(Level &level, const std::vector<uint32_t> &segments)
+    {
+        const size_t        rows  = level.rows();
+        const size_t        parts = std::clamp<size_t>(rows / 4096, 1, std::max(1u, std::thread::hardware_concurrency()));
+        std::vector<size_t> indices(parts);
+        std::iota(indices.begin(), indices.end(), 0);
+        auto starts_run = [&segments](size_t m, size_t row_start, size_t run_start) {
+            return m == row_start || segments[m] != segments[m - 1] + 1 || m - run_start == Max_Run;
+        };
+
+        // the runs of every row are counted, then written
+        std::vector<size_t> run_starts(rows + 1, 0);
+        std::for_each(std::execution::par, indices.begin(), indices.end(), [&](size_t p) {
+            for (size_t r = rows * p / parts; r < rows * (p + 1) / parts; ++r)
+                for (size_t m = level.row_starts[r], run_start = m; m < level.row_starts[r + 1]; ++m)
+                    if (starts_run(m, level.row_starts[r], run_start)) {
+                        run_start = m;
+                        ++run_starts[r + 1];
+                    }
+        });
+        std::partial_sum(run_starts.begin(), run_starts.end(), run_starts.begin());
+        level.runs.resize(run_starts.back());
+        level.run_lengths.resize(run_starts.back());
+        std::for_each(std::execution::par, indices.begin(), indices.end(), [&](size_t p) {
+            for (size_t r = rows * p / parts; r < rows * (p + 1) / parts; ++r) {
+                size_t n = run_starts[r];
+                for (size_t m = level.row_starts[r], run_start = m; m < level.row_starts[r + 1]; ++m) {
+                    if (starts_run(m, level.row_starts[r], run_start)) {
+                        run_start        = m;
+                        level.runs[n]    = segments[m];
+                        level.run_lengths[n++] = 0;
+                    } else {
+                        ++level.run_lengths[n - 1];
+                    }
+                }
+            }
+        });
+        level.row_starts  = std::move(run_starts);
+        level.memberships = segments.size();
+    }
+
+    // Makes the level dense when that takes fewer rows than runs, its rows are the ones of its boxes
+    static void choose_rows(Level &level)
+    {
+        if (level.boxes.empty())
+            return;
+        level.first_box   = level.boxes.front();
+        const size_t span = size_t(level.boxes.back() - level.first_box) + 1;
+        if (span > level.runs.size())
+            return;
+        std::vector<size_t> row_starts(span + 1, 0);
+        for (size_t r = 0; r < level.boxes.size(); ++r) row_starts[level.boxes[r] - level.first_box + 1] = level.row_starts[r + 1] - level.row_starts[r];
+        std::partial_sum(row_starts.begin(), row_starts.end(), row_starts.begin());
+        level.row_starts = std::move(row_starts);
+        level.boxes      = {};
+    }
+
+private:
+    // Level of the segments of both, the newer one starting where the older one ends
+    static Level merge(const Level &older, const Level &newer)
+    {
+        Level merged;
+        merged.first_segment = older.first_segment;
+        merged.end_segment   = newer.end_segment;
+        merged.runs.reserve(older.runs.size() + newer.runs.size());
+        merged.run_lengths.reserve(older.runs.size() + newer.runs.size());
+        const uint32_t shift = uint32_t(newer.first_segment - older.first_segment);
+        size_t         a = 0, b = 0;
+        while (a < older.rows() || b < newer.rows()) {
+            const uint32_t box       = b == newer.rows() || (a < older.rows() && older.box(a) < newer.box(b)) ? older.box(a) : newer.box(b);
+            const size_t   row_start = merged.runs.size();
+            if (a < older.rows() && older.box(a) == box) {
+                for (size_t n = older.row_starts[a]; n < older.row_starts[a + 1]; ++n)
+                    merged.push_run(older.runs[n], size_t(older.run_lengths[n]) + 1, row_start);
+                ++a;
+            }
+            if (b < newer.rows() && newer.box(b) == box) {
+                for (size_t n = newer.row_starts[b]; n < newer.row_starts[b + 1]; ++n)
+                    merged.push_run(shift + newer.runs[n], size_t(newer.run_lengths[n]) + 1, row_start);
+                ++b;
+            }
+            // the empty rows of dense levels are dropped
+            if (merged.runs.size() > row_start) {
+                merged.boxes.push_back(box);
+                merged.row_starts.push_back(merged.runs.size());
+            }
+        }
+        choose_rows(merged);
+        return merged;
+    }
+};
+
+// Column on the GPU: a texture buffer holding its first count elements
+struct ColumnBuffer
+{
+    GLuint texture{0}, buffer{0};
+    size_t capacity{0}, count{0};
+};
+using ColumnBuffers = std::array<ColumnBuffer, size_t(Column::Count)>;
+
+// Segment i of the shader storage buffer at pathSSBObindPoint, in the std430 layout of v_shader.glsl: the positions and
+// packed heights, widths and angles of points i and i + 1, read by a vertex in a single fetch
+struct SegmentRecord
+{
+    glm::vec3 position_a;
+    uint32_t  height_width_angle_a;
+    glm::vec3 position_b;
+    uint32_t  height_width_angle_b;
+};
+static_assert(sizeof(SegmentRecord) == 32, "SegmentRecord follows the std430 layout of the shader");
+
 struct BufferedPath
 {
     GLuint                             positions_texture, positions_buffer;
     GLuint                             height_width_angle_texture, height_width_angle_buffer;
     GLuint                             color_texture, color_buffer;
     GLuint                             visible_segments_texture, visible_segments_buffer;
-    size_t                             visible_segments_count;
-    size_t                             total_points_count;
+    size_t                             visible_segments_count{0};
+    size_t                             total_points_count{0};
+    // the buffers grow geometrically, their capacities are counted in elements
+    size_t                             positions_capacity{0}, height_width_angle_capacity{0}, color_capacity{0};
+    // with quantized positions the positions buffer holds the offsets of quantize_positions, the chunks buffer their
+    // origins and steps
+    bool                               quantized_positions{false};
+    GLuint                             position_chunks_texture, position_chunks_buffer;
+    size_t                             position_chunks_capacity{0};
+    float                              position_max_error{0.0f};
+    // the height, width and angle buffer then holds one pack_height_width_angle texel per point
+    bool                               packed_height_width_angle{false};
+    // with shader colors the vertex shader colors the points from the flags and the raw column of the visualization
+    // type instead of the color buffer. A column is uploaded the first time a visualization type needs it and stays
+    // on the GPU, the element count of every uploaded column is kept with it.
+    bool                               shader_colors{false};
+    ColumnBuffers                      column_buffers;
+    // the segments as SegmentRecord, built the first time they are drawn from the records and then kept up to date
+    GLuint                             segment_records_buffer{0};
+    size_t                             segment_records_capacity{0}, segment_records_count{0};
     bitset::BitSet<>                   valid_lines_bitset;
     bitset::BitSet<>                   enabled_lines_bitset;
     bitset::BitSet<std::atomic_size_t> visible_lines_bitset;
+    // visible segments as offsets in their draw chunk, the chunk_ends give where every chunk ends in them
     std::vector<uint32_t>              visible_lines;
+    std::vector<size_t>                visible_lines_chunk_ends;
+    std::vector<size_t>                visible_segments_chunk_ends; // of the uploaded visible segments
 
     std::future<void> filtering_work{};
     GLuint            visibility_VAO;
     GLuint            visibility_boxes_vertex_buffer, visibility_boxes_index_buffer, visible_boxes_texture, visible_boxes_buffer;
-    size_t            index_buffer_size;
-    std::vector<std::pair<glm::ivec3, std::vector<uint32_t>>> visibility_boxes_with_segments;
+    size_t            index_buffer_size{0};
+    // the coordinates of every box by id, their ids and the segments crossing them
+    std::vector<glm::ivec3>                                   visibility_box_coords;
+    std::unordered_map<glm::ivec3, uint32_t, VoxelHash>       visibility_box_ids;
+    BoxSegmentIndex                                           visibility_box_segments;
+    size_t                                                    uploaded_boxes_count{0};
+    size_t                                                    boxes_capacity{0};
     std::vector<GLint>                                        visible_boxes_heat;
     std::uniform_int_distribution<size_t>                     visible_boxes_indices_distr;
 };
 
-void updateEnabledLines(BufferedPath &path, const std::vector<PathPoint> &path_points) {
-    path.enabled_lines_bitset = path.valid_lines_bitset;
-    for (size_t i = 0; i < path_points.size(); i++) {
-//   { 0.90f, 0.70f, 0.70f },   // None
-//     { 1.00f, 0.90f, 0.30f },   // Perimeter
-//     { 1.00f, 0.49f, 0.22f },   // ExternalPerimeter
-//     { 0.12f, 0.12f, 1.00f },   // OverhangPerimeter
-//     { 0.69f, 0.19f, 0.16f },   // InternalInfill
-//     { 0.59f, 0.33f, 0.80f },   // SolidInfill
-//     { 0.94f, 0.25f, 0.25f },   // TopSolidInfill
-//     { 1.00f, 0.55f, 0.41f },   // Ironing
-//     { 0.30f, 0.50f, 0.73f },   // BridgeInfill
-//     { 1.00f, 1.00f, 1.00f },   // GapFill
-//     { 0.00f, 0.53f, 0.43f },   // Skirt
-//     { 0.00f, 1.00f, 0.00f },   // SupportMaterial
-//     { 0.00f, 0.50f, 0.00f },   // SupportMaterialInterface
-//     { 0.70f, 0.89f, 0.67f },   // WipeTower
-//     { 0.37f, 0.82f, 0.58f },   // Custom
-
-
-        bool is_travel = path_points[i].is_travel_move();
-        const unsigned int role = path_points[i].role_from_flags();
-
-        if (!config::view_travel_paths && is_travel) path.enabled_lines_bitset.reset(i);
-        if (!config::view_perimeters && (role == 2)) path.enabled_lines_bitset.reset(i);
-        if (!config::view_inner_perimeters && (role == 1 || role == 3)) path.enabled_lines_bitset.reset(i);
-        if (!config::view_internal_infill && (role == 4)) path.enabled_lines_bitset.reset(i);
-        if (!config::view_solid_infills && (role == 5 || role == 6 || role == 8)) path.enabled_lines_bitset.reset(i);
-        if (!config::view_supports && (role == 11 || role == 12)) path.enabled_lines_bitset.reset(i);
-    }
-}
-
-void updatePathColors(const BufferedPath &path, const std::vector<PathPoint> &path_points)
-{
-    auto select_color = [](const PathPoint& p) {
-        static const std::array<float, 3> error_color = { 0.5f, 0.5f, 0.5f };
-        const unsigned int role = extract_role_from_flags(p.flags);
-        const unsigned int type = extract_type_from_flags(p.flags);
-        switch (config::visualization_type)
-        {
-        // feature type
-        case 0:
-        {
-            assert((p.is_travel_move() && role < Travel_Colors.size()) || (p.is_extrude_move() && role < Extrusion_Role_Colors.size()));
-            return p.is_travel_move() ? Travel_Colors[role] : Extrusion_Role_Colors[role];
-        }
-        // height
-        case 1:
-        {
-            assert(!p.is_travel_move() || role < Travel_Colors.size());
-            return p.is_travel_move() ? Travel_Colors[role] : height_range.get_color_at(p.height);
-        }
-        // width
-        case 2: 
-        {
-            assert(!p.is_travel_move() || role < Travel_Colors.size());
-            return p.is_travel_move() ? Travel_Colors[role] : width_range.get_color_at(p.width);
-        }
-        // speed
-        case 3: { return speed_range.get_color_at(p.speed); }
-        // fanspeed
-        case 4: {
-            assert(!p.is_travel_move() || role < Travel_Colors.size());
-            return p.is_travel_move() ? Travel_Colors[role] : fanspeed_range.get_color_at(p.fanspeed);
-        }
-        // temperature
-        case 5: {
-            assert(!p.is_travel_move() || role < Travel_Colors.size());
-            return p.is_travel_move() ? Travel_Colors[role] : temperature_range.get_color_at(p.temperature);
-        }
-        // volumetric rate
-        case 6: {
-            assert(!p.is_travel_move() || role < Travel_Colors.size());
-            return p.is_travel_move() ? Travel_Colors[role] : volumetricrate_range.get_color_at(p.volumetricrate);
-        }
-        // tool
-        case 9: {
-            assert(p.extruderid < Tools_Colors.size());
-            return Tools_Colors[p.extruderid];
-        }
-        // color print
-        case 10: {
-            return Tools_Colors[p.colorid % Tools_Colors.size()];
-        }
+// Updates the enabled lines starting at the given point, the ones before it are kept. The enabled bits are built a
+// block at a time from the flags column and a table of the visible roles, then masked by the valid ones.
+void updateEnabledLines(BufferedPath &path, const PathStore &columns, size_t first = 0) {
+    std::array<bool, 256> role_enabled;
+    role_enabled.fill(true);
+    auto hide = [&](bool visible, std::initializer_list<unsigned int> roles) {
+        if (!visible)
+            for (unsigned int role : roles) role_enabled[role] = false;
+    };
+    hide(config::view_perimeters, {2});
+    hide(config::view_inner_perimeters, {1, 3});
+    hide(config::view_internal_infill, {4});
+    hide(config::view_solid_infills, {5, 6, 8});
+    hide(config::view_supports, {11, 12});
+    const bool travel_enabled = config::view_travel_paths;
+
+    if (first == 0)
+        path.enabled_lines_bitset = path.valid_lines_bitset;
+    else
+        path.enabled_lines_bitset.grow(path.valid_lines_bitset.size);
+
+    using Block                            = unsigned long long;
+    constexpr size_t               Bits    = sizeof(Block) * 8;
+    const Span<const unsigned int> flags   = columns.view<Column::Flags>();
+    std::vector<Block>            &enabled = path.enabled_lines_bitset.blocks;
+    const std::vector<Block>      &valid   = path.valid_lines_bitset.blocks;
+    for (size_t block = first / Bits; block * Bits < flags.size() && block < valid.size(); ++block) {
+        const size_t begin = std::max(first, block * Bits);
+        const size_t end   = std::min(flags.size(), (block + 1) * Bits);
+        const Block  kept  = (Block(1) << (begin - block * Bits)) - 1; // the bits before first
+        Block        bits  = 0;
+        for (size_t i = begin; i < end; ++i) {
+            const unsigned int f = flags[i];
+            bits |= Block(role_enabled[extract_role_from_flags(f)] & (travel_enabled | (extract_type_from_flags(f) != 8))) << (i - block * Bits);
         }
+        enabled[block] = (enabled[block] & kept) | (valid[block] & bits);
+    }
+}
+
+// Replaces the buffer by a larger one keeping the first kept_bytes of its content, the copy stays on the GPU
+static void grow_buffer(GLuint &buffer, size_t kept_bytes, size_t new_bytes, GLenum usage)
+{
+    GLuint grown;
+    glGenBuffers(1, &grown);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, grown);
+    glBufferData(GL_COPY_WRITE_BUFFER, new_bytes, nullptr, usage);
+    if (kept_bytes > 0) {
+        glBindBuffer(GL_COPY_READ_BUFFER, buffer);
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, kept_bytes);
+        glBindBuffer(GL_COPY_READ_BUFFER, 0);
+    }
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    glDeleteBuffers(1, &buffer);
+    buffer = grown;
+}
 
-        return error_color;
+// Capacity for at least the needed elements, doubling the current one so that appending stays proportional to the appended data
+static size_t grown_capacity(size_t capacity, size_t needed) { return needed > capacity ? std::max(needed, 2 * capacity) : capacity; }
+
+// Uploads elements [first, first + count) of a texture buffer, the elements before first are kept.
+// The buffer is replaced by a larger one when its capacity is exceeded.
+static void upload_texture_buffer(GLuint &buffer, GLuint texture, GLenum format, size_t &capacity, size_t first, const void *data, size_t count,
+                                  size_t element_size, GLenum usage)
+{
+    if (first + count > capacity) {
+        const size_t kept = std::min(capacity, first);
+        capacity          = grown_capacity(capacity, first + count);
+        grow_buffer(buffer, kept * element_size, capacity * element_size, usage);
+        glBindTexture(GL_TEXTURE_BUFFER, texture);
+        glTexBuffer(GL_TEXTURE_BUFFER, format, buffer);
+        glBindTexture(GL_TEXTURE_BUFFER, 0);
+    }
+    glBindBuffer(GL_TEXTURE_BUFFER, buffer);
+    glBufferSubData(GL_TEXTURE_BUFFER, first * element_size, count * element_size, data);
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+}
+
+// Uploads the positions of the points from first on, as floats or quantized. A partial last chunk of quantized
+// positions is encoded again together with the points appended to it.
+static void upload_positions(BufferedPath &path, Span<const glm::vec3> positions, size_t first)
+{
+    if (!path.quantized_positions) {
+        upload_texture_buffer(path.positions_buffer, path.positions_texture, GL_RGB32F, path.positions_capacity, first, positions.data() + first,
+                              positions.size() - first, sizeof(glm::vec3), GL_STATIC_DRAW);
+        return;
+    }
+    const size_t             first_chunk = first / Position_Chunk_Points;
+    const size_t             first_point = first_chunk * Position_Chunk_Points;
+    const QuantizedPositions quantized   = quantize_positions(positions, first_chunk, config::position_precision);
+    upload_texture_buffer(path.positions_buffer, path.positions_texture, GL_R16UI, path.positions_capacity, first_point, quantized.offsets.data(),
+                          positions.size() - first_point, 3 * sizeof(uint16_t), GL_STATIC_DRAW);
+    upload_texture_buffer(path.position_chunks_buffer, path.position_chunks_texture, GL_RGBA32F, path.position_chunks_capacity, first_chunk,
+                          quantized.chunks.data(), quantized.chunks.size(), sizeof(glm::vec4), GL_STATIC_DRAW);
+    path.position_max_error = std::max(path.position_max_error, quantized.max_error);
+}
+
+// Uploads the height, width and angle of the points from first on, as floats or packed
+static void upload_height_width_angle(BufferedPath &path, Span<const glm::vec3> height_width_angle, size_t first)
+{
+    if (!path.packed_height_width_angle) {
+        upload_texture_buffer(path.height_width_angle_buffer, path.height_width_angle_texture, GL_RGB32F, path.height_width_angle_capacity, first,
+                              height_width_angle.data(), height_width_angle.size(), sizeof(glm::vec3), GL_DYNAMIC_DRAW);
+        return;
+    }
+    std::vector<uint32_t> packed(height_width_angle.size());
+    std::transform(height_width_angle.begin(), height_width_angle.end(), packed.begin(), pack_height_width_angle);
+    upload_texture_buffer(path.height_width_angle_buffer, path.height_width_angle_texture, GL_R32UI, path.height_width_angle_capacity, first,
+                          packed.data(), packed.size(), sizeof(uint32_t), GL_DYNAMIC_DRAW);
+}
+
+// Prints the GPU size of the positions, of the heights, widths and angles and of the colors, and when the positions are
+// quantized the largest error of the decoded ones
+static void report_point_buffers(const BufferedPath &path)
+{
+    const size_t count = path.total_points_count;
+    if (!path.quantized_positions) {
+        std::cout << "POSITIONS: " << count * sizeof(glm::vec3) / (1024 * 1024) << " MB as floats" << std::endl;
+    } else {
+        const size_t bytes = count * 3 * sizeof(uint16_t) + (count + Position_Chunk_Points - 1) / Position_Chunk_Points * sizeof(glm::vec4);
+        std::cout << "POSITIONS: " << bytes / (1024 * 1024) << " MB quantized instead of " << count * sizeof(glm::vec3) / (1024 * 1024)
+                  << " MB, steps of " << 1000.0f * config::position_precision << " um, max error " << 1000.0f * path.position_max_error << " um"
+                  << std::endl;
+    }
+    const size_t element_size = path.packed_height_width_angle ? sizeof(uint32_t) : sizeof(glm::vec3);
+    std::cout << "HEIGHT, WIDTH, ANGLE: " << count * element_size / (1024 * 1024) << (path.packed_height_width_angle ? " MB packed" : " MB as floats")
+              << std::endl;
+    if (!path.shader_colors)
+        std::cout << "COLORS: " << count * sizeof(uint8_t) / (1024 * 1024) << " MB of palette indices instead of " << count * sizeof(float) / (1024 * 1024)
+                  << " MB" << std::endl;
+}
+
+// The palette as RGBA with 8 bits per channel
+static std::array<std::array<uint8_t, 4>, Palette_Size> color_palette()
+{
+    assert(Extrusion_Role_Colors.size() <= Palette_Travel_First && Palette_Travel_First + Travel_Colors.size() <= Palette_Tool_First &&
+           Palette_Tool_First + Tools_Colors.size() <= Palette_Error);
+    std::array<std::array<uint8_t, 4>, Palette_Size> palette{};
+    auto set = [&](size_t index, const std::array<float, 3> &color) {
+        palette[index] = {uint8_t(255.0f * color[0]), uint8_t(255.0f * color[1]), uint8_t(255.0f * color[2]), 255};
     };
+    for (size_t i = 0; i < Extrusion_Role_Colors.size(); ++i) set(i, Extrusion_Role_Colors[i]);
+    for (size_t i = 0; i < Travel_Colors.size(); ++i) set(Palette_Travel_First + i, Travel_Colors[i]);
+    for (size_t i = 0; i < Tools_Colors.size(); ++i) set(Palette_Tool_First + i, Tools_Colors[i]);
+    set(Palette_Error, {0.5f, 0.5f, 0.5f});
+    for (size_t level = 0; level < Palette_Range_Levels; ++level)
+        set(Palette_Range_First + level, Range::color_at_scaled(float(level) * float(Range_Colors.size() - 1) / float(Palette_Range_Levels - 1)));
+    return palette;
+}
 
-    auto format_color = [&](const PathPoint& p) {
-        const std::array<float, 3> color = select_color(p);
-        const int r = (int)(255.0f * color[0]);
-        const int g = (int)(255.0f * color[1]);
-        const int b = (int)(255.0f * color[2]);
-        const int i_color = r << 16 | g << 8 | b;
-        return float(i_color);
+// Colors of the points starting at the given one, as indices in the palette. Points get the error color while the
+// column of the visualization type is not loaded. The switch on the visualization type is taken once, every case then
+// runs a loop over the flags and the one column it colors by.
+std::vector<uint8_t> computePathColors(const PathStore &columns, size_t first = 0)
+{
+    const unsigned int needed_columns = visualization_columns(config::visualization_type);
+    const bool         loaded         = (columns.loaded_columns & needed_columns) == needed_columns;
+
+    std::vector<uint8_t> colors(columns.count - first);
+    auto fill = [&](auto &&select_color) {
+        for (size_t i = first; i < columns.count; i++) colors[i - first] = uint8_t(select_color(i));
+    };
+
+    const Span<const unsigned int> flags = columns.view<Column::Flags>();
+    // travels keep their own colors, extrusions are colored by the range
+    auto fill_range = [&](const Range &range, Span<const float> values) {
+        fill([&](size_t i) {
+            const unsigned int role = extract_role_from_flags(flags[i]);
+            const bool is_travel = extract_type_from_flags(flags[i]) == 8;
+            assert(!is_travel || role < Travel_Colors.size());
+            return is_travel ? Palette_Travel_First + role : range.get_palette_index_at(values[i]);
+        });
     };
 
-    std::vector<float> colors(path_points.size());
-    for (size_t i = 0; i < path_points.size(); i++) {
-        colors[i] = format_color(path_points[i]);
+    switch (loaded ? config::visualization_type : -1)
+    {
+    // feature type
+    case 0:
+        fill([&](size_t i) {
+            const unsigned int role = extract_role_from_flags(flags[i]);
+            const unsigned int type = extract_type_from_flags(flags[i]);
+            const bool is_travel = type == 8;
+            assert((is_travel && role < Travel_Colors.size()) || (type == 10 && role < Extrusion_Role_Colors.size()));
+            return is_travel ? Palette_Travel_First + role : role;
+        });
+        break;
+    case 1: fill_range(height_range, columns.view<Column::Height>()); break;
+    case 2: fill_range(width_range, columns.view<Column::Width>()); break;
+    // speed, travels included
+    case 3: {
+        const Span<const float> speed = columns.view<Column::Speed>();
+        fill([&](size_t i) { return speed_range.get_palette_index_at(speed[i]); });
+        break;
     }
+    case 4: fill_range(fanspeed_range, columns.view<Column::FanSpeed>()); break;
+    case 5: fill_range(temperature_range, columns.view<Column::Temperature>()); break;
+    case 6: fill_range(volumetricrate_range, columns.view<Column::VolumetricRate>()); break;
+    // tool
+    case 9: {
+        const Span<const unsigned int> extruderid = columns.view<Column::ExtruderId>();
+        fill([&](size_t i) {
+            assert(extruderid[i] < Tools_Colors.size());
+            return Palette_Tool_First + extruderid[i];
+        });
+        break;
+    }
+    // color print
+    case 10: {
+        const Span<const unsigned int> colorid = columns.view<Column::ColorId>();
+        fill([&](size_t i) { return Palette_Tool_First + colorid[i] % Tools_Colors.size(); });
+        break;
+    }
+    default: fill([](size_t) { return Palette_Error; }); break;
+    }
+    return colors;
+}
+
+// Updates the colors starting at the given point, the ones before it are kept
+void updatePathColors(BufferedPath &path, const PathStore &columns, size_t first = 0)
+{
+    const std::vector<uint8_t> colors = computePathColors(columns, first);
     assert(path.color_buffer > 0);
-    glBindBuffer(GL_TEXTURE_BUFFER, path.color_buffer);
-    // buffer data to the path buffer
-    glBufferData(GL_TEXTURE_BUFFER, colors.size() * sizeof(float), colors.data(), GL_STATIC_DRAW);
-    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+    if (first == 0) {
+        glBindBuffer(GL_TEXTURE_BUFFER, path.color_buffer);
+        // buffer data to the path buffer
+        glBufferData(GL_TEXTURE_BUFFER, colors.size(), colors.data(), GL_STATIC_DRAW);
+        glBindBuffer(GL_TEXTURE_BUFFER, 0);
+        path.color_capacity = colors.size();
+    } else {
+        upload_texture_buffer(path.color_buffer, path.color_texture, GL_R8UI, path.color_capacity, first, colors.data(), colors.size(),
+                              sizeof(uint8_t), GL_STATIC_DRAW);
+    }
 }
 
-std::vector<glm::ivec3> get_covered_voxels(const glm::vec3 &ray_start, const glm::vec3 &ray_end)
+// Uploads for the shader colors the points not on the GPU yet of the flags, of the column the visualization type colors
+// by and of the columns uploaded before. Nothing is computed on the CPU: once the column of a visualization type is on
+// the GPU, switching to it only changes uniforms.
+void updateColorColumns(BufferedPath &path, const PathStore &columns)
 {
-    std::vector<glm::ivec3> visited_voxels;
+    const Column colored = colored_column(config::visualization_type);
+    for (size_t c = 0; c < size_t(Column::Count); ++c) {
+        const Column  column = Column(c);
+        ColumnBuffer &gpu    = path.column_buffers[c];
+        const bool    needed = column == Column::Flags || column == colored || gpu.count > 0;
+        if (!needed || !columns.has(column) || gpu.count >= columns.count)
+            continue;
+        if (gpu.texture == 0)
+            glGenTextures(1, &gpu.texture);
+        const size_t element_size = PathStore::element_size(column);
+        upload_texture_buffer(gpu.buffer, gpu.texture, is_id_column(column) ? GL_R32UI : GL_R32F, gpu.capacity, gpu.count,
+                              static_cast<const char *>(columns.column_data(column)) + gpu.count * element_size, columns.count - gpu.count,
+                              element_size, GL_STATIC_DRAW);
+        gpu.count = columns.count;
+    }
+}
 
-    glm::ivec3 current_voxel(std::floor(ray_start.x / config::voxel_size), std::floor(ray_start.y / config::voxel_size),
-                             std::floor(ray_start.z / config::voxel_size));
+// The visualization type the shader colors by: -1, the error color, while its column is not on the GPU
+static int shader_visualization_type(const BufferedPath &path)
+{
+    const Column colored = colored_column(config::visualization_type);
+    return colored == Column::Count || path.column_buffers[size_t(colored)].count > 0 ? config::visualization_type : -1;
+}
+
+// Sets the palettes of the shader colors in the uniforms of the given program, which is in use
+static void set_color_palettes(GLuint program)
+{
+    auto set = [program](const char *name, const std::vector<std::array<float, 3>> &colors) {
+        const GLint location = glGetUniformLocation(program, name);
+        assert(location >= 0);
+        glUniform3fv(location, GLsizei(colors.size()), colors.front().data());
+    };
+    set("extrusion_role_colors", Extrusion_Role_Colors);
+    set("travel_colors", Travel_Colors);
+    set("range_colors", Range_Colors);
+    set("tools_colors", Tools_Colors);
+}
 
-    glm::ivec3 last_voxel(std::floor(ray_end.x / config::voxel_size), std::floor(ray_end.y / config::voxel_size),
-                          std::floor(ray_end.z / config::voxel_size));
+// Coordinates of the voxel of the given size containing the position
+static glm::ivec3 voxel_coords(const glm::vec3 &position, float voxel_size = config::voxel_size)
+{
+    return glm::ivec3(std::floor(position.x / voxel_size), std::floor(position.y / voxel_size), std::floor(position.z / voxel_size));
+}
+
+// Voxels crossed by the segment, from the voxel of its start to the voxel of its end. The reference walk, the index
+// walks the segments with walk_segments.
+std::vector<glm::ivec3> get_covered_voxels(const glm::vec3 &ray_start, const glm::vec3 &ray_end, float voxel_size = config::voxel_size)
+{
+    std::vector<glm::ivec3> visited_voxels;
+
+    glm::ivec3 current_voxel = voxel_coords(ray_start, voxel_size);
+    glm::ivec3 last_voxel    = voxel_coords(ray_end, voxel_size);
 
     glm::dvec3 ray = ray_end - ray_start;
 
@@ -389,39 +1331,25 @@ std::vector<glm::ivec3> get_covered_voxels(const glm::vec3 &ray_start, const glm
     double stepY = (ray.y >= 0) ? 1 : -1;
     double stepZ = (ray.z >= 0) ? 1 : -1;
 
-    double next_voxel_boundary_x = (current_voxel.x + stepX) * config::voxel_size;
-    double next_voxel_boundary_y = (current_voxel.y + stepY) * config::voxel_size;
-    double next_voxel_boundary_z = (current_voxel.z + stepZ) * config::voxel_size;
+    // the first boundary crossed is the upper one of the voxel for positive steps and its lower one for negative steps
+    double next_voxel_boundary_x = (current_voxel.x + (stepX > 0 ? 1 : 0)) * voxel_size;
+    double next_voxel_boundary_y = (current_voxel.y + (stepY > 0 ? 1 : 0)) * voxel_size;
+    double next_voxel_boundary_z = (current_voxel.z + (stepZ > 0 ? 1 : 0)) * voxel_size;
 
     double tMaxX = (ray.x != 0) ? (next_voxel_boundary_x - ray_start.x) / ray.x : DBL_MAX;
     double tMaxY = (ray.y != 0) ? (next_voxel_boundary_y - ray_start.y) / ray.y : DBL_MAX;
     double tMaxZ = (ray.z != 0) ? (next_voxel_boundary_z - ray_start.z) / ray.z : DBL_MAX;
 
-    double tDeltaX = (ray.x != 0) ? config::voxel_size / ray.x * stepX : DBL_MAX;
-    double tDeltaY = (ray.y != 0) ? config::voxel_size / ray.y * stepY : DBL_MAX;
-    double tDeltaZ = (ray.z != 0) ? config::voxel_size / ray.z * stepZ : DBL_MAX;
+    double tDeltaX = (ray.x != 0) ? voxel_size / ray.x * stepX : DBL_MAX;
+    double tDeltaY = (ray.y != 0) ? voxel_size / ray.y * stepY : DBL_MAX;
+    double tDeltaZ = (ray.z != 0) ? voxel_size / ray.z * stepZ : DBL_MAX;
 
-    glm::ivec3 diff(0, 0, 0);
-    bool       neg_ray = false;
-    if (current_voxel.x != last_voxel.x && ray.x < 0) {
-        diff.x--;
-        neg_ray = true;
-    }
-    if (current_voxel.y != last_voxel.y && ray.y < 0) {
-        diff.y--;
-        neg_ray = true;
-    }
-    if (current_voxel.z != last_voxel.z && ray.z < 0) {
-        diff.z--;
-        neg_ray = true;
-    }
     visited_voxels.push_back(current_voxel);
-    if (neg_ray) {
-        current_voxel += diff;
-        visited_voxels.push_back(current_voxel);
-    }
 
-    while (last_voxel != current_voxel) {
+    // every step moves one voxel closer to the last one, rounding cannot make the walk longer than that
+    const glm::ivec3 distance = glm::abs(last_voxel - current_voxel);
+    size_t           steps    = size_t(distance.x) + size_t(distance.y) + size_t(distance.z);
+    while (last_voxel != current_voxel && steps-- > 0) {
         if (tMaxX < tMaxY) {
             if (tMaxX < tMaxZ) {
                 current_voxel.x += stepX;
@@ -441,103 +1369,375 @@ std::vector<glm::ivec3> get_covered_voxels(const glm::vec3 &ray_start, const glm
         }
         visited_voxels.push_back(current_voxel);
     }
+    if (current_voxel != last_voxel)
+        visited_voxels.push_back(last_voxel);
 
     return visited_voxels;
 }
 
-BufferedPath bufferExtrusionPaths(const std::vector<PathPoint>& path_points) {
-    BufferedPath result;
-
-    std::vector<glm::vec3> positions;
-    std::vector<glm::vec3> height_width_angle;
-
-    result.valid_lines_bitset = bitset::BitSet<>(path_points.size());
-    result.valid_lines_bitset.setAll();
-    result.visible_lines_bitset = bitset::BitSet<std::atomic_size_t>(path_points.size());
-    result.visible_lines_bitset.clear();
+// quotients[i] = numerators[i] / denominators[i], on the widest SIMD lanes the build targets
+static void divide(const double *numerators, const double *denominators, double *quotients, size_t count)
+{
+    size_t i = 0;
+#if defined(__AVX__)
+    for (; i + 4 <= count; i += 4) _mm256_storeu_pd(quotients + i, _mm256_div_pd(_mm256_loadu_pd(numerators + i), _mm256_loadu_pd(denominators + i)));
+#endif
+#if defined(__AVX__) || defined(__SSE2__) || defined(_M_X64)
+    for (; i + 2 <= count; i += 2) _mm_storeu_pd(quotients + i, _mm_div_pd(_mm_loadu_pd(numerators + i), _mm_loadu_pd(denominators + i)));
+#endif
+    for (; i < count; ++i) quotients[i] = numerators[i] / denominators[i];
+}
 
-    std::unordered_map<glm::ivec3, std::unordered_set<size_t>> visibility_boxes;
+// Voxels crossed by the segments position[i] -> position[i + 1] of the given indices, appended to voxels: the voxels of
+// get_covered_voxels in the same order, from the same arithmetic. counts[s] receives the number of voxels of segment s.
+// The voxel size is a parameter so that the tuning can walk candidate sizes while the config one is in use.
+// Nothing is allocated once voxels is large enough.
+//
+// Most segments of a print stay within a voxel, they only take the voxel of their start. The walks of the others are
+// set up a batch at a time, their divisions on SIMD lanes, then stepped one after the other. Stepping several walks side
+// by side on SIMD lanes, the axis of every lane selected by masks and a lane taking the next walk once its own is done,
+// gives the same voxels in no less time: the walks are short, and the stores and refills of the lanes cost as much as the
+// mispredicted axes they save.
+static void walk_segments(const glm::vec3 *position, const size_t *segments, size_t count, std::vector<glm::ivec3> &voxels, uint32_t *counts,
+                          float voxel_size = config::voxel_size)
+{
+    constexpr size_t Batch = 64;
+    glm::ivec3       first_voxel[Batch], last_voxel[Batch];
+    glm::vec3        ray[Batch];
+    double           numerators[3 * Batch], denominators[3 * Batch], sizes[3 * Batch], t_max[3 * Batch], t_delta[3 * Batch];
+    std::fill(std::begin(sizes), std::end(sizes), double(voxel_size));
+
+    for (size_t batch = 0; batch < count; batch += Batch) {
+        const size_t batch_count = std::min(Batch, count - batch);
+        size_t       walks       = 0;
+        for (size_t s = 0; s < batch_count; ++s) {
+            const glm::vec3 &start = position[segments[batch + s]];
+            const glm::vec3 &end   = position[segments[batch + s] + 1];
+            first_voxel[s]         = voxel_coords(start, voxel_size);
+            last_voxel[s]          = voxel_coords(end, voxel_size);
+            if (first_voxel[s] == last_voxel[s])
+                continue;
+            ray[s] = end - start;
+            for (int axis = 0; axis < 3; ++axis) {
+                // the first boundary crossed is the upper one of the voxel for positive steps and its lower one for negative steps
+                const double boundary               = (first_voxel[s][axis] + (ray[s][axis] >= 0 ? 1 : 0)) * voxel_size;
+                numerators[3 * walks + axis]        = boundary - start[axis];
+                denominators[3 * walks + axis]      = ray[s][axis] != 0 ? double(ray[s][axis]) : 1.0;
+            }
+            ++walks;
+        }
+        divide(numerators, denominators, t_max, 3 * walks);
+        divide(sizes, denominators, t_delta, 3 * walks);
+
+        for (size_t s = 0, walk = 0; s < batch_count; ++s) {
+            glm::ivec3 current = first_voxel[s];
+            voxels.push_back(current);
+            if (current == last_voxel[s]) {
+                counts[batch + s] = 1;
+                continue;
+            }
+            glm::ivec3 step;
+            double     max[3], delta[3];
+            for (int axis = 0; axis < 3; ++axis) {
+                step[axis]  = ray[s][axis] >= 0 ? 1 : -1;
+                max[axis]   = ray[s][axis] != 0 ? t_max[3 * walk + axis] : DBL_MAX;
+                delta[axis] = ray[s][axis] != 0 ? t_delta[3 * walk + axis] * step[axis] : DBL_MAX;
+            }
+            ++walk;
+
+            const glm::ivec3 last     = last_voxel[s];
+            const glm::ivec3 distance = glm::abs(last - current);
+            size_t           steps    = size_t(distance.x) + size_t(distance.y) + size_t(distance.z);
+            const size_t     before   = voxels.size() - 1;
+            while (last != current && steps-- > 0) {
+                const int axis = max[0] < max[1] ? (max[0] < max[2] ? 0 : 2) : (max[1] < max[2] ? 1 : 2);
+                current[axis] += step[axis];
+                max[axis] += delta[axis];
+                voxels.push_back(current);
+            }
+            if (current != last)
+                voxels.push_back(last);
+            counts[batch + s] = uint32_t(voxels.size() - before);
+        }
+    }
+}
 
-    // fill first position with empty box. This is to ensure that we can use 0 as clear value for visilibty framebuffer
-    glm::ivec3 max_coords{std::numeric_limits<int>::min(), std::numeric_limits<int>::min(), std::numeric_limits<int>::min()};
-    visibility_boxes[max_coords] = {};
+// The lowest 21 bits of the value moved to every third bit, and back
+static uint64_t spread_bits(uint64_t value)
+{
+    value &= 0x1fffff;
+    value = (value | value << 32) & 0x1f00000000ffffull;
+    value = (value | value << 16) & 0x1f0000ff0000ffull;
+    value = (value | value << 8) & 0x100f00f00f00f00full;
+    value = (value | value << 4) & 0x10c30c30c30c30c3ull;
+    value = (value | value << 2) & 0x1249249249249249ull;
+    return value;
+}
 
-    for (size_t i = 0; i < path_points.size(); i++) {
-        bool      prev_line_valid = i > 0 && result.valid_lines_bitset[i - 1];
-        glm::vec3 prev_line       = prev_line_valid ? (path_points[i].position - path_points[i - 1].position) : glm::vec3(0);
+static uint64_t compact_bits(uint64_t value)
+{
+    value &= 0x1249249249249249ull;
+    value = (value ^ (value >> 2)) & 0x10c30c30c30c30c3ull;
+    value = (value ^ (value >> 4)) & 0x100f00f00f00f00full;
+    value = (value ^ (value >> 8)) & 0x1f0000ff0000ffull;
+    value = (value ^ (value >> 16)) & 0x1f00000000ffffull;
+    value = (value ^ (value >> 32)) & 0x1fffffull;
+    return value;
+}
 
-        bool      this_line_valid = i + 1 < path_points.size() && path_points[i + 1].position != path_points[i].position;
-        
-        //THIS disables travel moves completely
-        this_line_valid = !path_points[i].is_travel_move();
+// Morton code of voxel coordinates of up to 21 bits, their bits interleaved from the lowest one of x
+static uint64_t morton_code(const glm::uvec3 &coords) { return spread_bits(coords.x) | spread_bits(coords.y) << 1 | spread_bits(coords.z) << 2; }
 
-        glm::vec3 this_line       = this_line_valid ? (path_points[i + 1].position - path_points[i].position) : glm::vec3(0);
+static glm::uvec3 morton_coords(uint64_t code) { return glm::uvec3(compact_bits(code), compact_bits(code >> 1), compact_bits(code >> 2)); }
 
-        if (this_line_valid) {
-            // there is a valid path between point i and i+1.
-            auto covered = get_covered_voxels(path_points[i].position, path_points[i + 1].position);
-            for (const auto &coords : covered) {
-                visibility_boxes[coords].insert(i);
+// Stable least significant digit radix sort of keys on their bits [first_bit, first_bit + bits), in passes over digits
+// of at most 11 bits. The keys given in parts are sorted into a single array, the parts are released after the first
+// pass. Every pass counts the digits of equal parts of the keys in parallel, then moves them to their place in parallel;
+// the passes over a digit all keys share are skipped.
+static std::vector<uint64_t> radix_sort(std::vector<std::vector<uint64_t>> &parts, int first_bit, int bits)
+{
+    constexpr int Max_Digit_Bits = 11;
+    const int     passes         = std::max(1, (bits + Max_Digit_Bits - 1) / Max_Digit_Bits);
+    const int     digit_bits     = (bits + passes - 1) / passes;
+    const size_t  digits         = size_t(1) << digit_bits;
+
+    size_t count = 0;
+    for (const std::vector<uint64_t> &part : parts) count += part.size();
+    std::vector<uint64_t>             sorted(count), scratch;
+    std::vector<Span<const uint64_t>> sources;
+    for (const std::vector<uint64_t> &part : parts) sources.push_back(Span<const uint64_t>(part.data(), part.size()));
+    std::vector<size_t> indices(sources.size());
+    std::iota(indices.begin(), indices.end(), 0);
+
+    std::vector<std::vector<size_t>> starts(sources.size(), std::vector<size_t>(digits));
+    for (int pass = 0; pass < passes; ++pass) {
+        const int shift = first_bit + pass * digit_bits;
+        std::for_each(std::execution::par, indices.begin(), indices.end(), [&](size_t p) {
+            std::fill(starts[p].begin(), starts[p].end(), 0);
+            for (uint64_t key : sources[p]) ++starts[p][(key >> shift) & (digits - 1)];
+        });
+        // digit d of part p goes after the lower digits of all the parts and digit d of the parts before p
+        size_t start = 0, largest = 0;
+        for (size_t d = 0; d < digits; ++d) {
+            const size_t digit_start = start;
+            for (size_t p = 0; p < sources.size(); ++p) {
+                const size_t part_count = starts[p][d];
+                starts[p][d]            = start;
+                start += part_count;
             }
+            largest = std::max(largest, start - digit_start);
+        }
+        if (largest == count && pass > 0)
+            continue;
+        uint64_t *destination = pass == 0 ? sorted.data() : scratch.data();
+        std::for_each(std::execution::par, indices.begin(), indices.end(), [&](size_t p) {
+            for (uint64_t key : sources[p]) destination[starts[p][(key >> shift) & (digits - 1)]++] = key;
+        });
+
+        if (pass == 0) {
+            parts = {};
+            scratch.resize(count);
         } else {
-            // the connection is invalid, there should be no line rendered, ever
-            result.valid_lines_bitset.reset(i);
+            std::swap(sorted, scratch);
         }
+        // the next pass reads equal parts of the sorted keys
+        for (size_t p = 0; p < sources.size(); ++p)
+            sources[p] = Span<const uint64_t>(sorted.data() + count * p / sources.size(), count * (p + 1) / sources.size() - count * p / sources.size());
+    }
+    return sorted;
+}
 
-        const PathPoint &p = path_points[i];
-        positions.push_back({p.position});
-        const float height = p.is_travel_move() ? 0.1f : p.height;
-        const float width  = p.is_travel_move() ? 0.1f : p.width;
-
-        const float angle = atan2(prev_line.x * this_line.y - prev_line.y * this_line.x, glm::dot(prev_line, this_line));
+// Vertices (with the box id in w) and triangle indices of the visibility boxes [first, count)
+static void buildVisibilityBoxes(const std::vector<glm::ivec3> &boxes, size_t first, size_t count,
+                                 std::vector<glm::vec4> &boxes_positions_w_ids, std::vector<GLuint> &boxes_indices)
+{
+    boxes_positions_w_ids.reserve(boxes_positions_w_ids.size() + (count - first) * std::size(unit_box_vertices));
+    boxes_indices.reserve(boxes_indices.size() + (count - first) * std::size(unit_box_indices));
+
+    for (size_t box_index = first; box_index < count; box_index++) {
+        size_t     indices_offset = box_index * std::size(unit_box_vertices);
+        glm::ivec3 coords         = boxes[box_index];
+        for (glm::ivec3 coord_offset : unit_box_vertices) {
+            glm::vec3 final_pos = glm::vec3(coords + coord_offset) * config::voxel_size;
+            boxes_positions_w_ids.push_back({final_pos.x, final_pos.y, final_pos.z, box_index});
+        }
+        for (GLuint index : unit_box_indices) {
+            boxes_indices.push_back(indices_offset + index);
+        }
+    }
+}
 
-        height_width_angle.push_back({height, width, angle}); 
+// Uploads the vertices and indices of the visibility boxes [path.uploaded_boxes_count, count), box ids never change
+static void uploadVisibilityBoxes(BufferedPath &path, size_t count, const glm::vec4 *boxes_positions_w_ids, const GLuint *boxes_indices)
+{
+    const size_t first         = path.uploaded_boxes_count;
+    const size_t vertex_stride = std::size(unit_box_vertices) * sizeof(glm::vec4);
+    const size_t index_stride  = std::size(unit_box_indices) * sizeof(GLuint);
+
+    glBindVertexArray(path.visibility_VAO);
+    if (count > path.boxes_capacity) {
+        path.boxes_capacity = grown_capacity(path.boxes_capacity, count);
+        grow_buffer(path.visibility_boxes_vertex_buffer, first * vertex_stride, path.boxes_capacity * vertex_stride, GL_STATIC_DRAW);
+        grow_buffer(path.visibility_boxes_index_buffer, first * index_stride, path.boxes_capacity * index_stride, GL_STATIC_DRAW);
+
+        // the buffers were replaced, so the VAO has to point to the new ones
+        glBindBuffer(GL_ARRAY_BUFFER, path.visibility_boxes_vertex_buffer);
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, sizeof(glm::vec4), (void *) 0);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, path.visibility_boxes_index_buffer);
     }
+    glBindBuffer(GL_ARRAY_BUFFER, path.visibility_boxes_vertex_buffer);
+    glBufferSubData(GL_ARRAY_BUFFER, first * vertex_stride, (count - first) * vertex_stride, boxes_positions_w_ids);
 
-    result.total_points_count = path_points.size();
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, path.visibility_boxes_index_buffer);
+    glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, first * index_stride, (count - first) * index_stride, boxes_indices);
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
 
-    // VISIBILITY BOXES DATA
-    {
-          // fill first position with empty box. This is to ensure that we can use 0 as clear value for visilibty framebuffer
-        result.visibility_boxes_with_segments.push_back({max_coords, {}});
-        for (const auto &pair : visibility_boxes) {
-            if (pair.first != max_coords) {
-                result.visibility_boxes_with_segments.push_back({pair.first, {pair.second.begin(), pair.second.end()}});
-            }
-        };
+    path.index_buffer_size    = count * std::size(unit_box_indices);
+    path.uploaded_boxes_count = count;
+
+    // new boxes start hot, so that they are tested in the next visibility pass
+    path.visible_boxes_heat.resize(count, 1);
+    path.visible_boxes_indices_distr = std::uniform_int_distribution<size_t>{0, count - 1};
+}
+
+// Uploads the visibility boxes added since the last upload
+static void uploadVisibilityBoxes(BufferedPath &path)
+{
+    const size_t first = path.uploaded_boxes_count;
+    const size_t count = path.visibility_box_coords.size();
+    if (first == count)
+        return;
+
+    std::vector<glm::vec4> boxes_positions_w_ids;
+    std::vector<GLuint>    boxes_indices;
+    buildVisibilityBoxes(path.visibility_box_coords, first, count, boxes_positions_w_ids, boxes_indices);
+    uploadVisibilityBoxes(path, count, boxes_positions_w_ids.data(), boxes_indices.data());
+}
 
-        std::vector<glm::vec4> boxes_positions_w_ids;
-        std::vector<GLuint>    boxes_indices;
+// Indices of the set bits split by draw chunk, as offsets from the first segment of their chunk. chunk_ends[c] is where
+// chunk c ends in indices.
+template<typename T> static void collect_segments(const bitset::BitSet<T> &lines, std::vector<uint32_t> &indices, std::vector<size_t> &chunk_ends)
+{
+    indices.clear();
+    chunk_ends.clear();
+    for (size_t begin = 0; begin == 0 || begin < lines.size; begin += draw_chunk_segments) {
+        lines.get_enabled_indices(indices, begin, begin + draw_chunk_segments);
+        chunk_ends.push_back(indices.size());
+    }
+}
 
-        for (size_t box_index = 0; box_index < result.visibility_boxes_with_segments.size(); box_index++) {
-            size_t     indices_offset = boxes_positions_w_ids.size();
-            glm::ivec3 coords         = result.visibility_boxes_with_segments[box_index].first;
-            for (glm::ivec3 coord_offset : unit_box_vertices) {
-                glm::vec3 final_pos = glm::vec3(coords + coord_offset) * config::voxel_size;
-                boxes_positions_w_ids.push_back({final_pos.x, final_pos.y, final_pos.z, box_index});
+// Uploads the visible lines, they are drawn until the next upload
+void uploadVisibleSegments(BufferedPath &path)
+{
+    glBindBuffer(GL_TEXTURE_BUFFER, path.visible_segments_buffer);
+    glBufferData(GL_TEXTURE_BUFFER, path.visible_lines.size() * sizeof(uint32_t), path.visible_lines.data(), GL_STREAM_DRAW);
+    path.visible_segments_count      = path.visible_lines.size();
+    path.visible_segments_chunk_ends = path.visible_lines_chunk_ends;
+}
+
+static void bind_texture_range(GLenum unit, GLuint texture, GLenum format, GLuint buffer, size_t first, size_t count, size_t element_size)
+{
+    glActiveTexture(unit);
+    glBindTexture(GL_TEXTURE_BUFFER, texture);
+    glTexBufferRange(GL_TEXTURE_BUFFER, format, buffer, GLintptr(first * element_size), GLsizeiptr(count * element_size));
+}
+
+// Draws the uploaded visible segments with the program of render(), its point textures bound to units 0 to 3, the
+// quantized positions to units 4 and 5, the packed heights, widths and angles to unit 6 and the columns of the shader
+// colors to units 7 to 9, or with segment_records the SegmentRecord buffer to pathSSBObindPoint in place of the
+// positions and the heights, widths and angles. A scene of a single chunk keeps the bindings of the whole buffers.
+// Indexed segments are drawn from gcodeIndexedVAO, the others from gcodeVAO, which the caller binds.
+void drawVisibleSegments(const BufferedPath &path, GLint instance_base_location, bool segment_records = false, bool indexed = false)
+{
+    const size_t chunks = path.visible_segments_chunk_ends.size();
+    if (chunks > 1 && glTexBufferRange == nullptr) {
+        static bool reported = false;
+        if (!reported)
+            std::cerr << "Texture buffer ranges are not supported, only the first " << draw_chunk_segments << " segments are drawn" << std::endl;
+        reported = true;
+    }
+    glUniform1i(instance_base_location, 0);
+    for (size_t c = 0, first = 0; c < chunks; first = path.visible_segments_chunk_ends[c++]) {
+        const size_t count = path.visible_segments_chunk_ends[c] - first;
+        if (count == 0)
+            continue;
+        if (chunks > 1) {
+            if (glTexBufferRange == nullptr)
+                break;
+            // the points of the chunk and the one ending its last segment
+            const size_t base   = c * draw_chunk_segments;
+            const size_t points = std::min(draw_chunk_segments + 1, path.total_points_count - base);
+            if (segment_records) {
+                const size_t records = std::min(draw_chunk_segments, path.segment_records_count - base);
+                glBindBufferRange(GL_SHADER_STORAGE_BUFFER, pathSSBObindPoint, path.segment_records_buffer, GLintptr(base * sizeof(SegmentRecord)),
+                                  GLsizeiptr(records * sizeof(SegmentRecord)));
+            } else {
+                if (path.quantized_positions) {
+                    bind_texture_range(GL_TEXTURE4, path.positions_texture, GL_R16UI, path.positions_buffer, base, points, 3 * sizeof(uint16_t));
+                    bind_texture_range(GL_TEXTURE5, path.position_chunks_texture, GL_RGBA32F, path.position_chunks_buffer,
+                                       base / Position_Chunk_Points, (points + Position_Chunk_Points - 1) / Position_Chunk_Points, sizeof(glm::vec4));
+                } else {
+                    bind_texture_range(GL_TEXTURE0, path.positions_texture, GL_RGB32F, path.positions_buffer, base, points, sizeof(glm::vec3));
+                }
+                if (path.packed_height_width_angle)
+                    bind_texture_range(GL_TEXTURE6, path.height_width_angle_texture, GL_R32UI, path.height_width_angle_buffer, base, points,
+                                       sizeof(uint32_t));
+                else
+                    bind_texture_range(GL_TEXTURE1, path.height_width_angle_texture, GL_RGB32F, path.height_width_angle_buffer, base, points,
+                                       sizeof(glm::vec3));
             }
-            for (GLuint index : unit_box_indices) {
-                boxes_indices.push_back(indices_offset + index);
+            if (path.shader_colors) {
+                const ColumnBuffer &flags = path.column_buffers[size_t(Column::Flags)];
+                bind_texture_range(GL_TEXTURE7, flags.texture, GL_R32UI, flags.buffer, base, points, sizeof(unsigned int));
+                const Column colored = colored_column(config::visualization_type);
+                if (shader_visualization_type(path) >= 0 && colored != Column::Count) {
+                    const ColumnBuffer &values = path.column_buffers[size_t(colored)];
+                    const bool          ids    = is_id_column(colored);
+                    bind_texture_range(ids ? GL_TEXTURE9 : GL_TEXTURE8, values.texture, ids ? GL_R32UI : GL_R32F, values.buffer, base, points,
+                                       sizeof(float));
+                }
+            } else {
+                bind_texture_range(GL_TEXTURE2, path.color_texture, GL_R8UI, path.color_buffer, base, points, sizeof(uint8_t));
             }
+            // the indices are bound from an aligned offset, the shader skips the ones before the chunk
+            const size_t alignment = size_t(texture_buffer_offset_alignment);
+            const size_t offset    = first * sizeof(uint32_t);
+            const size_t aligned   = offset / alignment * alignment;
+            glActiveTexture(GL_TEXTURE3);
+            glBindTexture(GL_TEXTURE_BUFFER, path.visible_segments_texture);
+            glTexBufferRange(GL_TEXTURE_BUFFER, GL_R32UI, path.visible_segments_buffer, GLintptr(aligned),
+                             GLsizeiptr(offset - aligned + count * sizeof(uint32_t)));
+            glUniform1i(instance_base_location, GLint((offset - aligned) / sizeof(uint32_t)));
         }
+        if (indexed)
+            glDrawElementsInstanced(GL_TRIANGLES, (GLsizei) vertex_data_size, GL_UNSIGNED_INT, nullptr, (GLsizei) count);
+        else
+            glDrawArraysInstanced(GL_TRIANGLES, 0, (GLsizei) vertex_data_size, (GLsizei) count);
+    }
+}
 
-        result.visible_boxes_heat          = std::vector<GLint>(result.visibility_boxes_with_segments.size(), 1);
-        result.visible_boxes_indices_distr = std::uniform_int_distribution<size_t>{0, result.visibility_boxes_with_segments.size() - 1};
+// Creates the GL objects of an empty path, the points are added by appendExtrusionPaths
+BufferedPath createBufferedPath()
+{
+    BufferedPath result;
 
-        glGenVertexArrays(1, &result.visibility_VAO);
-        glBindVertexArray(result.visibility_VAO);
+    result.valid_lines_bitset   = bitset::BitSet<>(0);
+    result.enabled_lines_bitset = bitset::BitSet<>(0);
+    result.visible_lines_bitset = bitset::BitSet<std::atomic_size_t>(0);
 
+    // VISIBILITY BOXES DATA
+    {
+        glGenVertexArrays(1, &result.visibility_VAO);
         glGenBuffers(1, &result.visibility_boxes_vertex_buffer);
-        glBindBuffer(GL_ARRAY_BUFFER, result.visibility_boxes_vertex_buffer);
-        glBufferData(GL_ARRAY_BUFFER, boxes_positions_w_ids.size() * sizeof(glm::vec4), boxes_positions_w_ids.data(), GL_STATIC_DRAW);
-        glEnableVertexAttribArray(0);
-        glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, sizeof(glm::vec4), (void *) 0);
-
         glGenBuffers(1, &result.visibility_boxes_index_buffer);
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, result.visibility_boxes_index_buffer);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, boxes_indices.size() * sizeof(GLuint), boxes_indices.data(), GL_STATIC_DRAW);
 
-        result.index_buffer_size = boxes_indices.size();
+        // fill first position with empty box. This is to ensure that we can use 0 as clear value for visilibty framebuffer
+        glm::ivec3 max_coords{std::numeric_limits<int>::min(), std::numeric_limits<int>::min(), std::numeric_limits<int>::min()};
+        result.visibility_box_coords.push_back(max_coords);
+        result.visibility_box_ids[max_coords] = 0;
+        uploadVisibilityBoxes(result);
 
         // Create a buffer object and bind it to the texture buffer
         glGenBuffers(1, &result.visible_boxes_buffer);
@@ -553,68 +1753,29 @@ BufferedPath bufferExtrusionPaths(const std::vector<PathPoint>& path_points) {
 
     ///GCODE DATA
     glBindVertexArray(gcodeVAO);
-    // Create a buffer object and bind it to the texture buffer
+    // Create the buffer objects and the textures, the storage is allocated when the points are appended
     glGenBuffers(1, &result.positions_buffer);
-    glBindBuffer(GL_TEXTURE_BUFFER, result.positions_buffer);
-
-    // buffer data to the path buffer
-    glBufferData(GL_TEXTURE_BUFFER, positions.size() * sizeof(glm::vec3), positions.data(), GL_STATIC_DRAW);
-
-    // Create and bind the path texture
     glGenTextures(1, &result.positions_texture);
-    glBindTexture(GL_TEXTURE_BUFFER, result.positions_texture);
-
-    // Attach the buffer object to the texture buffer
-    glTexBuffer(GL_TEXTURE_BUFFER, GL_RGB32F, result.positions_buffer);
-
-    // Unbind the buffer object and the texture buffer
-    glBindBuffer(GL_TEXTURE_BUFFER, 0);
-    glBindTexture(GL_TEXTURE_BUFFER, 0);
-
-     // Create a buffer object and bind it to the texture buffer
+    result.quantized_positions       = config::quantize_positions;
+    result.packed_height_width_angle = config::pack_height_width_angle;
+    result.shader_colors             = config::shader_colors;
+    glGenBuffers(1, &result.position_chunks_buffer);
+    glGenTextures(1, &result.position_chunks_texture);
     glGenBuffers(1, &result.height_width_angle_buffer);
-    glBindBuffer(GL_TEXTURE_BUFFER, result.height_width_angle_buffer);
-
-    // buffer data to the path buffer
-    glBufferData(GL_TEXTURE_BUFFER, height_width_angle.size() * sizeof(glm::vec3), height_width_angle.data(), GL_DYNAMIC_DRAW);
-
-    // Create and bind the path texture
     glGenTextures(1, &result.height_width_angle_texture);
-    glBindTexture(GL_TEXTURE_BUFFER, result.height_width_angle_texture);
-
-    // Attach the buffer object to the texture buffer
-    glTexBuffer(GL_TEXTURE_BUFFER, GL_RGB32F, result.height_width_angle_buffer);
-
-    // Unbind the buffer object and the texture buffer
-    glBindBuffer(GL_TEXTURE_BUFFER, 0);
-    glBindTexture(GL_TEXTURE_BUFFER, 0);
 
     //COLOR BUFFER
-    // Create a buffer object and bind it to the texture buffer
     glGenBuffers(1, &result.color_buffer);
     glBindBuffer(GL_TEXTURE_BUFFER, result.color_buffer);
-
-    // Create and bind the path texture
     glGenTextures(1, &result.color_texture);
     glBindTexture(GL_TEXTURE_BUFFER, result.color_texture);
-
-    // Attach the buffer object to the texture buffer
-    glTexBuffer(GL_TEXTURE_BUFFER, GL_R32F, result.color_buffer);
-
-    // Unbind the buffer object and the texture buffer
-    glBindBuffer(GL_TEXTURE_BUFFER, 0);
-    glBindTexture(GL_TEXTURE_BUFFER, 0);
+    glTexBuffer(GL_TEXTURE_BUFFER, GL_R8UI, result.color_buffer);
 
     //VISIBLE SEGMENTS BUFFER
-   // Create a buffer object and bind it to the texture buffer
     glGenBuffers(1, &result.visible_segments_buffer);
     glBindBuffer(GL_TEXTURE_BUFFER, result.visible_segments_buffer);
-
-    // Create and bind the path texture
     glGenTextures(1, &result.visible_segments_texture);
     glBindTexture(GL_TEXTURE_BUFFER, result.visible_segments_texture);
-
-    // Attach the buffer object to the texture buffer
     glTexBuffer(GL_TEXTURE_BUFFER, GL_R32UI, result.visible_segments_buffer);
 
     // Unbind the buffer object and the texture buffer
@@ -626,6 +1787,414 @@ BufferedPath bufferExtrusionPaths(const std::vector<PathPoint>& path_points) {
     return result;
 }
 
+// Height, width and turn angle of point i, the start of the segment i -> i + 1. Travels are drawn thin, where they are
+// drawn at all, and the angle is the one between the drawn segments ending and starting at the point.
+static glm::vec3 point_height_width_angle(const PathStore &columns, size_t i)
+{
+    auto            drawn     = [&](size_t j) { return j + 1 < columns.count && extract_type_from_flags(columns.flags[j]) != 8; };
+    const glm::vec3 prev_line = i > 0 && drawn(i - 1) ? columns.position[i] - columns.position[i - 1] : glm::vec3(0);
+    const glm::vec3 this_line = drawn(i) ? columns.position[i + 1] - columns.position[i] : glm::vec3(0);
+    const bool      travel    = extract_type_from_flags(columns.flags[i]) == 8;
+    const float     angle     = atan2(prev_line.x * this_line.y - prev_line.y * this_line.x, glm::dot(prev_line, this_line));
+    return {travel ? 0.1f : columns.height[i], travel ? 0.1f : columns.width[i], angle};
+}
+
+// Calls function(segment, voxels, count) with every valid segment of [first, end) and the voxels it crosses, the
+// segments walked a batch at a time
+template<typename Function>
+static void for_each_segment_voxels(const BufferedPath &path, Span<const glm::vec3> position, size_t first, size_t end, Function &&function)
+{
+    constexpr size_t        Batch_Segments = 4096;
+    std::vector<size_t>     segments;
+    std::vector<uint32_t>   counts;
+    std::vector<glm::ivec3> voxels;
+    for (size_t batch = first; batch < end; batch += Batch_Segments) {
+        segments.clear();
+        for (size_t i = batch; i < std::min(end, batch + Batch_Segments); ++i)
+            if (path.valid_lines_bitset[i])
+                segments.push_back(i);
+        counts.resize(segments.size());
+        voxels.clear();
+        walk_segments(position.data(), segments.data(), segments.size(), voxels, counts.data());
+        const glm::ivec3 *voxel = voxels.data();
+        for (size_t s = 0; s < segments.size(); voxel += counts[s], ++s) function(segments[s], voxel, size_t(counts[s]));
+    }
+}
+
+// Indexes the valid segments [first, end), at most Level_Segments of them, in parallel. Every thread walks a part of the
+// segments and keeps every voxel they cross as a key: the Morton code of the voxel from the smallest voxel of the level,
+// above the offset of the segment. Sorted, the keys give the voxels in Morton order and the segments of every voxel in
+// increasing order. The boxes crossed for the first time get their ids in that order, so boxes with close ids are close
+// in the scene. Returns false, indexing nothing, when the voxels of the level do not fit in the keys.
+static bool index_level_sorted(BufferedPath &path, Span<const glm::vec3> position, size_t first, size_t end)
+{
+    const size_t        parts_count = std::clamp<size_t>((end - first) / 4096, 1, std::max(1u, std::thread::hardware_concurrency()));
+    std::vector<size_t> parts(parts_count);
+    std::iota(parts.begin(), parts.end(), 0);
+    auto part_begin = [&](size_t p) { return first + (end - first) * p / parts_count; };
+
+    // the voxels of the segment ends bound the voxels of the level, but for a voxel the walks may step past them
+    std::vector<glm::ivec3> part_min(parts_count, glm::ivec3(std::numeric_limits<int>::max()));
+    std::vector<glm::ivec3> part_max(parts_count, glm::ivec3(std::numeric_limits<int>::min()));
+    std::for_each(std::execution::par, parts.begin(), parts.end(), [&](size_t p) {
+        for (size_t i = part_begin(p); i < part_begin(p + 1); ++i) {
+            if (!path.valid_lines_bitset[i])
+                continue;
+            for (const glm::ivec3 &voxel : {voxel_coords(position[i]), voxel_coords(position[i + 1])}) {
+                part_min[p] = glm::min(part_min[p], voxel);
+                part_max[p] = glm::max(part_max[p], voxel);
+            }
+        }
+    });
+    glm::ivec3 min_voxel = part_min[0], max_voxel = part_max[0];
+    for (size_t p = 1; p < parts_count; ++p) {
+        min_voxel = glm::min(min_voxel, part_min[p]);
+        max_voxel = glm::max(max_voxel, part_max[p]);
+    }
+    if (min_voxel.x > max_voxel.x)
+        return true;
+    int64_t extent = 0;
+    for (int axis = 0; axis < 3; ++axis) extent = std::max(extent, int64_t(max_voxel[axis]) - int64_t(min_voxel[axis]) + 2);
+    int axis_bits = 0, offset_bits = 1;
+    while (axis_bits < 64 && (extent >> axis_bits) != 0) ++axis_bits;
+    while ((uint64_t(end - first - 1) >> offset_bits) != 0) ++offset_bits;
+    if (axis_bits > 20 || 3 * axis_bits + offset_bits > 64)
+        return false;
+    const glm::ivec3 origin = min_voxel - 1;
+
+    std::vector<std::vector<uint64_t>> part_keys(parts_count);
+    std::atomic<bool>                  outside{false};
+    std::for_each(std::execution::par, parts.begin(), parts.end(), [&](size_t p) {
+        part_keys[p].reserve(4 * (part_begin(p + 1) - part_begin(p)));
+        for_each_segment_voxels(path, position, part_begin(p), part_begin(p + 1), [&](size_t i, const glm::ivec3 *voxels, size_t count) {
+            for (size_t v = 0; v < count; ++v) {
+                const glm::ivec3 voxel = voxels[v] - origin;
+                if (glm::any(glm::lessThan(voxel, glm::ivec3(0))) || glm::any(glm::greaterThanEqual(voxel, glm::ivec3(1 << axis_bits))))
+                    outside = true;
+                part_keys[p].push_back(morton_code(glm::uvec3(voxel)) << offset_bits | (i - first));
+            }
+        });
+    });
+    if (outside)
+        return false;
+    // the keys of every part, and the parts, follow the segments already
+    std::vector<uint64_t> keys = radix_sort(part_keys, offset_bits, 3 * axis_bits);
+    keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+    size_t voxels = 0;
+    for (size_t k = 0; k < keys.size(); ++k) voxels += k == 0 || keys[k] >> offset_bits != keys[k - 1] >> offset_bits;
+
+    // a row for every voxel, in the order of their boxes
+    struct Row
+    {
+        uint32_t box;
+        size_t   begin, end;
+    };
+    std::vector<Row> rows;
+    rows.reserve(voxels);
+    for (size_t k = 0; k < keys.size(); ++k) {
+        const uint64_t code = keys[k] >> offset_bits;
+        if (k > 0 && code == keys[k - 1] >> offset_bits) {
+            rows.back().end = k + 1;
+            continue;
+        }
+        const glm::ivec3 coords = origin + glm::ivec3(morton_coords(code));
+        auto [it, inserted]     = path.visibility_box_ids.try_emplace(coords, uint32_t(path.visibility_box_coords.size()));
+        if (inserted)
+            path.visibility_box_coords.push_back(coords);
+        rows.push_back({it->second, k, k + 1});
+    }
+    auto by_box = [](const Row &a, const Row &b) { return a.box < b.box; };
+    if (!std::is_sorted(rows.begin(), rows.end(), by_box))
+        std::sort(rows.begin(), rows.end(), by_box);
+
+    BoxSegmentIndex::Level level;
+    level.first_segment = first;
+    level.end_segment   = end;
+    level.boxes.resize(rows.size());
+    level.row_starts.resize(rows.size() + 1);
+    for (size_t r = 0; r < rows.size(); ++r) {
+        level.boxes[r]          = rows[r].box;
+        level.row_starts[r + 1] = level.row_starts[r] + (rows[r].end - rows[r].begin);
+    }
+    std::vector<uint32_t> segments(keys.size());
+    const uint64_t        offset_mask = (uint64_t(1) << offset_bits) - 1;
+    std::for_each(std::execution::par, parts.begin(), parts.end(), [&](size_t p) {
+        for (size_t r = rows.size() * p / parts_count; r < rows.size() * (p + 1) / parts_count; ++r)
+            for (size_t k = rows[r].begin, m = level.row_starts[r]; k < rows[r].end; ++k, ++m) segments[m] = uint32_t(keys[k] & offset_mask);
+    });
+    keys = {};
+    BoxSegmentIndex::set_runs(level, segments);
+    BoxSegmentIndex::choose_rows(level);
+    path.visibility_box_segments.append(std::move(level));
+    return true;
+}
+
+// Adds the valid segments [first, end) to the visibility boxes they cross, the boxes crossed for the first time get the
+// next ids. The levels are indexed by index_level_sorted on several hardware threads; on a single one, and for the
+// levels spanning too many voxels for its keys, one segment after the other, which is less work than sorting.
+static void indexVisibilityBoxes(BufferedPath &path, Span<const glm::vec3> position, size_t first, size_t end)
+{
+    const bool            parallel = std::thread::hardware_concurrency() > 1;
+    std::vector<uint32_t> entries;
+    for (size_t level = first; level < end; level += BoxSegmentIndex::Level_Segments) {
+        const size_t level_end = std::min(end, level + BoxSegmentIndex::Level_Segments);
+        if (parallel && index_level_sorted(path, position, level, level_end))
+            continue;
+        entries.clear();
+        for_each_segment_voxels(path, position, level, level_end, [&](size_t i, const glm::ivec3 *voxels, size_t count) {
+            entries.push_back(BoxSegmentIndex::Segment_Entry | uint32_t(i - level));
+            for (size_t v = 0; v < count; ++v) {
+                auto [it, inserted] = path.visibility_box_ids.try_emplace(voxels[v], uint32_t(path.visibility_box_coords.size()));
+                if (inserted)
+                    path.visibility_box_coords.push_back(voxels[v]);
+                entries.push_back(it->second);
+            }
+        });
+        path.visibility_box_segments.append(entries, level, level_end);
+    }
+}
+
+// Predicted index of the drawn segments for a voxel size
+struct VoxelCost
+{
+    float  voxel_size{0.0f};
+    double boxes{0.0}, memberships{0.0};
+    size_t sampled_segments{0};
+
+    double segments_per_voxel() const { return boxes > 0.0 ? memberships / boxes : 0.0; }
+};
+
+// Sample of the drawn segments of a path to tune the voxel size on, added batch after batch in the order of the points.
+// About Sample_Segments of the expected points start a picked segment, the segments are picked by a hash of their
+// index as a regular stride would follow the patterns of the infill. When the points added are only a prefix of the path,
+// scale is the size of the path relative to the prefix, the predictions are extrapolated by it.
+class VoxelSample
+{
+public:
+    static constexpr size_t Sample_Segments = size_t(1) << 15;
+
+    explicit VoxelSample(size_t expected_points = 0)
+        : m_threshold(expected_points <= Sample_Segments ? UINT64_MAX : uint64_t(double(UINT64_MAX) * double(Sample_Segments) / double(expected_points)))
+    {}
+
+    // Sample of all the points of the columns
+    explicit VoxelSample(const PathStore &columns) : VoxelSample(columns.count) { add(columns.view<Column::Position>(), columns.view<Column::Flags>()); }
+
+    void add(Span<const glm::vec3> position, Span<const unsigned int> flags)
+    {
+        add(position.size(), [&](size_t i) { return std::make_pair(position[i], flags[i]); });
+    }
+
+    void add(Span<const PathPoint> points)
+    {
+        add(points.size(), [&](size_t i) { return std::make_pair(points[i].position, points[i].flags); });
+    }
+
+    // The next point added starts a new path, no segment joins it to the last one added
+    void break_path() { m_last_drawn = false; }
+
+    // The two ends of every picked segment, one after the other
+    const std::vector<glm::vec3> &ends() const { return m_ends; }
+    size_t                        points() const { return m_points; }
+    size_t                        drawn_segments() const { return m_drawn; }
+    glm::vec3                     size() const { return m_points > 0 ? m_max - m_min : glm::vec3(0.0f); }
+
+    double scale{1.0};
+
+private:
+    template <typename Point> void add(size_t count, Point &&point)
+    {
+        for (size_t i = 0; i < count; ++i, ++m_points) {
+            const auto [position, flags] = point(i);
+            if (m_points > 0 && m_last_drawn) {
+                ++m_drawn;
+                if (picked(m_points - 1)) {
+                    m_ends.push_back(m_last);
+                    m_ends.push_back(position);
+                }
+            }
+            m_min        = glm::min(m_min, position);
+            m_max        = glm::max(m_max, position);
+            m_last       = position;
+            m_last_drawn = extract_type_from_flags(flags) != 8;
+        }
+    }
+
+    bool picked(uint64_t i) const
+    {
+        i = (i ^ (i >> 30)) * 0xbf58476d1ce4e5b9ull;
+        i = (i ^ (i >> 27)) * 0x94d049bb133111ebull;
+        return (i ^ (i >> 31)) <= m_threshold;
+    }
+
+    uint64_t               m_threshold;
+    std::vector<glm::vec3> m_ends;
+    size_t                 m_points{0}, m_drawn{0};
+    glm::vec3              m_min{FLT_MAX}, m_max{-FLT_MAX}, m_last{0.0f};
+    bool                   m_last_drawn{false};
+};
+
+// Predicts the index of the drawn segments for the voxel size from the picked ones of the sample, one of every
+// segments_per_sample. The memberships of the sample are counted exactly and scaled. The boxes are the distinct voxels of
+// the sample plus an estimate of the ones it misses, bounded by the boxes of the box of the sampled points. Both are
+// extrapolated by the scale of the sample.
+static VoxelCost predict_voxel_cost(const VoxelSample &sample, const std::vector<size_t> &segments, double segments_per_sample, float voxel_size)
+{
+    std::vector<glm::ivec3> voxels;
+    std::vector<uint32_t>   counts(segments.size());
+    walk_segments(sample.ends().data(), segments.data(), segments.size(), voxels, counts.data(), voxel_size);
+
+    VoxelCost cost;
+    cost.voxel_size       = voxel_size;
+    cost.sampled_segments = segments.size();
+    cost.memberships      = double(voxels.size()) * segments_per_sample * sample.scale;
+    std::sort(voxels.begin(), voxels.end(), [](const glm::ivec3 &a, const glm::ivec3 &b) { return std::tie(a.x, a.y, a.z) < std::tie(b.x, b.y, b.z); });
+    // the boxes the sample missed are estimated from the ones it met once and twice, by the bias-corrected Chao1
+    // estimator of the species of a population
+    double distinct = 0.0, once = 0.0, twice = 0.0;
+    for (size_t v = 0, next = 0; v < voxels.size(); v = next) {
+        while (next < voxels.size() && voxels[next] == voxels[v]) ++next;
+        distinct += 1.0;
+        once += next - v == 1;
+        twice += next - v == 2;
+    }
+    cost.boxes = segments_per_sample <= 1.0 ? distinct : distinct + once * (once - 1.0) / (2.0 * (twice + 1.0));
+    const glm::dvec3 scene_boxes = glm::floor(glm::dvec3(sample.size()) / double(voxel_size)) + 2.0;
+    cost.boxes                   = std::min(cost.boxes, scene_boxes.x * scene_boxes.y * scene_boxes.z) * sample.scale;
+    return cost;
+}
+
+// Voxel size of the visibility boxes for the drawn segments of the sampled path: the smallest of the Voxel_Sizes sizes
+// from Min_Voxel_Size on by factors of sqrt 2 whose boxes hold config::target_segments_per_voxel segments on average and
+// number at most config::max_visibility_boxes, the largest when none does. Finer boxes cull more segments, but a box is
+// drawn in the visibility pass for every one of them. Both costs decrease with the voxel size, the sizes are bisected.
+static VoxelCost tune_voxel_size(const VoxelSample &sample)
+{
+    constexpr float Min_Voxel_Size = 0.25f;
+    constexpr int   Voxel_Sizes    = 15; // up to 32 mm
+
+    std::vector<size_t> segments(sample.ends().size() / 2);
+    for (size_t s = 0; s < segments.size(); ++s) segments[s] = 2 * s;
+    if (segments.empty())
+        return {config::voxel_size};
+    const double segments_per_sample = double(sample.drawn_segments()) / double(segments.size());
+
+    auto voxel_size = [](int s) { return Min_Voxel_Size * std::pow(2.0f, 0.5f * float(s)); };
+    auto cost       = [&](int s) { return predict_voxel_cost(sample, segments, segments_per_sample, voxel_size(s)); };
+    auto fits       = [](const VoxelCost &cost) {
+        return cost.segments_per_voxel() >= double(config::target_segments_per_voxel) && cost.boxes <= double(config::max_visibility_boxes);
+    };
+    int       low = 0, high = Voxel_Sizes - 1;
+    VoxelCost chosen = cost(high);
+    while (low < high) {
+        const int       middle      = (low + high) / 2;
+        const VoxelCost middle_cost = cost(middle);
+        if (fits(middle_cost)) {
+            high   = middle;
+            chosen = middle_cost;
+        } else {
+            low = middle + 1;
+        }
+    }
+    return chosen;
+}
+
+// Appends the points of the columns past the ones already in the path. The work, the GPU uploads included, is proportional
+// to the appended points: the buffers and the bitsets grow geometrically and only the voxels touched by the new segments are
+// updated. The previously last point is processed again, as its segment is only known now. The filtering work must not run
+// while the path is extended. Only the core columns are read. When given, keep_height_width_angle receives a copy of the
+// uploaded height, width and angle of every point.
+void appendExtrusionPaths(BufferedPath &path, const PathStore &columns, std::vector<glm::vec3> *keep_height_width_angle = nullptr)
+{
+    const size_t total = path.total_points_count;
+    const size_t count = columns.count;
+    if (count <= total)
+        return;
+    const size_t first = total > 0 ? total - 1 : 0;
+
+    const Span<const glm::vec3>    position  = columns.view<Column::Position>();
+    const Span<const unsigned int> flags     = columns.view<Column::Flags>();
+    auto                           is_travel = [&](size_t i) { return extract_type_from_flags(flags[i]) == 8; };
+
+    std::vector<glm::vec3> height_width_angle;
+    height_width_angle.reserve(count - first);
+
+    path.valid_lines_bitset.grow(count);
+    path.visible_lines_bitset.grow(count);
+
+    const size_t boxes_count = path.visibility_box_coords.size();
+
+    for (size_t i = first; i < count; i++) {
+        bool      this_line_valid = i + 1 < count && position[i + 1] != position[i];
+
+        //THIS disables travel moves completely
+        this_line_valid = i + 1 < count && !is_travel(i);
+
+        if (this_line_valid) {
+            // there is a valid path between point i and i+1.
+            path.valid_lines_bitset.set(i);
+        } else {
+            // the connection is invalid, there should be no line rendered, ever
+            path.valid_lines_bitset.reset(i);
+        }
+
+        height_width_angle.push_back(point_height_width_angle(columns, i));
+    }
+
+    indexVisibilityBoxes(path, position, first, count - 1);
+    if (path.visibility_box_coords.size() > boxes_count)
+        uploadVisibilityBoxes(path);
+
+    glBindVertexArray(gcodeVAO);
+    upload_positions(path, position, total);
+    upload_height_width_angle(path, height_width_angle, first);
+    glBindVertexArray(0);
+
+    if (keep_height_width_angle != nullptr) {
+        keep_height_width_angle->resize(first);
+        keep_height_width_angle->insert(keep_height_width_angle->end(), height_width_angle.begin(), height_width_angle.end());
+    }
+
+    path.total_points_count = count;
+}
+
+// Whether the segments can be drawn from the SegmentRecord storage buffer, which needs OpenGL 4.3
+static bool segment_records_supported() { return GLAD_GL_VERSION_4_3 != 0; }
+
+// Uploads the records of the segments not on the GPU yet. The last record uploaded before is built again, the angle at
+// its end point changes with the points appended after it.
+void updateSegmentRecords(BufferedPath &path, const PathStore &columns)
+{
+    const size_t count = columns.count > 0 ? columns.count - 1 : 0;
+    if (count <= path.segment_records_count)
+        return;
+    const size_t first = path.segment_records_count > 0 ? path.segment_records_count - 1 : 0;
+
+    std::vector<SegmentRecord> records(count - first);
+    std::vector<size_t>        indices(records.size());
+    std::iota(indices.begin(), indices.end(), first);
+    std::for_each(std::execution::par, indices.begin(), indices.end(), [&](size_t i) {
+        records[i - first] = {columns.position[i], pack_height_width_angle(point_height_width_angle(columns, i)), columns.position[i + 1],
+                              pack_height_width_angle(point_height_width_angle(columns, i + 1))};
+    });
+
+    if (count > path.segment_records_capacity) {
+        const size_t kept             = std::min(path.segment_records_capacity, first);
+        path.segment_records_capacity = grown_capacity(path.segment_records_capacity, count);
+        grow_buffer(path.segment_records_buffer, kept * sizeof(SegmentRecord), path.segment_records_capacity * sizeof(SegmentRecord), GL_STATIC_DRAW);
+    }
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, path.segment_records_buffer);
+    glBufferSubData(GL_SHADER_STORAGE_BUFFER, first * sizeof(SegmentRecord), records.size() * sizeof(SegmentRecord), records.data());
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    path.segment_records_count = count;
+}
+
+BufferedPath bufferExtrusionPaths(const PathStore &columns, std::vector<glm::vec3> *keep_height_width_angle = nullptr) {
+    BufferedPath result = createBufferedPath();
+    appendExtrusionPaths(result, columns, keep_height_width_angle);
+    return result;
+}
+
 BufferedPath generateTestingPathPoints()
 {
     std::vector<PathPoint>                pathPoints;
@@ -644,7 +2213,7 @@ BufferedPath generateTestingPathPoints()
         pathPoints.push_back(point);
     }
 
-   return bufferExtrusionPaths(pathPoints);
+   return bufferExtrusionPaths(to_columns(pathPoints));
 }
 
 void recreateVisibilityBufferOnResolutionChange()
@@ -698,6 +2267,51 @@ void init()
 
     glBindVertexArray(0);
 
+    glGenVertexArrays(1, &gcodeIndexedVAO);
+    glBindVertexArray(gcodeIndexedVAO);
+    glGenBuffers(1, &cornersBuffer);
+    glBindBuffer(GL_ARRAY_BUFFER, cornersBuffer);
+    glBufferData(GL_ARRAY_BUFFER, corner_data_size * sizeof(int), corner_data, GL_STATIC_DRAW);
+    glEnableVertexAttribArray(vid_loc);
+    glVertexAttribIPointer(vid_loc, 1, GL_INT, sizeof(int), (void *)0);
+    glGenBuffers(1, &cornerIndicesBuffer);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, cornerIndicesBuffer);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, vertex_data_size * sizeof(int), vertex_data, GL_STATIC_DRAW);
+    checkGl();
+
+    glBindVertexArray(0);
+
+    // the palette of the color buffer never changes
+    const std::array<std::array<uint8_t, 4>, Palette_Size> palette = color_palette();
+    glGenBuffers(1, &paletteBuffer);
+    glBindBuffer(GL_TEXTURE_BUFFER, paletteBuffer);
+    glBufferData(GL_TEXTURE_BUFFER, sizeof(palette), palette.data(), GL_STATIC_DRAW);
+    glGenTextures(1, &paletteTexture);
+    glBindTexture(GL_TEXTURE_BUFFER, paletteTexture);
+    glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA8, paletteBuffer);
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+    glBindTexture(GL_TEXTURE_BUFFER, 0);
+    checkGl();
+
+    // quantized positions take 3 texels per point, the chunks stay multiples of Position_Chunk_Points
+    GLint        max_texels       = 0;
+    const size_t texels_per_point = config::quantize_positions ? 3 : 1;
+    glGetIntegerv(GL_MAX_TEXTURE_BUFFER_SIZE, &max_texels);
+    while (max_texels > 0 && (draw_chunk_segments + 1) * texels_per_point > size_t(max_texels) && draw_chunk_segments > Position_Chunk_Points)
+        draw_chunk_segments /= 2;
+    // a chunk of segment records is bound as one shader storage block
+    if (segment_records_supported()) {
+        GLint64 max_block_size = 0;
+        glGetInteger64v(GL_MAX_SHADER_STORAGE_BLOCK_SIZE, &max_block_size);
+        while (max_block_size > 0 && draw_chunk_segments * sizeof(SegmentRecord) > size_t(max_block_size) && draw_chunk_segments > Position_Chunk_Points)
+            draw_chunk_segments /= 2;
+    }
+    // ranges need OpenGL 4.3 or ARB_texture_buffer_range, without them only the first chunk can be drawn
+    if (glTexBufferRange != nullptr)
+        glGetIntegerv(GL_TEXTURE_BUFFER_OFFSET_ALIGNMENT, &texture_buffer_offset_alignment);
+    texture_buffer_offset_alignment = std::max(texture_buffer_offset_alignment, GLint(1));
+    checkGl();
+
     glGenFramebuffers(1, &visibilityFramebuffer);
     glGenTextures(1, &instanceIdsTexture);
   	glGenTextures(1, &depthTexture);
@@ -5,34 +5,126 @@ uniform vec3 camera_position;
 uniform int instance_base;
 
 uniform samplerBuffer positionsTex;
+// quantized positions: 3 offsets per point, in steps from the origin of its chunk of 64 points
+uniform bool quantized_positions;
+uniform usamplerBuffer quantizedPositionsTex;
+uniform samplerBuffer positionChunksTex;
 uniform samplerBuffer heightWidthAngleTex;
-uniform samplerBuffer colorsTex;
+// packed height, width and angle: 11 bit unorm height and width up to 4 mm, 10 bit angle with 0 at 511
+uniform bool packed_height_width_angle;
+uniform usamplerBuffer packedHeightWidthAngleTex;
+// palette index of every point, the palette holds 256 RGBA colors
+uniform usamplerBuffer colorsTex;
+uniform samplerBuffer paletteTex;
 uniform isamplerBuffer segmentIndexTex;
+#ifdef SEGMENT_RECORDS
+// the two points of every segment in one record: the positions and the packed heights, widths and angles
+struct SegmentRecord
+{
+    vec3 position_a;
+    uint height_width_angle_a;
+    vec3 position_b;
+    uint height_width_angle_b;
+};
+layout(std430, binding = 5) readonly buffer SegmentRecords
+{
+    SegmentRecord segment_records[];
+};
+#endif
+// shader colors: the points are colored from their flags and the column of the visualization type, -1 for the error
+// color, through the palettes and the range of the column, instead of colorsTex
+uniform bool shader_colors;
+uniform int visualization_type;
+uniform vec2 value_range;
+uniform usamplerBuffer flagsTex;
+uniform samplerBuffer colorValuesTex;
+uniform usamplerBuffer colorIdsTex;
+uniform vec3 extrusion_role_colors[15];
+uniform vec3 travel_colors[3];
+uniform vec3 range_colors[11];
+uniform vec3 tools_colors[5];
+
+// Range::get_color_at
+vec3 range_color(float value)
+{
+    float step = (value_range.y - value_range.x) / 10.0;
+    float t = step > 0.0 ? (clamp(value, value_range.x, value_range.y) - value_range.x) / step : 0.0;
+    int low = clamp(int(t), 0, 10);
+    int high = min(low + 1, 10);
+    return mix(range_colors[low], range_colors[high], clamp(t - float(low), 0.0, 1.0));
+}
+
+// The colors of computePathColors with their 8 bits per channel, the range colors exact instead of palette levels
+vec3 point_color(int id)
+{
+    if (!shader_colors)
+        return texelFetch(paletteTex, int(texelFetch(colorsTex, id).r)).rgb;
+    uint flags = texelFetch(flagsTex, id).r;
+    int role = int(flags & 0xFFu);
+    bool is_travel = ((flags >> 8) & 0xFFu) == 8u;
+    vec3 color;
+    switch (visualization_type) {
+    case 0: color = is_travel ? travel_colors[role] : extrusion_role_colors[role]; break;
+    case 1: case 2: case 4: case 5: case 6:
+        color = is_travel ? travel_colors[role] : range_color(texelFetch(colorValuesTex, id).r);
+        break;
+    // speed, travels included
+    case 3: color = range_color(texelFetch(colorValuesTex, id).r); break;
+    case 9: case 10: color = tools_colors[texelFetch(colorIdsTex, id).r % 5u]; break;
+    default: color = vec3(0.5); break;
+    }
+    return floor(255.0 * color) / 255.0;
+}
+
+vec3 fetch_position(int id)
+{
+    if (!quantized_positions)
+        return texelFetch(positionsTex, id).xyz;
+    vec4 chunk = texelFetch(positionChunksTex, id >> 6);
+    uvec3 offsets = uvec3(texelFetch(quantizedPositionsTex, 3 * id).r, texelFetch(quantizedPositionsTex, 3 * id + 1).r,
+                          texelFetch(quantizedPositionsTex, 3 * id + 2).r);
+    return chunk.xyz + chunk.w * vec3(offsets);
+}
+
+vec3 unpack_height_width_angle(uint bits)
+{
+    float step = 4.0 / 2047.0;
+    return vec3(float(bits & 0x7FFu) * step, float((bits >> 11) & 0x7FFu) * step, (float(bits >> 22) - 511.0) * (3.14159265 / 511.0));
+}
 
-vec3 decode_color(float color)
+vec3 fetch_height_width_angle(int id)
 {
-	int c = int(round(color));
-	int r = (c >> 16) & 0xFF;
-	int g = (c >> 8) & 0xFF;
-	int b = (c >> 0) & 0xFF;
-	float f = 1.0 / 255.0f;
-    return f * vec3(r, g, b);
+    if (!packed_height_width_angle)
+        return texelFetch(heightWidthAngleTex, id).xyz;
+    return unpack_height_width_angle(texelFetch(packedHeightWidthAngleTex, id).r);
 }
 
 in int vertex_id;
 
 out vec3 color;
 
+// tools/validate_packing.cpp copies the geometry of main() to check the packed inputs, a change here must be made there
+// too
 void main() {
     vec3 UP = vec3(0,0,1);
 
-    // Retrieve the instance ID
-    int id_position = gl_InstanceID;
+    // Retrieve the instance ID, the segments of a draw chunk start at instance_base
+    int id_position = instance_base + gl_InstanceID;
     int id_a = int(texelFetch(segmentIndexTex, int(id_position)).r);
     int id_b = id_a + 1;
 
-    vec3 pos_a = texelFetch(positionsTex, id_a).xyz;
-    vec3 pos_b = texelFetch(positionsTex, id_b).xyz;
+#ifdef SEGMENT_RECORDS
+    SegmentRecord record = segment_records[id_a];
+    vec3 pos_a = record.position_a;
+    vec3 pos_b = record.position_b;
+    vec3 height_width_angle_a = unpack_height_width_angle(record.height_width_angle_a);
+    vec3 height_width_angle_b = unpack_height_width_angle(record.height_width_angle_b);
+#else
+    vec3 pos_a = fetch_position(id_a);
+    vec3 pos_b = fetch_position(id_b);
+    vec3 height_width_angle_a = fetch_height_width_angle(id_a);
+    vec3 height_width_angle_b = fetch_height_width_angle(id_b);
+#endif
 
 	vec3 line = pos_b - pos_a;
     vec3 view_a = pos_a - camera_position;
@@ -93,7 +185,7 @@ void main() {
     int id_final = vertex_id < 4 ? id_close : id_far;
 
     vec3 camera_view_dir = normalize((id_close == id_a ? pos_a : pos_b) - camera_position);
-    vec3 close_height_width_angle = texelFetch(heightWidthAngleTex, id_close).xyz;
+    vec3 close_height_width_angle = id_close == id_a ? height_width_angle_a : height_width_angle_b;
 
     vec3 diagonal_dir_border = normalize(close_height_width_angle.x * up_dir + close_height_width_angle.y * right_dir);
     bool is_vertical_view = abs(dot(camera_view_dir, up_dir)) / abs(dot(diagonal_dir_border, up_dir)) >
@@ -102,7 +194,7 @@ void main() {
 
     vec2 signs = horizontal_vertical_view_signs_array[vertex_id + 8*int(is_vertical_view)];
 
-    vec3 final_height_width_angle = texelFetch(heightWidthAngleTex, id_final).xyz;
+    vec3 final_height_width_angle = id_final == id_a ? height_width_angle_a : height_width_angle_b;
     float half_height = 0.5 * final_height_width_angle.x;
     float half_width = 0.5 * final_height_width_angle.y;
 
@@ -119,7 +211,7 @@ void main() {
     }
 
     //LIGHT
-    vec3 color_base = decode_color(texelFetch(colorsTex, id_final).x);
+    vec3 color_base = point_color(id_final);
     vec3 normal = normalize(pos - segment_pos);
 
     vec3 light_top_dir = vec3(-0.4574957, 0.4574957, 0.7624929);
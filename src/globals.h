@@ -40,6 +40,24 @@ size_t camera_prediction_frames = 4;
 size_t visiblity_multiframes_count = 10;
 
 float voxel_size = 2;
+// the voxel size is tuned to the scene when it is loaded, unless --voxel-size=mm sets it: the smallest size whose
+// boxes hold target_segments_per_voxel segments on average and number at most max_visibility_boxes
+bool   auto_voxel_size           = true;
+float  target_segments_per_voxel = 32;
+size_t max_visibility_boxes      = size_t(1) << 20;
+
+// positions are uploaded as 16 bit offsets in chunks instead of floats, with the given step in mm
+bool  quantize_positions = false;
+float position_precision = 0.001f;
+// heights, widths and angles are uploaded packed in 32 bits instead of 3 floats
+bool  pack_height_width_angle = false;
+// the vertex shader colors the points from the raw attribute columns instead of a color buffer computed on the CPU
+bool  shader_colors = false;
+// the segments are drawn from records in a shader storage buffer instead of the point textures, with OpenGL 4.3
+bool  segment_records = false;
+// the segments are drawn indexed, the vertex shader runs for their 8 corners instead of the 24 vertices of their triangles;
+// off until --draw-benchmark has measured it on a GPU
+bool  indexed_segments = false;
 }
 
 class SequentialRange
@@ -0,0 +1,289 @@
+#ifndef LIVE_H_
+#define LIVE_H_
+
+#include "gcode.h"
+#include "span.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <new>
+#include <string>
+#include <thread>
+#include <vector>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// Live ingestion of PathPoints produced by another process (a slicer still generating the G-code).
+//
+// The viewer creates a named shared memory region holding a single producer / single consumer ring of PathPoint
+// records, the producer opens it by name and appends batches. Both sides only ever advance their own counter:
+// write_index counts the records written, read_index the records consumed, the records live at index % capacity.
+// A producer blocks while the ring is full and sets producer_state to Finished after its last batch.
+namespace live {
+
+static const char           Magic[4]         = {'G', 'C', 'L', 'V'};
+static const uint32_t       Version          = 1;
+static const size_t         Default_Capacity = size_t(1) << 20;
+static const char *const    Default_Name     = "gcdeview";
+
+enum ProducerState : uint32_t { Waiting = 0, Producing = 1, Finished = 2 };
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "the ring counters are shared between processes");
+
+// Beginning of the shared region, the counters written by different sides live on different cache lines
+struct RingHeader
+{
+    char     magic[4];
+    uint32_t version;
+    uint32_t record_size;
+    uint32_t reserved;
+    uint64_t capacity;
+
+    alignas(64) std::atomic<uint64_t> write_index;
+    alignas(64) std::atomic<uint64_t> read_index;
+    alignas(64) std::atomic<uint32_t> producer_state;
+};
+
+static const size_t Records_Offset = (sizeof(RingHeader) + 63) / 64 * 64;
+
+static size_t region_size(size_t capacity) { return Records_Offset + capacity * sizeof(gcode::PathPoint); }
+
+// Named shared memory region, created by the consumer and opened by the producer
+class SharedMemory
+{
+public:
+    SharedMemory() = default;
+    ~SharedMemory() { close(); }
+
+    SharedMemory(const SharedMemory &)            = delete;
+    SharedMemory &operator=(const SharedMemory &) = delete;
+
+    // Creates a fresh region, an existing one of the same name is replaced
+    bool create(const std::string &name, size_t size)
+    {
+        close();
+#if defined(_WIN32)
+        m_mapping = CreateFileMappingA(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE, DWORD(uint64_t(size) >> 32), DWORD(size), name.c_str());
+        if (m_mapping == nullptr)
+            return false;
+        return map(size);
+#else
+        m_name = "/" + name;
+        shm_unlink(m_name.c_str());
+        m_fd = shm_open(m_name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+        if (m_fd < 0 || ftruncate(m_fd, off_t(size)) != 0) {
+            close();
+            return false;
+        }
+        m_owner = true;
+        return map(size);
+#endif
+    }
+
+    // Opens a region created by another process
+    bool open(const std::string &name)
+    {
+        close();
+#if defined(_WIN32)
+        m_mapping = OpenFileMappingA(FILE_MAP_ALL_ACCESS, FALSE, name.c_str());
+        if (m_mapping == nullptr)
+            return false;
+        MEMORY_BASIC_INFORMATION info;
+        void                    *view = MapViewOfFile(m_mapping, FILE_MAP_ALL_ACCESS, 0, 0, 0);
+        if (view == nullptr || VirtualQuery(view, &info, sizeof(info)) == 0) {
+            close();
+            return false;
+        }
+        m_data = static_cast<char *>(view);
+        m_size = info.RegionSize;
+        return true;
+#else
+        m_name = "/" + name;
+        m_fd   = shm_open(m_name.c_str(), O_RDWR, 0600);
+        struct stat st;
+        if (m_fd < 0 || fstat(m_fd, &st) != 0 || st.st_size == 0) {
+            close();
+            return false;
+        }
+        return map(size_t(st.st_size));
+#endif
+    }
+
+    void close()
+    {
+#if defined(_WIN32)
+        if (m_data != nullptr)
+            UnmapViewOfFile(m_data);
+        if (m_mapping != nullptr)
+            CloseHandle(m_mapping);
+        m_mapping = nullptr;
+#else
+        if (m_data != nullptr)
+            munmap(m_data, m_size);
+        if (m_fd >= 0)
+            ::close(m_fd);
+        if (m_owner)
+            shm_unlink(m_name.c_str());
+        m_fd    = -1;
+        m_owner = false;
+#endif
+        m_data = nullptr;
+        m_size = 0;
+    }
+
+    bool   is_open() const { return m_data != nullptr; }
+    char  *data() const { return m_data; }
+    size_t size() const { return m_size; }
+
+private:
+#if defined(_WIN32)
+    bool map(size_t size)
+    {
+        m_data = static_cast<char *>(MapViewOfFile(m_mapping, FILE_MAP_ALL_ACCESS, 0, 0, size));
+        m_size = size;
+        if (m_data == nullptr)
+            close();
+        return m_data != nullptr;
+    }
+
+    HANDLE m_mapping{nullptr};
+#else
+    bool map(size_t size)
+    {
+        void *data = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, m_fd, 0);
+        if (data == MAP_FAILED) {
+            close();
+            return false;
+        }
+        m_data = static_cast<char *>(data);
+        m_size = size;
+        return true;
+    }
+
+    std::string m_name;
+    int         m_fd{-1};
+    bool        m_owner{false};
+#endif
+    char  *m_data{nullptr};
+    size_t m_size{0};
+};
+
+// Consumer side, owned by the viewer
+class RingConsumer
+{
+public:
+    bool create(const std::string &name, size_t capacity = Default_Capacity)
+    {
+        if (!m_memory.create(name, region_size(capacity))) {
+            std::cerr << "Cannot create shared memory " << name << std::endl;
+            return false;
+        }
+        m_header = new (m_memory.data()) RingHeader{};
+        std::memcpy(m_header->magic, Magic, sizeof(Magic));
+        m_header->version     = Version;
+        m_header->record_size = sizeof(gcode::PathPoint);
+        m_header->capacity    = capacity;
+        m_header->write_index.store(0);
+        m_header->read_index.store(0);
+        m_header->producer_state.store(Waiting, std::memory_order_release);
+        return true;
+    }
+
+    // Copies the available records into out and releases their slots, returns the number of records read
+    size_t read(std::vector<gcode::PathPoint> &out, size_t max_count = Default_Capacity)
+    {
+        const uint64_t read_index = m_header->read_index.load(std::memory_order_relaxed);
+        const uint64_t available  = m_header->write_index.load(std::memory_order_acquire) - read_index;
+        const size_t   count      = size_t(std::min<uint64_t>(available, max_count));
+        for (size_t copied = 0; copied < count;) {
+            // at most two contiguous pieces, before and after the wrap around
+            const size_t slot  = size_t((read_index + copied) % m_header->capacity);
+            const size_t piece = std::min(count - copied, size_t(m_header->capacity) - slot);
+            out.insert(out.end(), records() + slot, records() + slot + piece);
+            copied += piece;
+        }
+        m_header->read_index.store(read_index + count, std::memory_order_release);
+        return count;
+    }
+
+    // True once the producer finished and everything it wrote was read
+    bool finished() const
+    {
+        return m_header->producer_state.load(std::memory_order_acquire) == Finished &&
+               m_header->read_index.load(std::memory_order_relaxed) == m_header->write_index.load(std::memory_order_acquire);
+    }
+
+private:
+    const gcode::PathPoint *records() const { return reinterpret_cast<const gcode::PathPoint *>(m_memory.data() + Records_Offset); }
+
+    SharedMemory m_memory;
+    RingHeader  *m_header{nullptr};
+};
+
+// Producer side, used by the process generating the points
+class RingProducer
+{
+public:
+    bool open(const std::string &name)
+    {
+        if (!m_memory.open(name) || m_memory.size() < Records_Offset)
+            return false;
+        m_header = reinterpret_cast<RingHeader *>(m_memory.data());
+        if (std::memcmp(m_header->magic, Magic, sizeof(Magic)) != 0 || m_header->version != Version ||
+            m_header->record_size != sizeof(gcode::PathPoint) || region_size(size_t(m_header->capacity)) > m_memory.size()) {
+            std::cerr << "Shared memory " << name << " is not a compatible PathPoint ring" << std::endl;
+            m_memory.close();
+            return false;
+        }
+        m_header->producer_state.store(Producing, std::memory_order_release);
+        return true;
+    }
+
+    size_t capacity() const { return size_t(m_header->capacity); }
+
+    // Writes the points, waiting for the consumer while the ring is full. Returns the time spent waiting in milliseconds.
+    double write(Span<const gcode::PathPoint> points)
+    {
+        double   waited_ms   = 0.0;
+        uint64_t write_index = m_header->write_index.load(std::memory_order_relaxed);
+        for (size_t written = 0; written < points.size();) {
+            const uint64_t free_slots = m_header->capacity - (write_index - m_header->read_index.load(std::memory_order_acquire));
+            if (free_slots == 0) {
+                const auto start = std::chrono::steady_clock::now();
+                std::this_thread::sleep_for(std::chrono::microseconds(200));
+                waited_ms += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+                continue;
+            }
+            const size_t slot  = size_t(write_index % m_header->capacity);
+            const size_t piece = std::min({points.size() - written, size_t(free_slots), size_t(m_header->capacity) - slot});
+            std::memcpy(records() + slot, points.data() + written, piece * sizeof(gcode::PathPoint));
+            written += piece;
+            write_index += piece;
+            m_header->write_index.store(write_index, std::memory_order_release);
+        }
+        return waited_ms;
+    }
+
+    void finish() { m_header->producer_state.store(Finished, std::memory_order_release); }
+
+private:
+    gcode::PathPoint *records() const { return reinterpret_cast<gcode::PathPoint *>(m_memory.data() + Records_Offset); }
+
+    SharedMemory m_memory;
+    RingHeader  *m_header{nullptr};
+};
+
+} // namespace live
+
+#endif /* LIVE_H_ */
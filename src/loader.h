@@ -0,0 +1,197 @@
+#ifndef LOADER_H_
+#define LOADER_H_
+
+#include "gcode.h"
+#include "span.h"
+
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace loader {
+
+// Read-only memory mapping of a whole file.
+class MappedFile
+{
+public:
+    MappedFile() = default;
+    ~MappedFile() { close(); }
+
+    MappedFile(const MappedFile &)            = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    bool open(const std::string &filename)
+    {
+        close();
+#if defined(_WIN32)
+        m_file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+        if (m_file == INVALID_HANDLE_VALUE)
+            return false;
+        LARGE_INTEGER size;
+        if (!GetFileSizeEx(m_file, &size) || size.QuadPart == 0) {
+            close();
+            return false;
+        }
+        m_mapping = CreateFileMappingA(m_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (m_mapping == nullptr) {
+            close();
+            return false;
+        }
+        m_data = static_cast<const char *>(MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0));
+        if (m_data == nullptr) {
+            close();
+            return false;
+        }
+        m_size = size_t(size.QuadPart);
+#else
+        m_fd = ::open(filename.c_str(), O_RDONLY);
+        if (m_fd < 0)
+            return false;
+        struct stat st;
+        if (fstat(m_fd, &st) != 0 || st.st_size == 0) {
+            close();
+            return false;
+        }
+        void *data = mmap(nullptr, size_t(st.st_size), PROT_READ, MAP_PRIVATE, m_fd, 0);
+        if (data == MAP_FAILED) {
+            close();
+            return false;
+        }
+        // the whole pipeline walks the points front to back
+        madvise(data, size_t(st.st_size), MADV_SEQUENTIAL);
+        m_data = static_cast<const char *>(data);
+        m_size = size_t(st.st_size);
+#endif
+        return true;
+    }
+
+    void close()
+    {
+#if defined(_WIN32)
+        if (m_data != nullptr)
+            UnmapViewOfFile(m_data);
+        if (m_mapping != nullptr)
+            CloseHandle(m_mapping);
+        if (m_file != INVALID_HANDLE_VALUE)
+            CloseHandle(m_file);
+        m_mapping = nullptr;
+        m_file    = INVALID_HANDLE_VALUE;
+#else
+        if (m_data != nullptr)
+            munmap(const_cast<char *>(m_data), m_size);
+        if (m_fd >= 0)
+            ::close(m_fd);
+        m_fd = -1;
+#endif
+        m_data = nullptr;
+        m_size = 0;
+    }
+
+    bool        is_open() const { return m_data != nullptr; }
+    const char *data() const { return m_data; }
+    size_t      size() const { return m_size; }
+
+private:
+    const char *m_data{nullptr};
+    size_t      m_size{0};
+#if defined(_WIN32)
+    HANDLE m_file{INVALID_HANDLE_VALUE};
+    HANDLE m_mapping{nullptr};
+#else
+    int m_fd{-1};
+#endif
+};
+
+// Number of PathPoints a legacy dump of the given byte size can hold
+static size_t available_path_points(size_t file_size) { return file_size < sizeof(size_t) ? 0 : (file_size - sizeof(size_t)) / sizeof(gcode::PathPoint); }
+
+// Reader function to load vector of PathPoints from a file.
+// Legacy dump layout: size_t count followed by count raw PathPoint records.
+static std::vector<gcode::PathPoint> readPathPoints(const std::string &filename)
+{
+    std::vector<gcode::PathPoint> pathPoints;
+
+    std::ifstream file(filename, std::ios::binary | std::ios::ate);
+    if (!file) {
+        std::cerr << "Error opening file: " << filename << std::endl;
+        return pathPoints;
+    }
+    const size_t file_size = size_t(file.tellg());
+    file.seekg(0);
+
+    // Read the size of the vector
+    size_t size = 0;
+    file.read(reinterpret_cast<char *>(&size), sizeof(size));
+    if (size > available_path_points(file_size)) {
+        std::cerr << "File " << filename << " is truncated, expected " << size << " points" << std::endl;
+        size = available_path_points(file_size);
+    }
+    pathPoints.resize(size);
+
+    // Read all PathPoint records at once
+    file.read(reinterpret_cast<char *>(pathPoints.data()), std::streamsize(size * sizeof(gcode::PathPoint)));
+
+    return pathPoints;
+}
+
+// PathPoints of a legacy dump, exposed as a read-only span. The file is memory mapped when possible
+// so no copy of the records is made; otherwise it is read into memory with readPathPoints.
+class PathPointsFile
+{
+public:
+    bool open(const std::string &filename, bool allow_mapping = true)
+    {
+        m_file.close();
+        m_fallback.clear();
+        m_points = {};
+
+        if (allow_mapping && m_file.open(filename)) {
+            size_t size = 0;
+            if (m_file.size() >= sizeof(size))
+                std::memcpy(&size, m_file.data(), sizeof(size));
+            if (size > available_path_points(m_file.size())) {
+                std::cerr << "File " << filename << " is truncated, expected " << size << " points" << std::endl;
+                size = available_path_points(m_file.size());
+            }
+            // the records start right after the 8 byte count, which keeps them 4 byte aligned
+            m_points = {reinterpret_cast<const gcode::PathPoint *>(m_file.data() + sizeof(size_t)), size};
+            return true;
+        }
+
+        if (allow_mapping)
+            std::cerr << "Cannot map file " << filename << ", reading it instead" << std::endl;
+
+        std::ifstream file(filename, std::ios::binary);
+        if (!file) {
+            std::cerr << "Error opening file: " << filename << std::endl;
+            return false;
+        }
+        file.close();
+        m_fallback = readPathPoints(filename);
+        m_points   = m_fallback;
+        return true;
+    }
+
+    Span<const gcode::PathPoint> points() const { return m_points; }
+    bool                         is_mapped() const { return m_file.is_open(); }
+
+private:
+    MappedFile                    m_file;
+    std::vector<gcode::PathPoint> m_fallback;
+    Span<const gcode::PathPoint>  m_points;
+};
+
+} // namespace loader
+
+#endif /* LOADER_H_ */
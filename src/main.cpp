@@ -66,9 +66,16 @@
 #include "../libs/emscripten/emscripten_mainloop_stub.h"
 #endif
 
+#include "bgcode.h"
 #include "camera.h"
+#include "container.h"
 #include "gcode.h"
+#include "loader.h"
+#include "parser.h"
 #include "shaders.h"
+#include "scene.h"
+#include "scene_cache.h"
+#include "streaming.h"
 
 namespace glfwContext {
 Camera camera;
@@ -252,32 +259,66 @@ static void glfw_window_iconify_callback(GLFWwindow* window, int value)
 
 } // namespace glfwContext
 
-// Reader function to load vector of PathPoints from a file
-static std::vector<gcode::PathPoint> readPathPoints(const std::string &filename)
+// GPU time of the draws of the visible segments, from the segment records and from the point textures. The timer
+// queries are read back a few frames later so that the CPU never waits for them.
+class DrawTimer
 {
-    std::vector<gcode::PathPoint> pathPoints;
+    static constexpr size_t Queries = 4;
+    GLuint                  m_queries[Queries]{};
+    bool                    m_pending[Queries]{};
+    bool                    m_records[Queries]{};
+    size_t                  m_current{0};
+    bool                    m_timing{false};
 
-    std::ifstream file(filename, std::ios::binary);
-    if (!file) {
-        std::cerr << "Error opening file: " << filename << std::endl;
-        return pathPoints;
-    }
+public:
+    // averages over the last frames, 0 until measured
+    double texture_ms{0.0};
+    double records_ms{0.0};
 
-    // Read the size of the vector
-    size_t size;
-    file.read(reinterpret_cast<char *>(&size), sizeof(size));
-    std::cout << "SIZE IS: " << size << std::endl;
-    pathPoints.resize(size);
+    void begin(bool segment_records)
+    {
+        // timer queries are core from OpenGL 3.3
+        if (!GLAD_GL_VERSION_3_3)
+            return;
+        if (m_queries[0] == 0)
+            glGenQueries(GLsizei(Queries), m_queries);
+        collect();
+        // all queries in flight, this draw is not measured
+        m_timing = !m_pending[m_current];
+        if (!m_timing)
+            return;
+        m_records[m_current] = segment_records;
+        glBeginQuery(GL_TIME_ELAPSED, m_queries[m_current]);
+    }
 
-    // Read each PathPoint object from the file
-    for (auto &point : pathPoints) {
-        file.read(reinterpret_cast<char *>(&point), sizeof(point));
+    void end()
+    {
+        if (!m_timing)
+            return;
+        glEndQuery(GL_TIME_ELAPSED);
+        m_pending[m_current] = true;
+        m_current            = (m_current + 1) % Queries;
     }
 
-    file.close();
+private:
+    void collect()
+    {
+        for (size_t q = 0; q < Queries; ++q) {
+            GLint available = 0;
+            if (m_pending[q])
+                glGetQueryObjectiv(m_queries[q], GL_QUERY_RESULT_AVAILABLE, &available);
+            if (available == 0)
+                continue;
+            GLuint64 ns = 0;
+            glGetQueryObjectui64v(m_queries[q], GL_QUERY_RESULT, &ns);
+            double &average = m_records[q] ? records_ms : texture_ms;
+            average         = average == 0.0 ? 1e-6 * double(ns) : 0.9 * average + 0.1e-6 * double(ns);
+            m_pending[q]    = false;
+        }
+    }
+};
 
-    return pathPoints;
-}
+static DrawTimer draw_timer;
 
 static void show_fps()
 {
@@ -286,6 +327,7 @@ static void show_fps()
     ImGui::PushStyleVar(ImGuiStyleVar_WindowBorderSize, 0.0f);
     ImGui::Begin("##fps", nullptr, ImGuiWindowFlags_AlwaysAutoResize | ImGuiWindowFlags_NoDecoration | ImGuiWindowFlags_NoMove);
     ImGui::Text("FPS %d", (unsigned int) ImGui::GetCurrentContext()->IO.Framerate);
+    ImGui::Text("draw: texture buffers %.2f ms, segment records %.2f ms", draw_timer.texture_ms, draw_timer.records_ms);
     ImGui::End();
     ImGui::PopStyleVar();
 }
@@ -310,6 +352,9 @@ void show_config_window()
     if (ImGui::Checkbox("view_solid_infills", &config::view_solid_infills)) { config::enabled_paths_update_required = true;}
     if (ImGui::Checkbox("view_supports", &config::view_supports)) { config::enabled_paths_update_required = true;}
     if (ImGui::Checkbox("vsync", &config::vsync)) {}
+    if (shaderProgram::gcode_records_program != 0)
+        ImGui::Checkbox("segment_records", &config::segment_records);
+    ImGui::Checkbox("indexed_segments", &config::indexed_segments);
     if (ImGui::Checkbox("use_travel_moves_data", &config::use_travel_moves_data)) {
         config::ranges_update_required = true;
         config::color_update_required = true;
@@ -391,8 +436,9 @@ void show_sequential_sliders()
     ImGui::PushStyleVar(ImGuiStyleVar_WindowBorderSize, 0.0f);
     ImGui::Begin("##sequential", nullptr, ImGuiWindowFlags_AlwaysAutoResize | ImGuiWindowFlags_NoDecoration | ImGuiWindowFlags_NoMove);
 
-    const int global_min = (int)sequential_range.get_global_min();
-    const int global_max = (int)sequential_range.get_global_max();
+    // 64 bit sliders, scenes may have more segments than an int holds
+    const uint64_t global_min = sequential_range.get_global_min();
+    const uint64_t global_max = sequential_range.get_global_max();
 
     const std::string start = "1";
     const std::string end = std::to_string(global_max);
@@ -401,22 +447,22 @@ void show_sequential_sliders()
     ImGui::Text("%d", 1);
     ImGui::SameLine();
     ImGui::SetNextItemWidth(0.5f * width - labels_width);
-    int low = (int)sequential_range.get_current_min();
-    if (ImGui::SliderInt("##slider_low", &low, global_min, global_max, "%d", ImGuiSliderFlags_NoInput)) {
+    uint64_t low = sequential_range.get_current_min();
+    if (ImGui::SliderScalar("##slider_low", ImGuiDataType_U64, &low, &global_min, &global_max, "%llu", ImGuiSliderFlags_NoInput)) {
         sequential_range.set_current_min((size_t)low);
     }
     ImGui::SameLine();
-    ImGui::Text("%d", global_max);
+    ImGui::Text("%llu", static_cast<unsigned long long>(global_max));
 
     ImGui::Text("%d", 1);
     ImGui::SameLine();
     ImGui::SetNextItemWidth(0.5f * width - labels_width);
-    int high = (int)sequential_range.get_current_max();
-    if (ImGui::SliderInt("##slider_high", &high, global_min, global_max, "%d", ImGuiSliderFlags_NoInput)) {
+    uint64_t high = sequential_range.get_current_max();
+    if (ImGui::SliderScalar("##slider_high", ImGuiDataType_U64, &high, &global_min, &global_max, "%llu", ImGuiSliderFlags_NoInput)) {
         sequential_range.set_current_max((size_t)high);
     }
     ImGui::SameLine();
-    ImGui::Text("%d", global_max);
+    ImGui::Text("%llu", static_cast<unsigned long long>(global_max));
 
     ImGui::End();
     ImGui::PopStyleVar();
@@ -431,15 +477,8 @@ class SceneBox
     glm::vec3 m_max{ -FLT_MAX, -FLT_MAX, -FLT_MAX };
 
 public:
-    void update(const std::vector<gcode::PathPoint>& points) {
-        for (const gcode::PathPoint& p : points) {
-            m_min.x = std::min(m_min.x, p.position.x);
-            m_min.y = std::min(m_min.y, p.position.y);
-            m_min.z = std::min(m_min.z, p.position.z);
-            m_max.x = std::max(m_max.x, p.position.x);
-            m_max.y = std::max(m_max.y, p.position.y);
-            m_max.z = std::max(m_max.z, p.position.z);
-        }
+    void update(Span<const glm::vec3> positions, size_t first = 0) {
+        gcode::update_bounds(m_min, m_max, positions.subspan(first, positions.size() - first));
     }
 
     void center_camera() {
@@ -537,6 +576,149 @@ void switchConfiguration()
     }
 }
 
+// Draws the uploaded visible segments into the bound framebuffer
+void draw_segments(const gcode::BufferedPath &path)
+{
+    // the segments are read from their records instead of the point textures once the records are built
+    const bool   segment_records = config::segment_records && shaderProgram::gcode_records_program != 0 && path.segment_records_count > 0;
+    const GLuint program         = segment_records ? shaderProgram::gcode_records_program : shaderProgram::gcode_program;
+    glUseProgram(program);
+    glBindVertexArray(config::indexed_segments ? gcode::gcodeIndexedVAO : gcode::gcodeVAO);
+    checkGl();
+
+    const int positions_tex_id = ::glGetUniformLocation(program, "positionsTex");
+    assert(positions_tex_id >= 0 || segment_records);
+    const int height_width_angle_tex_id = ::glGetUniformLocation(program, "heightWidthAngleTex");
+    assert(height_width_angle_tex_id >= 0 || segment_records);
+    const int colors_tex_id = ::glGetUniformLocation(program, "colorsTex");
+    assert(colors_tex_id >= 0);
+    const int segment_index_tex_id = ::glGetUniformLocation(program, "segmentIndexTex");
+    assert(segment_index_tex_id >= 0);
+    const int instance_base_id = ::glGetUniformLocation(program, "instance_base");
+    assert(instance_base_id >= 0);
+    const int quantized_positions_id = ::glGetUniformLocation(program, "quantized_positions");
+    assert(quantized_positions_id >= 0 || segment_records);
+    const int quantized_positions_tex_id = ::glGetUniformLocation(program, "quantizedPositionsTex");
+    assert(quantized_positions_tex_id >= 0 || segment_records);
+    const int position_chunks_tex_id = ::glGetUniformLocation(program, "positionChunksTex");
+    assert(position_chunks_tex_id >= 0 || segment_records);
+    const int packed_height_width_angle_id = ::glGetUniformLocation(program, "packed_height_width_angle");
+    assert(packed_height_width_angle_id >= 0 || segment_records);
+    const int packed_height_width_angle_tex_id = ::glGetUniformLocation(program, "packedHeightWidthAngleTex");
+    assert(packed_height_width_angle_tex_id >= 0 || segment_records);
+    const int palette_tex_id = ::glGetUniformLocation(program, "paletteTex");
+    assert(palette_tex_id >= 0);
+    const int shader_colors_id = ::glGetUniformLocation(program, "shader_colors");
+    assert(shader_colors_id >= 0);
+    const int visualization_type_id = ::glGetUniformLocation(program, "visualization_type");
+    assert(visualization_type_id >= 0);
+    const int value_range_id = ::glGetUniformLocation(program, "value_range");
+    assert(value_range_id >= 0);
+    const int flags_tex_id = ::glGetUniformLocation(program, "flagsTex");
+    assert(flags_tex_id >= 0);
+    const int color_values_tex_id = ::glGetUniformLocation(program, "colorValuesTex");
+    assert(color_values_tex_id >= 0);
+    const int color_ids_tex_id = ::glGetUniformLocation(program, "colorIdsTex");
+    assert(color_ids_tex_id >= 0);
+
+    glUniform1i(positions_tex_id, 0);
+    glUniform1i(height_width_angle_tex_id, 1);
+    glUniform1i(colors_tex_id, 2);
+    glUniform1i(segment_index_tex_id, 3);
+    glUniform1i(quantized_positions_tex_id, 4);
+    glUniform1i(position_chunks_tex_id, 5);
+    glUniform1i(quantized_positions_id, path.quantized_positions ? 1 : 0);
+    glUniform1i(packed_height_width_angle_tex_id, 6);
+    glUniform1i(packed_height_width_angle_id, path.packed_height_width_angle ? 1 : 0);
+    glUniform1i(flags_tex_id, 7);
+    glUniform1i(color_values_tex_id, 8);
+    glUniform1i(color_ids_tex_id, 9);
+    glUniform1i(palette_tex_id, 10);
+    glUniform1i(shader_colors_id, path.shader_colors ? 1 : 0);
+    checkGl();
+
+    if (segment_records) {
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, gcode::pathSSBObindPoint, path.segment_records_buffer);
+    } else {
+        if (path.quantized_positions) {
+            glActiveTexture(GL_TEXTURE4);
+            glBindTexture(GL_TEXTURE_BUFFER, path.positions_texture);
+            glTexBuffer(GL_TEXTURE_BUFFER, GL_R16UI, path.positions_buffer);
+
+            glActiveTexture(GL_TEXTURE5);
+            glBindTexture(GL_TEXTURE_BUFFER, path.position_chunks_texture);
+            glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, path.position_chunks_buffer);
+        } else {
+            glActiveTexture(GL_TEXTURE0);
+            glBindTexture(GL_TEXTURE_BUFFER, path.positions_texture);
+            glTexBuffer(GL_TEXTURE_BUFFER, GL_RGB32F, path.positions_buffer);
+        }
+
+        if (path.packed_height_width_angle) {
+            glActiveTexture(GL_TEXTURE6);
+            glBindTexture(GL_TEXTURE_BUFFER, path.height_width_angle_texture);
+            glTexBuffer(GL_TEXTURE_BUFFER, GL_R32UI, path.height_width_angle_buffer);
+        } else {
+            glActiveTexture(GL_TEXTURE1);
+            glBindTexture(GL_TEXTURE_BUFFER, path.height_width_angle_texture);
+            glTexBuffer(GL_TEXTURE_BUFFER, GL_RGB32F, path.height_width_angle_buffer);
+        }
+    }
+
+    if (path.shader_colors) {
+        // switching the visualization type only changes these uniforms and the column bound
+        const gcode::Range *range = gcode::visualization_range(config::visualization_type);
+        glUniform1i(visualization_type_id, gcode::shader_visualization_type(path));
+        glUniform2f(value_range_id, range != nullptr ? range->min() : 0.0f, range != nullptr ? range->max() : 0.0f);
+
+        const gcode::ColumnBuffer &flags = path.column_buffers[size_t(gcode::Column::Flags)];
+        glActiveTexture(GL_TEXTURE7);
+        glBindTexture(GL_TEXTURE_BUFFER, flags.texture);
+        glTexBuffer(GL_TEXTURE_BUFFER, GL_R32UI, flags.buffer);
+
+        const gcode::Column colored = gcode::colored_column(config::visualization_type);
+        if (gcode::shader_visualization_type(path) >= 0 && colored != gcode::Column::Count) {
+            const gcode::ColumnBuffer &values = path.column_buffers[size_t(colored)];
+            const bool                 ids    = gcode::is_id_column(colored);
+            glActiveTexture(ids ? GL_TEXTURE9 : GL_TEXTURE8);
+            glBindTexture(GL_TEXTURE_BUFFER, values.texture);
+            glTexBuffer(GL_TEXTURE_BUFFER, ids ? GL_R32UI : GL_R32F, values.buffer);
+        }
+    } else {
+        glActiveTexture(GL_TEXTURE2);
+        glBindTexture(GL_TEXTURE_BUFFER, path.color_texture);
+        glTexBuffer(GL_TEXTURE_BUFFER, GL_R8UI, path.color_buffer);
+
+        glActiveTexture(GL_TEXTURE10);
+        glBindTexture(GL_TEXTURE_BUFFER, gcode::paletteTexture);
+    }
+
+    glActiveTexture(GL_TEXTURE3);
+    glBindTexture(GL_TEXTURE_BUFFER, path.visible_segments_texture);
+    glTexBuffer(GL_TEXTURE_BUFFER, GL_R32UI, path.visible_segments_buffer);
+
+    const int vp_id = ::glGetUniformLocation(program, "view_projection");
+    assert(vp_id >= 0);
+    const int camera_position_id = ::glGetUniformLocation(program, "camera_position");
+    assert(camera_position_id >= 0);
+
+    auto view_projection = glfwContext::camera.get_view_projection();
+    auto camera_position = glfwContext::camera.position;
+    glUniformMatrix4fv(vp_id, 1, GL_FALSE, glm::value_ptr(view_projection));
+    glUniform3fv(camera_position_id, 1, glm::value_ptr(camera_position));
+    checkGl();
+
+    if (path.visible_segments_count > 0) {
+        draw_timer.begin(segment_records);
+        gcode::drawVisibleSegments(path, instance_base_id, segment_records, config::indexed_segments);
+        draw_timer.end();
+    }
+    checkGl();
+
+    glUseProgram(0);
+    glBindVertexArray(0);
+}
+
 void render(gcode::BufferedPath &path)
 {
     glfwContext::camera.moveCamera({glfwContext::forth_back, glfwContext::left_right, glfwContext::up_down});
@@ -561,16 +743,11 @@ void render(gcode::BufferedPath &path)
         std::cout << "VISIBLITY RENDERING PASS STARTS: " << glfwGetTime() << std::endl;
 
         // Buffer previously computed visible lines
-        glBindBuffer(GL_TEXTURE_BUFFER, path.visible_segments_buffer);
-        glBufferData(GL_TEXTURE_BUFFER, path.visible_lines.size() * sizeof(uint32_t), path.visible_lines.data(), GL_STREAM_DRAW);
-        path.visible_segments_count = path.visible_lines.size();
+        gcode::uploadVisibleSegments(path);
 
         if (config::force_full_model_render) {
-            path.visible_lines.clear();
-            path.enabled_lines_bitset.get_enabled_indices(path.visible_lines);
-            glBindBuffer(GL_TEXTURE_BUFFER, path.visible_segments_buffer);
-            glBufferData(GL_TEXTURE_BUFFER, path.visible_lines.size() * sizeof(uint32_t), path.visible_lines.data(), GL_STREAM_DRAW);
-            path.visible_segments_count = path.visible_lines.size();
+            gcode::collect_segments(path.enabled_lines_bitset, path.visible_lines, path.visible_lines_chunk_ends);
+            gcode::uploadVisibleSegments(path);
             config::with_visibility_pass = false;
         }
 
@@ -644,11 +821,14 @@ void render(gcode::BufferedPath &path)
                           [heatloss, &path](GLint &heat) {
                               if (heat > 0) {
                                   size_t box_id = std::distance(&path.visible_boxes_heat[0], &heat);
-                                  for (size_t line_idx : path.visibility_boxes_with_segments[box_id].second) {
-                                      if (line_idx >= sequential_range.get_current_min() && line_idx <= sequential_range.get_current_max()) {
-                                          path.visible_lines_bitset.set_atomic(line_idx);
+                                  // the runs of consecutive segments are clipped to the sequential range and set a block at a time
+                                  path.visibility_box_segments.for_each_run(uint32_t(box_id), [&path](size_t first, size_t count) {
+                                      const size_t begin = std::max(first, sequential_range.get_current_min());
+                                      const size_t end   = std::min(first + count, sequential_range.get_current_max() + 1);
+                                      if (begin < end) {
+                                          path.visible_lines_bitset.set_range_atomic(begin, end);
                                       }
-                                  }
+                                  });
                                   heat -= heatloss;
                               }
                           });
@@ -657,8 +837,7 @@ void render(gcode::BufferedPath &path)
 
             std::cout << "enabled hot lines " << glfwGetTime() << std::endl;
 
-            path.visible_lines.clear();
-            path.visible_lines_bitset.get_enabled_indices(path.visible_lines);
+            gcode::collect_segments(path.visible_lines_bitset, path.visible_lines, path.visible_lines_chunk_ends);
 
             std::cout << "filtering done " << glfwGetTime() << std::endl;
         });
@@ -674,63 +853,85 @@ void render(gcode::BufferedPath &path)
     glViewport(0, 0, globals::screenResolution.x, globals::screenResolution.y);
     checkGl();
 
-    glUseProgram(shaderProgram::gcode_program);
-    glBindVertexArray(gcode::gcodeVAO);
-    checkGl();
-
-    const int positions_tex_id = ::glGetUniformLocation(shaderProgram::gcode_program, "positionsTex");
-    assert(positions_tex_id >= 0);
-    const int height_width_angle_tex_id = ::glGetUniformLocation(shaderProgram::gcode_program, "heightWidthAngleTex");
-    assert(height_width_angle_tex_id >= 0);
-     const int colors_tex_id = ::glGetUniformLocation(shaderProgram::gcode_program, "colorsTex");
-    assert(colors_tex_id >= 0);
-    const int segment_index_tex_id = ::glGetUniformLocation(shaderProgram::gcode_program, "segmentIndexTex");
-    assert(segment_index_tex_id >= 0);
-
-    glUniform1i(positions_tex_id, 0);
-    glUniform1i(height_width_angle_tex_id, 1);
-    glUniform1i(colors_tex_id, 2);
-    glUniform1i(segment_index_tex_id, 3);
-    checkGl();
-
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_BUFFER, path.positions_texture);
-    glTexBuffer(GL_TEXTURE_BUFFER, GL_RGB32F, path.positions_buffer);
-
-    glActiveTexture(GL_TEXTURE1);
-    glBindTexture(GL_TEXTURE_BUFFER, path.height_width_angle_texture);
-    glTexBuffer(GL_TEXTURE_BUFFER, GL_RGB32F, path.height_width_angle_buffer);
-
-    glActiveTexture(GL_TEXTURE2);
-    glBindTexture(GL_TEXTURE_BUFFER, path.color_texture);
-    glTexBuffer(GL_TEXTURE_BUFFER, GL_R32F, path.color_buffer);
-
-    glActiveTexture(GL_TEXTURE3);
-    glBindTexture(GL_TEXTURE_BUFFER, path.visible_segments_texture);
-    glTexBuffer(GL_TEXTURE_BUFFER, GL_R32UI, path.visible_segments_buffer);
-
-    const int vp_id = ::glGetUniformLocation(shaderProgram::gcode_program, "view_projection");
-    assert(vp_id >= 0);
-    const int camera_position_id = ::glGetUniformLocation(shaderProgram::gcode_program, "camera_position");
-    assert(camera_position_id >= 0);
-
-    auto view_projection = glfwContext::camera.get_view_projection();
-    auto camera_position = glfwContext::camera.position;
-    glUniformMatrix4fv(vp_id, 1, GL_FALSE, glm::value_ptr(view_projection));
-    glUniform3fv(camera_position_id, 1, glm::value_ptr(camera_position));
-    checkGl();
-
-    if (path.visible_segments_count > 0)
-        glDrawArraysInstanced(GL_TRIANGLES, 0, (GLsizei) gcode::vertex_data_size, path.visible_segments_count);
-    checkGl();
+    draw_segments(path);
+}
 
-    glUseProgram(0);
-    glBindVertexArray(0);
+// Draws the first segments of the path at several counts, non-indexed and indexed, and prints the GPU time of a frame
+// and the vertex shader invocations per segment, these when pipeline statistics queries are available. The camera
+// shows the whole scene and every count is drawn the given number of frames without vsync.
+void run_draw_benchmark(gcode::BufferedPath &path, size_t frames)
+{
+    const bool statistics = GLAD_GL_VERSION_4_6 || GLAD_GL_ARB_pipeline_statistics_query;
+    if (!GLAD_GL_VERSION_3_3) {
+        std::cerr << "The draw benchmark needs timer queries, OpenGL 3.3" << std::endl;
+        return;
+    }
+    GLuint queries[2];
+    glGenQueries(2, queries);
+    glfwSwapInterval(0);
+    scene_box.center_camera();
+
+    gcode::collect_segments(path.enabled_lines_bitset, path.visible_lines, path.visible_lines_chunk_ends);
+    const std::vector<uint32_t> all_segments   = path.visible_lines;
+    const std::vector<size_t>   all_chunk_ends = path.visible_lines_chunk_ends;
+    std::printf("%12s %-12s %12s %22s\n", "segments", "geometry", "ms/frame", "vs invocations/segment");
+    for (size_t divisor : {64, 16, 4, 1}) {
+        // the first segments of the path, the chunks cut at the count
+        const size_t count = std::max<size_t>(all_segments.size() / divisor, 1);
+        path.visible_lines.assign(all_segments.begin(), all_segments.begin() + std::min(count, all_segments.size()));
+        path.visible_lines_chunk_ends = all_chunk_ends;
+        for (size_t &end : path.visible_lines_chunk_ends) end = std::min(end, path.visible_lines.size());
+        gcode::uploadVisibleSegments(path);
+
+        for (bool indexed : {false, true}) {
+            config::indexed_segments = indexed;
+            double   ms          = 0.0;
+            GLuint64 invocations = 0;
+            for (size_t frame = 0; frame < frames + 2; ++frame) {
+                glBindFramebuffer(GL_FRAMEBUFFER, 0);
+                glEnable(GL_DEPTH_TEST);
+                glClearColor(0.6f, 0.6f, 0.6f, 1.0f);
+                glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+                glViewport(0, 0, globals::screenResolution.x, globals::screenResolution.y);
+                glBeginQuery(GL_TIME_ELAPSED, queries[0]);
+                if (statistics)
+                    glBeginQuery(GL_VERTEX_SHADER_INVOCATIONS, queries[1]);
+                draw_segments(path);
+                if (statistics)
+                    glEndQuery(GL_VERTEX_SHADER_INVOCATIONS);
+                glEndQuery(GL_TIME_ELAPSED);
+                glfwSwapBuffers(glfwContext::window);
+                // the first frames warm up
+                if (frame < 2)
+                    continue;
+                GLuint64 ns = 0, vs = 0;
+                glGetQueryObjectui64v(queries[0], GL_QUERY_RESULT, &ns);
+                if (statistics)
+                    glGetQueryObjectui64v(queries[1], GL_QUERY_RESULT, &vs);
+                ms += 1e-6 * double(ns);
+                invocations += vs;
+            }
+            std::printf("%12zu %-12s %12.3f", path.visible_lines.size(), indexed ? "indexed" : "24 vertices", ms / double(frames));
+            if (statistics)
+                std::printf(" %22.2f", double(invocations) / double(frames) / double(path.visible_lines.size()));
+            std::printf("\n");
+        }
+    }
+    glDeleteQueries(2, queries);
+    glfwSwapInterval(config::vsync);
 }
 
 void setup()
 {
     shaderProgram::createGCodeProgram();
+    glUseProgram(shaderProgram::gcode_program);
+    gcode::set_color_palettes(shaderProgram::gcode_program);
+    shaderProgram::createGCodeRecordsProgram();
+    if (shaderProgram::gcode_records_program != 0) {
+        glUseProgram(shaderProgram::gcode_records_program);
+        gcode::set_color_palettes(shaderProgram::gcode_records_program);
+    }
+    glUseProgram(0);
     shaderProgram::createVisibilityProgram();
     gcode::init();
     checkGl();
@@ -740,17 +941,135 @@ void setup()
 // Main code
 int main(int argc, char *argv[])
 {
+    std::vector<std::string> arguments;
+    bool                     no_stream      = false;
+    bool                     draw_benchmark = false;
+    for (int i = 1; i < argc; ++i) {
+        const std::string argument = argv[i];
+        if (argument == "--no-stream") {
+            no_stream = true;
+        } else if (argument == "--draw-benchmark") {
+            // the whole file is loaded, drawn at several segment counts with both geometries, then the viewer exits
+            no_stream      = true;
+            draw_benchmark = true;
+        } else if (argument.rfind("--quantize", 0) == 0) {
+            // --quantize[=step_mm] uploads the positions as 16 bit offsets, 1 um steps by default
+            config::quantize_positions = true;
+            if (argument.size() > 11 && argument[10] == '=')
+                config::position_precision = std::stof(argument.substr(11));
+        } else if (argument == "--pack") {
+            // heights, widths and angles packed in 32 bits
+            config::pack_height_width_angle = true;
+        } else if (argument == "--ssbo") {
+            // the segments are drawn from their records in a shader storage buffer, switchable in the config window
+            config::segment_records = true;
+        } else if (argument.rfind("--voxel-size=", 0) == 0) {
+            // the voxel size of the visibility boxes in mm instead of the one tuned to the scene
+            config::voxel_size      = std::stof(argument.substr(13));
+            config::auto_voxel_size = false;
+        } else if (argument == "--shader-colors") {
+            // the points are colored in the vertex shader from the attribute columns
+            config::shader_colors = true;
+        } else {
+            arguments.push_back(argument);
+        }
+    }
+
     // Check if a filename argument is provided
-    if (argc < 2) {
-        std::cout << "Please provide a filename as an argument." << std::endl;
+    if (arguments.empty()) {
+        std::cout << "Please provide a filename as an argument, several files (file@x,y[,z[,angle]] to place them) to compare them, "
+                     "or --live [ring_name] to receive the points from live_producer. --quantize[=step_mm] stores the positions on 16 bits on "
+                     "the GPU, --pack the heights, widths and angles in 32 bits, --shader-colors colors the points in the vertex shader, --ssbo "
+                     "draws the segments from a shader storage buffer (OpenGL 4.3), --draw-benchmark compares the indexed and non-indexed "
+                     "segment geometry, --voxel-size=mm sets the voxel size of the visibility boxes instead of tuning it to the scene."
+                  << std::endl;
         return 1;
     }
 
-    // Read the filename from argv[1]
-    const std::string filename = argv[1];
+    const std::string filename = arguments[0];
+    // with --live the points come from another process through a shared memory ring
+    const bool live = filename == "--live";
+    // several files are loaded side by side into one scene
+    const bool multi_object = !live && arguments.size() > 1;
+    // the file is loaded progressively while rendering, unless --no-stream is given
+    bool stream = live || (!no_stream && !multi_object);
+
+    // a scene preprocessed before for the same file and voxel settings is mapped from the cache, the file content is
+    // checked against it in the background
+    const auto                    load_start = std::chrono::steady_clock::now();
+    const uint64_t                cache_key  = live || multi_object ? 0 : scene_cache::file_key(filename, scene_cache::voxel_settings());
+    scene_cache::SceneFile        cached_scene;
+    const bool                    cache_hit = cache_key != 0 && cached_scene.open(cache_key);
+    std::vector<glm::vec3>        height_width_angle;
+    std::future<void>             cache_writing;
+    std::future<bool>             cache_checking;
+    std::future<gcode::PathStore> column_fetching; // attribute columns loaded in the background
+    auto elapsed_ms = [](std::chrono::steady_clock::time_point start) {
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    };
 
-    auto points = readPathPoints(filename);
-    rendering::scene_box.update(points);
+    // only the core columns and the ones of the initial visualization type are loaded, the others are fetched from
+    // the files of the objects the first time a visualization type needs them
+    std::vector<scene::Object> objects;
+    // the object of a scene loaded from a single file, at the origin
+    scene::Object single_object;
+    single_object.filename = filename;
+    streaming::PathStream      path_stream;
+    gcode::PathStore           columns;
+    columns.loaded_columns = gcode::Core_Columns | gcode::visualization_columns(config::visualization_type);
+    if (live) {
+        const std::string ring_name = arguments.size() > 1 ? arguments[1] : live::Default_Name;
+        if (!path_stream.open_live(ring_name))
+            return 1;
+        // there is no file to fetch the columns from later
+        columns.loaded_columns = gcode::All_Columns;
+        std::cout << "WAITING FOR POINTS IN RING " << ring_name << std::endl;
+    } else if (multi_object) {
+        for (const std::string &argument : arguments) objects.push_back(scene::parse_object_argument(argument));
+        columns = scene::load_objects(objects, columns.loaded_columns);
+        for (const scene::Object &object : objects) {
+            std::cout << "OBJECT " << object.filename << ": " << object.count << " points at " << object.placement.offset.x << ", "
+                      << object.placement.offset.y << ", " << object.placement.offset.z << std::endl;
+        }
+        if (columns.count == 0)
+            return 1;
+        std::cout << "SIZE IS: " << columns.count << " (" << objects.size() << " objects in " << elapsed_ms(load_start) << " ms)" << std::endl;
+    } else if (cache_hit) {
+        stream             = false;
+        columns            = cached_scene.columns();
+        config::voxel_size = cached_scene.voxel_size();
+        objects.push_back(single_object);
+        std::cout << "SIZE IS: " << columns.count << " (scene cache, voxel size " << config::voxel_size << " mm)" << std::endl;
+    } else if (stream) {
+        if (!path_stream.open(filename, streaming::Default_Batch_Points, columns.loaded_columns))
+            return 1;
+        objects.push_back(single_object);
+        std::cout << "STREAMING " << filename << std::endl;
+    } else {
+        if (!scene::load_columns(filename, columns.loaded_columns, columns) || columns.count == 0)
+            return 1;
+        objects.push_back(single_object);
+        std::cout << "SIZE IS: " << columns.count << " (" << elapsed_ms(load_start) << " ms)" << std::endl;
+    }
+    if (!multi_object && !objects.empty())
+        objects.front().count = columns.count;
+    rendering::scene_box.update(columns.position);
+
+    // the voxel size is tuned before the boxes are first built, on the whole scene or on the sample the stream made of
+    // its input before handing out its first batch
+    auto tune_voxel_size = [](const gcode::VoxelSample &sample) {
+        if (!config::auto_voxel_size) {
+            std::printf("VOXEL SIZE %g mm, set by --voxel-size\n", config::voxel_size);
+            return;
+        }
+        const gcode::VoxelCost cost = gcode::tune_voxel_size(sample);
+        config::voxel_size          = cost.voxel_size;
+        std::printf("VOXEL SIZE %g mm, tuned on %zu segments of %zu points extrapolated %.2fx: about %.0f visibility boxes to draw, %.1f "
+                    "segments per box\n",
+                    cost.voxel_size, cost.sampled_segments, sample.points(), sample.scale, cost.boxes, cost.segments_per_voxel());
+    };
+    if (!cache_hit && !stream)
+        tune_voxel_size(gcode::VoxelSample(columns));
 
     glfwSetErrorCallback(glfwContext::glfw_error_callback);
     if (!glfwInit())
@@ -836,12 +1155,49 @@ int main(int argc, char *argv[])
     rendering::setup();
 
     // gcode::BufferedPath path = gcode::generateTestingPathPoints();
-    gcode::BufferedPath path = gcode::bufferExtrusionPaths(points);
+    gcode::BufferedPath path;
+    if (cache_hit) {
+        path = cached_scene.upload();
+        const double load_ms = elapsed_ms(load_start);
+        std::cout << "SCENE CACHE HIT: loaded in " << load_ms << " ms instead of " << cached_scene.preprocessing_ms() << " ms, saved "
+                  << cached_scene.preprocessing_ms() - load_ms << " ms" << std::endl;
+        cache_checking = std::async(std::launch::async, scene_cache::check_content, filename, cache_key, cached_scene.content_hash());
+    } else {
+        path = gcode::bufferExtrusionPaths(columns, cache_key != 0 ? &height_width_angle : nullptr);
+        if (cache_key != 0)
+            std::cout << "SCENE CACHE MISS" << std::endl;
+        // the columns do not change anymore, the cache is written in the background from copies of the rest as when
+        // streaming
+        if (cache_key != 0 && !stream && path.total_points_count > 0) {
+            cache_writing = std::async(std::launch::async, [cache_key, &filename, &columns, valid_lines = path.valid_lines_bitset,
+                                                            box_coords = path.visibility_box_coords, boxes = path.visibility_box_segments,
+                                                            preprocessing_ms = elapsed_ms(load_start),
+                                                            height_width_angle = std::move(height_width_angle)]() {
+                scene_cache::write(cache_key, scene_cache::file_content_hash(filename), columns, height_width_angle, valid_lines,
+                                   box_coords, boxes, preprocessing_ms);
+            });
+        }
+    }
 
-    sequential_range.set_global_max(path.total_points_count);
-    sequential_range.set_current_max(path.total_points_count);
+    if (path.total_points_count > 0) {
+        sequential_range.set_global_max(path.total_points_count);
+        sequential_range.set_current_max(path.total_points_count);
+        std::cout << "PATHS BUFFERED" << std::endl;
+        gcode::report_point_buffers(path);
+    }
 
-    std::cout << "PATHS BUFFERED" << std::endl;
+    if (draw_benchmark && !stream && path.total_points_count > 0) {
+        gcode::set_ranges(columns);
+        if (path.shader_colors)
+            gcode::updateColorColumns(path, columns);
+        else
+            gcode::updatePathColors(path, columns);
+        gcode::updateEnabledLines(path, columns);
+        if (config::segment_records && shaderProgram::gcode_records_program != 0)
+            gcode::updateSegmentRecords(path, columns);
+        rendering::run_draw_benchmark(path, 20);
+        glfwSetWindowShouldClose(window, GLFW_TRUE);
+    }
 
     // Main loop
 #ifdef __EMSCRIPTEN__
@@ -870,18 +1226,98 @@ int main(int argc, char *argv[])
 
         rendering::switchConfiguration();
 
+        // the stream is finished once the polls of the previous frames picked up all of it, one batch a frame
+        const bool stream_finished = stream && path_stream.finished();
+        if (stream && path_stream.poll(columns)) {
+            // the filtering work reads the bitsets and the boxes which are extended below
+            if (path.filtering_work.valid())
+                path.filtering_work.wait();
+
+            const size_t first = path.total_points_count;
+            rendering::scene_box.update(columns.position, first);
+            if (first == 0)
+                tune_voxel_size(path_stream.voxel_sample());
+            gcode::appendExtrusionPaths(path, columns, cache_key != 0 ? &height_width_angle : nullptr);
+
+            // the sequential slider keeps following the end of the path while it is at the end
+            const bool following = first == 0 || sequential_range.get_current_max() == sequential_range.get_global_max();
+            sequential_range.set_global_max(path.total_points_count);
+            if (following)
+                sequential_range.set_current_max(path.total_points_count);
+
+            // the points before first keep their colors unless the new ones changed the ranges used by the coloring,
+            // the shader colors only need the new points of the columns
+            const bool ranges_changed = gcode::update_ranges(columns, first);
+            if (path.shader_colors)
+                gcode::updateColorColumns(path, columns);
+            else if (!config::color_update_required)
+                gcode::updatePathColors(path, columns, ranges_changed && gcode::uses_ranges(config::visualization_type) ? 0 : first);
+            if (!config::enabled_paths_update_required)
+                gcode::updateEnabledLines(path, columns, first);
+
+            if (first == 0)
+                config::camera_center_required = true;
+        }
+        if (stream_finished) {
+            stream = false;
+            std::cout << "PATHS BUFFERED, SIZE IS: " << path.total_points_count << std::endl;
+            gcode::report_point_buffers(path);
+            if (!objects.empty())
+                objects.front().count = columns.count;
+            // the core columns do not change anymore, the cache is written in the background from copies of the rest,
+            // along with the hash of the file content
+            if (cache_key != 0 && path.total_points_count > 0) {
+                cache_writing = std::async(std::launch::async, [cache_key, &filename, &columns, valid_lines = path.valid_lines_bitset,
+                                                                box_coords = path.visibility_box_coords, boxes = path.visibility_box_segments,
+                                                                preprocessing_ms = elapsed_ms(load_start),
+                                                                height_width_angle = std::move(height_width_angle)]() {
+                    scene_cache::write(cache_key, scene_cache::file_content_hash(filename), columns, height_width_angle, valid_lines,
+                                       box_coords, boxes, preprocessing_ms);
+                });
+            }
+        }
+
+        // the attribute columns are fetched in the background the first time a visualization type needs them, once the
+        // path is complete; the points keep the error color until a frame takes the fetched columns in
+        const unsigned int missing_columns = gcode::visualization_columns(config::visualization_type) & ~columns.loaded_columns;
+        if (missing_columns != 0 && !stream && !objects.empty() && !column_fetching.valid()) {
+            column_fetching = std::async(std::launch::async, [&objects, elapsed_ms, missing_columns, count = columns.count,
+                                                              fetch_start = std::chrono::steady_clock::now()]() {
+                gcode::PathStore fetched;
+                fetched.count = count;
+                scene::fetch_columns(objects, missing_columns, fetched);
+                std::cout << "COLUMNS FETCHED in " << elapsed_ms(fetch_start) << " ms" << std::endl;
+                return fetched;
+            });
+        }
+        if (column_fetching.valid() && column_fetching.wait_for(std::chrono::milliseconds{0}) == std::future_status::ready) {
+            // the cache writing reads the columns
+            if (cache_writing.valid())
+                cache_writing.wait();
+            columns.take_columns(column_fetching.get(), gcode::All_Columns);
+            config::ranges_update_required = true;
+            config::color_update_required  = true;
+        }
+
         if (config::ranges_update_required) {
-            gcode::set_ranges(points);
+            gcode::set_ranges(columns);
             config::ranges_update_required = false;
         }
 
         if (config::color_update_required) {
-            gcode::updatePathColors(path, points);
+            if (path.shader_colors)
+                gcode::updateColorColumns(path, columns);
+            else
+                gcode::updatePathColors(path, columns);
             config::color_update_required = false;
         }
 
+        // the segment records are built the first time they are switched on, then follow the appended points
+        if (config::segment_records && shaderProgram::gcode_records_program != 0)
+            gcode::updateSegmentRecords(path, columns);
+
          if (config::enabled_paths_update_required) {
-            gcode::updateEnabledLines(path, points);
+            gcode::updateEnabledLines(path, columns);
             config::enabled_paths_update_required = false;
         }
 
@@ -911,6 +1347,12 @@ int main(int argc, char *argv[])
 
     // Cleanup
     rendering::filtering_worker.stop();
+    if (cache_writing.valid())
+        cache_writing.wait();
+    if (cache_checking.valid())
+        cache_checking.wait();
+    if (column_fetching.valid())
+        column_fetching.wait();
     ImGui_ImplOpenGL3_Shutdown();
     ImGui_ImplGlfw_Shutdown();
     ImGui::DestroyContext();
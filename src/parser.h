@@ -0,0 +1,794 @@
+#ifndef PARSER_H_
+#define PARSER_H_
+
+#include "async_reader.h"
+#include "gcode.h"
+#include "loader.h"
+
+#include <glm/gtc/constants.hpp>
+
+#include <cctype>
+#include <charconv>
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+#include <execution>
+#include <numeric>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Multi-threaded G-code text parser producing PathPoints.
+//
+// The text is split into newline aligned chunks which are parsed in parallel. A chunk does not know the
+// modal state (position, feedrate, extruder, fan, temperature, role...) it starts with, so every parsed
+// move remembers which of its fields still depend on it. A cheap sequential pass then propagates the
+// state from chunk to chunk and a second parallel pass resolves the moves into PathPoints.
+//
+// PathPoint i carries the attributes of the move going from point i to point i+1, which is how
+// bufferExtrusionPaths interprets the points.
+//
+// G2/G3 arcs are kept as arcs until their start is resolved, then cut into as few chords as the arc
+// tolerance allows: a wide arc gets more points than a small one and the slicer's own flattening is not
+// needed to get smooth curves.
+namespace parser {
+
+static const size_t Default_Chunk_Size = size_t(1) << 22;
+// The first chunk of a piece cut in several is parsed ahead of the others to learn the modes they assume, it is kept
+// this small
+static const size_t Head_Chunk_Size = size_t(1) << 16;
+
+// Move types and travel roles as found in the PathPoint flags
+static const unsigned int Type_Travel    = 8;
+static const unsigned int Type_Extrude   = 10;
+static const unsigned int Travel_Move    = 0;
+static const unsigned int Travel_Retract = 2;
+
+// Largest distance between an arc and the chords it is drawn with, in mm
+static const float  Default_Arc_Tolerance = 0.01f;
+static const size_t Max_Arc_Segments      = 4096;
+
+enum ArcDirection : unsigned char { Line, Clockwise, CounterClockwise };
+
+// Fields of the modal state which may be unknown at the beginning of a chunk
+enum Field : unsigned int { X, Y, Z, E, Feedrate, FanSpeed, Temperature, Height, Width, Role, Extruder, Fields_Count };
+static constexpr unsigned int field_bit(Field field) { return 1u << field; }
+static constexpr unsigned int All_Fields = (1u << Fields_Count) - 1;
+
+struct State
+{
+    glm::vec3    position{0.0f};
+    float        e{0.0f}; // absolute E axis position
+    float        feedrate{0.0f};
+    float        fanspeed{0.0f};
+    float        temperature{0.0f};
+    float        height{0.2f};
+    float        width{0.45f};
+    unsigned int role{0};
+    unsigned int extruderid{0};
+    unsigned int colorid{0};
+    bool         relative_positioning{false}; // G91
+    bool         relative_extrusion{false};   // M83
+};
+
+// A move as parsed from a chunk. Fields in the unknown mask come from the state the chunk starts with,
+// for X, Y, Z and E the stored value is an offset to it.
+struct Move
+{
+    glm::vec3    position;
+    float        e_delta; // absolute E when E is unknown
+    float        feedrate;
+    float        fanspeed;
+    float        temperature;
+    float        height;
+    float        width;
+    unsigned int role;
+    unsigned int extruderid;
+    unsigned int colorid; // color changes since the chunk start
+    unsigned int unknown;
+    // G2/G3 in the XY plane, the center is given by its offset from the start (I, J) or by the radius (R)
+    ArcDirection arc;
+    glm::vec2    center_offset;
+    float        radius;
+};
+
+struct Chunk
+{
+    const char       *begin;
+    const char       *end;
+    std::vector<Move> moves;
+    // modes assumed at the chunk start and whether the parsed moves depend on them
+    bool assumed_relative_positioning{false};
+    bool assumed_relative_extrusion{false};
+    bool depends_on_positioning{false};
+    bool depends_on_extrusion{false};
+    bool sets_positioning{false};
+    bool sets_extrusion{false};
+    bool has_arcs{false};
+    // points added by the moves, and the first point of every move when there are arcs
+    size_t              points_count{0};
+    std::vector<size_t> first_point;
+    // state at the chunk end, in the same form as Move
+    State        last;
+    unsigned int unknown{All_Fields};
+};
+
+static const double Pow10[] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18};
+
+// Plain decimal numbers, the only kind G-code generators emit, are parsed by hand; anything else goes
+// through std::from_chars. Returns the position after the number, or p when there is no number.
+static const char *parse_float(const char *p, const char *end, float &out)
+{
+    const char *start    = p;
+    bool        negative = false;
+    if (p < end && (*p == '-' || *p == '+')) {
+        negative = *p == '-';
+        ++p;
+    }
+    uint64_t mantissa = 0;
+    int      digits   = 0;
+    int      decimals = 0;
+    for (; p < end && unsigned(*p - '0') < 10; ++p, ++digits) mantissa = mantissa * 10 + unsigned(*p - '0');
+    if (p < end && *p == '.')
+        for (++p; p < end && unsigned(*p - '0') < 10; ++p, ++digits, ++decimals) mantissa = mantissa * 10 + unsigned(*p - '0');
+    if (digits == 0)
+        return start;
+    // an uppercase E right after a number is the extrusion word of a line without spaces (MeatPack), not an exponent
+    const bool exponent = p < end && *p == 'e';
+    if (digits > 18 || exponent) {
+        const char *number = start + (*start == '+' ? 1 : 0);
+        const auto  result = std::from_chars(number, end, out, exponent ? std::chars_format::general : std::chars_format::fixed);
+        return result.ec == std::errc() ? result.ptr : start;
+    }
+    const double value = double(mantissa) / Pow10[decimals];
+    out                = float(negative ? -value : value);
+    return p;
+}
+
+static const char *skip_spaces(const char *p, const char *end)
+{
+    while (p < end && (*p == ' ' || *p == '\t')) ++p;
+    return p;
+}
+
+static bool starts_with(const char *p, const char *end, const char *prefix)
+{
+    const size_t length = std::strlen(prefix);
+    return size_t(end - p) >= length && std::memcmp(p, prefix, length) == 0;
+}
+
+// GCodeExtrusionRole from the PrusaSlicer ;TYPE: comment
+static unsigned int role_from_name(const char *p, const char *end)
+{
+    static const std::pair<const char *, unsigned int> roles[] = {
+        {"Perimeter", 1},           {"External perimeter", 2}, {"Overhang perimeter", 3},       {"Internal infill", 4},
+        {"Solid infill", 5},        {"Top solid infill", 6},   {"Ironing", 7},                  {"Bridge infill", 8},
+        {"Gap fill", 9},            {"Skirt", 10},             {"Support material interface", 12}, {"Support material", 11},
+        {"Wipe tower", 13},         {"Custom", 14},
+    };
+    while (end > p && (end[-1] == '\r' || end[-1] == ' ')) --end;
+    for (const auto &[name, role] : roles) {
+        // "Skirt" covers "Skirt/Brim"
+        if (role == 10 ? starts_with(p, end, name) : size_t(end - p) == std::strlen(name) && starts_with(p, end, name))
+            return role;
+    }
+    return 0;
+}
+
+class ChunkParser
+{
+public:
+    explicit ChunkParser(Chunk &chunk) : m_chunk(chunk)
+    {
+        m_state.relative_positioning = chunk.assumed_relative_positioning;
+        m_state.relative_extrusion   = chunk.assumed_relative_extrusion;
+        m_state.position             = glm::vec3(0.0f);
+        m_state.e                    = 0.0f;
+        m_state.colorid              = 0;
+    }
+
+    void parse()
+    {
+        m_chunk.moves.clear();
+        // slicers write about one move per 30 bytes
+        m_chunk.moves.reserve(size_t(m_chunk.end - m_chunk.begin) / 32);
+        m_chunk.depends_on_positioning = false;
+        m_chunk.depends_on_extrusion   = false;
+        m_chunk.has_arcs               = false;
+        const char *p                  = m_chunk.begin;
+        const char *end                = m_chunk.end;
+        while (p < end) {
+            const char *line_end = static_cast<const char *>(std::memchr(p, '\n', size_t(end - p)));
+            if (line_end == nullptr)
+                line_end = end;
+            parse_line(p, line_end);
+            p = line_end + 1;
+        }
+        m_chunk.last             = m_state;
+        m_chunk.unknown          = m_unknown;
+        m_chunk.sets_positioning = m_positioning_set;
+        m_chunk.sets_extrusion   = m_extrusion_set;
+    }
+
+private:
+    Chunk       &m_chunk;
+    State        m_state;
+    unsigned int m_unknown{All_Fields};
+    bool         m_positioning_set{false};
+    bool         m_extrusion_set{false};
+
+    void set_known(Field field) { m_unknown &= ~field_bit(field); }
+
+    void parse_line(const char *p, const char *end)
+    {
+        p = skip_spaces(p, end);
+        if (p == end)
+            return;
+        if (*p == ';') {
+            parse_comment(p + 1, end);
+            return;
+        }
+
+        const char letter = char(*p & ~0x20);
+        float      number = 0.0f;
+        const char *next  = parse_float(p + 1, end, number);
+        if (next == p + 1)
+            return;
+        const int code = int(number);
+        p              = next;
+
+        if (letter == 'G') {
+            switch (code) {
+            case 0:
+            case 1: parse_move(p, end, Line); break;
+            case 2: parse_move(p, end, Clockwise); break;
+            case 3: parse_move(p, end, CounterClockwise); break;
+            case 28: parse_home(p, end); break;
+            case 90: set_positioning(false); break;
+            case 91: set_positioning(true); break;
+            case 92: parse_set_position(p, end); break;
+            }
+        } else if (letter == 'M') {
+            switch (code) {
+            case 82: set_extrusion(false); break;
+            case 83: set_extrusion(true); break;
+            case 104:
+            case 109: {
+                float value;
+                if (find_param(p, end, 'S', value)) {
+                    m_state.temperature = value;
+                    set_known(Temperature);
+                }
+                break;
+            }
+            case 106: {
+                float value = 255.0f;
+                find_param(p, end, 'S', value);
+                m_state.fanspeed = 100.0f * value / 255.0f;
+                set_known(FanSpeed);
+                break;
+            }
+            case 107:
+                m_state.fanspeed = 0.0f;
+                set_known(FanSpeed);
+                break;
+            case 600: ++m_state.colorid; break;
+            }
+        } else if (letter == 'T') {
+            m_state.extruderid = unsigned(code);
+            set_known(Extruder);
+        }
+    }
+
+    void parse_comment(const char *p, const char *end)
+    {
+        float value;
+        if (starts_with(p, end, "TYPE:")) {
+            m_state.role = role_from_name(p + 5, end);
+            set_known(Role);
+        } else if (starts_with(p, end, "HEIGHT:")) {
+            if (parse_float(p + 7, end, value) != p + 7) {
+                m_state.height = value;
+                set_known(Height);
+            }
+        } else if (starts_with(p, end, "WIDTH:")) {
+            if (parse_float(p + 6, end, value) != p + 6) {
+                m_state.width = value;
+                set_known(Width);
+            }
+        }
+    }
+
+    // Finds the parameter with the given letter, stops at an inline comment
+    static bool find_param(const char *p, const char *end, char letter, float &value)
+    {
+        for (; p < end && *p != ';'; ++p) {
+            if (char(*p & ~0x20) == letter && parse_float(p + 1, end, value) != p + 1)
+                return true;
+        }
+        return false;
+    }
+
+    void set_positioning(bool relative)
+    {
+        m_state.relative_positioning = relative;
+        m_positioning_set            = true;
+    }
+
+    void set_extrusion(bool relative)
+    {
+        m_state.relative_extrusion = relative;
+        m_extrusion_set            = true;
+    }
+
+    void parse_move(const char *p, const char *end, ArcDirection arc)
+    {
+        bool      has_axis   = false;
+        float     e_delta    = 0.0f;
+        bool      e_known    = true;
+        bool      has_center = false;
+        glm::vec2 center_offset{0.0f};
+        float     radius = 0.0f;
+        while (p < end && *p != ';') {
+            const char letter = char(*p & ~0x20);
+            float      value;
+            const char *next = (letter >= 'A' && letter <= 'Z') ? parse_float(p + 1, end, value) : p + 1;
+            if (next == p + 1) {
+                ++p;
+                continue;
+            }
+            p = next;
+            switch (letter) {
+            case 'X':
+            case 'Y':
+            case 'Z': {
+                const Field axis = Field(letter - 'X');
+                if (!m_positioning_set)
+                    m_chunk.depends_on_positioning = true;
+                if (m_state.relative_positioning) {
+                    m_state.position[axis] += value;
+                } else {
+                    m_state.position[axis] = value;
+                    set_known(axis);
+                }
+                has_axis = true;
+                break;
+            }
+            case 'E': {
+                if (!m_extrusion_set)
+                    m_chunk.depends_on_extrusion = true;
+                if (m_state.relative_extrusion) {
+                    e_delta = value;
+                    m_state.e += value;
+                } else if ((m_unknown & field_bit(E)) != 0) {
+                    // the delta needs the E position of the previous chunk, keep the local offset in it
+                    e_delta = value - m_state.e;
+                    e_known = false;
+                    m_state.e = value;
+                    set_known(E);
+                } else {
+                    e_delta   = value - m_state.e;
+                    m_state.e = value;
+                }
+                break;
+            }
+            case 'F':
+                m_state.feedrate = value;
+                set_known(Feedrate);
+                break;
+            case 'I':
+            case 'J':
+                center_offset[letter - 'I'] = value;
+                has_center                  = true;
+                break;
+            case 'R':
+                radius     = value;
+                has_center = true;
+                break;
+            }
+        }
+        // an arc without an end point is a full circle, an arc without a center a line
+        if (arc != Line && !has_center)
+            arc = Line;
+        if (!has_axis && arc == Line)
+            return;
+        if (arc != Line)
+            m_chunk.has_arcs = true;
+
+        Move move;
+        move.position    = m_state.position;
+        move.e_delta     = e_delta;
+        move.feedrate    = m_state.feedrate;
+        move.fanspeed    = m_state.fanspeed;
+        move.temperature = m_state.temperature;
+        move.height      = m_state.height;
+        move.width       = m_state.width;
+        move.role        = m_state.role;
+        move.extruderid  = m_state.extruderid;
+        move.colorid     = m_state.colorid;
+        move.unknown       = (m_unknown & ~field_bit(E)) | (e_known ? 0 : field_bit(E));
+        move.arc           = arc;
+        move.center_offset = center_offset;
+        move.radius        = radius;
+        m_chunk.moves.push_back(move);
+    }
+
+    void parse_home(const char *p, const char *end)
+    {
+        bool any = false;
+        for (; p < end && *p != ';'; ++p) {
+            const char letter = char(*p & ~0x20);
+            if (letter >= 'X' && letter <= 'Z') {
+                m_state.position[letter - 'X'] = 0.0f;
+                set_known(Field(letter - 'X'));
+                any = true;
+            }
+        }
+        if (!any) {
+            m_state.position = glm::vec3(0.0f);
+            set_known(X);
+            set_known(Y);
+            set_known(Z);
+        }
+    }
+
+    void parse_set_position(const char *p, const char *end)
+    {
+        while (p < end && *p != ';') {
+            const char letter = char(*p & ~0x20);
+            float      value;
+            const char *next = (letter >= 'E' && letter <= 'Z') ? parse_float(p + 1, end, value) : p + 1;
+            if (next == p + 1) {
+                ++p;
+                continue;
+            }
+            p = next;
+            if (letter >= 'X' && letter <= 'Z') {
+                m_state.position[letter - 'X'] = value;
+                set_known(Field(letter - 'X'));
+            } else if (letter == 'E') {
+                m_state.e = value;
+                set_known(E);
+            }
+        }
+    }
+};
+
+// State at the end of a chunk, given the state it starts with
+static State propagate(const Chunk &chunk, const State &incoming)
+{
+    const State &last = chunk.last;
+    State        out  = last;
+    for (int axis = 0; axis < 3; ++axis)
+        if ((chunk.unknown & field_bit(Field(axis))) != 0)
+            out.position[axis] = incoming.position[axis] + last.position[axis];
+    if ((chunk.unknown & field_bit(E)) != 0) out.e = incoming.e + last.e;
+    if ((chunk.unknown & field_bit(Feedrate)) != 0) out.feedrate = incoming.feedrate;
+    if ((chunk.unknown & field_bit(FanSpeed)) != 0) out.fanspeed = incoming.fanspeed;
+    if ((chunk.unknown & field_bit(Temperature)) != 0) out.temperature = incoming.temperature;
+    if ((chunk.unknown & field_bit(Height)) != 0) out.height = incoming.height;
+    if ((chunk.unknown & field_bit(Width)) != 0) out.width = incoming.width;
+    if ((chunk.unknown & field_bit(Role)) != 0) out.role = incoming.role;
+    if ((chunk.unknown & field_bit(Extruder)) != 0) out.extruderid = incoming.extruderid;
+    out.colorid = incoming.colorid + last.colorid;
+    if (!chunk.sets_positioning) out.relative_positioning = incoming.relative_positioning;
+    if (!chunk.sets_extrusion) out.relative_extrusion = incoming.relative_extrusion;
+    return out;
+}
+
+// End point of a move resolved against the state its chunk starts with
+static glm::vec3 resolve_position(const Move &move, const State &incoming)
+{
+    glm::vec3 position;
+    for (int axis = 0; axis < 3; ++axis)
+        position[axis] = (move.unknown & field_bit(Field(axis))) != 0 ? incoming.position[axis] + move.position[axis] : move.position[axis];
+    return position;
+}
+
+// Fills the attributes of a PathPoint from a move resolved against the state its chunk starts with
+static void resolve(const Move &move, const State &incoming, gcode::PathPoint &attributes, glm::vec3 &position)
+{
+    auto pick = [&](Field field, float local, float in) { return (move.unknown & field_bit(field)) != 0 ? in : local; };
+    position  = resolve_position(move, incoming);
+
+    const float e_delta = (move.unknown & field_bit(E)) != 0 ? move.e_delta - incoming.e : move.e_delta;
+    const float height  = pick(Height, move.height, incoming.height);
+    const float width   = pick(Width, move.width, incoming.width);
+    const float speed   = pick(Feedrate, move.feedrate, incoming.feedrate) / 60.0f;
+    const bool  extrude = e_delta > 0.0f;
+
+    attributes.encode_flags(extrude ? ((move.unknown & field_bit(Role)) != 0 ? incoming.role : move.role) : (e_delta < 0.0f ? Travel_Retract : Travel_Move),
+                            extrude ? Type_Extrude : Type_Travel);
+    attributes.height      = height;
+    attributes.width       = width;
+    attributes.speed       = speed;
+    attributes.fanspeed    = pick(FanSpeed, move.fanspeed, incoming.fanspeed);
+    attributes.temperature = pick(Temperature, move.temperature, incoming.temperature);
+    // cross section of an extrusion as rectangle with semicircular ends
+    attributes.volumetricrate = extrude ? ((width - height) * height + 0.25f * 3.14159265f * height * height) * speed : 0.0f;
+    attributes.extruderid     = (move.unknown & field_bit(Extruder)) != 0 ? incoming.extruderid : move.extruderid;
+    attributes.colorid        = incoming.colorid + move.colorid;
+}
+
+struct ArcGeometry
+{
+    glm::vec2 center;
+    float     radius;
+    float     start_angle;
+    float     sweep; // negative for clockwise arcs
+};
+
+static ArcGeometry arc_geometry(const Move &move, const glm::vec3 &start, const glm::vec3 &end)
+{
+    const glm::vec2 from(start), to(end);
+    const bool      clockwise = move.arc == Clockwise;
+    ArcGeometry     arc;
+    arc.center = from + move.center_offset;
+    if (move.radius != 0.0f) {
+        // the center is on the bisector of the chord, a positive radius takes the shorter arc
+        const glm::vec2 chord    = to - from;
+        const float     length   = glm::length(chord);
+        const float     offset2  = (move.radius - 0.5f * length) * (move.radius + 0.5f * length);
+        const float     offset   = offset2 > 0.0f ? std::sqrt(offset2) : 0.0f;
+        const float     side     = clockwise != (move.radius < 0.0f) ? -1.0f : 1.0f;
+        const glm::vec2 bisector = length > 0.0f ? glm::vec2(-chord.y, chord.x) / length : glm::vec2(0.0f);
+        arc.center               = 0.5f * (from + to) + side * offset * bisector;
+    }
+    arc.radius      = glm::length(from - arc.center);
+    arc.start_angle = std::atan2(from.y - arc.center.y, from.x - arc.center.x);
+    arc.sweep       = std::atan2(to.y - arc.center.y, to.x - arc.center.x) - arc.start_angle;
+    // an arc ending where it starts is a full circle
+    const float turn = 2.0f * glm::pi<float>();
+    if (from == to)
+        arc.sweep = clockwise ? -turn : turn;
+    else if (clockwise && arc.sweep > 0.0f)
+        arc.sweep -= turn;
+    else if (!clockwise && arc.sweep < 0.0f)
+        arc.sweep += turn;
+    return arc;
+}
+
+// Fewest chords staying within tolerance of the arc, a chord spanning the angle a is r (1 - cos(a / 2)) away from it
+static size_t arc_segments(const ArcGeometry &arc, float tolerance)
+{
+    const float step     = arc.radius > tolerance ? 2.0f * std::acos(1.0f - tolerance / arc.radius) : glm::pi<float>();
+    const float segments = std::ceil(std::abs(arc.sweep) / step);
+    return segments >= 1.0f ? std::min(size_t(segments), Max_Arc_Segments) : 1;
+}
+
+// Positions of points [1, count) of an arc cut into count chords, their attributes are those of points[0]
+static void tessellate(const ArcGeometry &arc, const glm::vec3 &start, const glm::vec3 &end, size_t count, gcode::PathPoint *points)
+{
+    for (size_t k = 1; k < count; ++k) {
+        const float t     = float(k) / float(count);
+        const float angle = arc.start_angle + arc.sweep * t;
+        // points[0].position belongs to the previous move, only the attributes are copied
+        std::memcpy(&points[k].flags, &points[0].flags, sizeof(gcode::PathPoint) - offsetof(gcode::PathPoint, flags));
+        points[k].position = glm::vec3(arc.center + arc.radius * glm::vec2(std::cos(angle), std::sin(angle)), start.z + (end.z - start.z) * t);
+    }
+}
+
+// Number of points added by the moves of a chunk, an arc adds one per chord
+static void count_points(Chunk &chunk, const State &incoming, float arc_tolerance)
+{
+    chunk.first_point.clear();
+    if (!chunk.has_arcs) {
+        chunk.points_count = chunk.moves.size();
+        return;
+    }
+    chunk.first_point.resize(chunk.moves.size() + 1, 0);
+    glm::vec3 start = incoming.position;
+    for (size_t m = 0; m < chunk.moves.size(); ++m) {
+        const Move     &move     = chunk.moves[m];
+        const glm::vec3 end      = resolve_position(move, incoming);
+        const size_t    segments = move.arc == Line ? 1 : arc_segments(arc_geometry(move, start, end), arc_tolerance);
+        chunk.first_point[m + 1] = chunk.first_point[m] + segments;
+        start                    = end;
+    }
+    chunk.points_count = chunk.first_point.back();
+}
+
+// Splits the text into chunks of roughly chunk_size bytes ending at a newline, the first one of head_size bytes
+static std::vector<Chunk> split(const char *data, size_t size, size_t chunk_size, size_t head_size)
+{
+    std::vector<Chunk> chunks;
+    const char        *end   = data + size;
+    const char        *begin = data;
+    while (begin < end) {
+        const size_t limit     = chunks.empty() ? head_size : chunk_size;
+        const char  *chunk_end = size_t(end - begin) > limit ? begin + limit : end;
+        if (chunk_end < end) {
+            const char *newline = static_cast<const char *>(std::memchr(chunk_end, '\n', size_t(end - chunk_end)));
+            chunk_end           = newline != nullptr ? newline + 1 : end;
+        }
+        Chunk chunk;
+        chunk.begin = begin;
+        chunk.end   = chunk_end;
+        chunks.push_back(std::move(chunk));
+        begin = chunk_end;
+    }
+    return chunks;
+}
+
+// Parser fed with consecutive pieces of the text, each ending at a newline. The points are appended as soon as they are complete,
+// the last one is held back until the next move (or finish) gives its attributes.
+class StreamParser
+{
+public:
+    explicit StreamParser(float arc_tolerance = Default_Arc_Tolerance) : m_arc_tolerance(arc_tolerance) {}
+
+    void parse(const char *data, size_t size, std::vector<gcode::PathPoint> &out, size_t chunk_size = Default_Chunk_Size)
+    {
+        std::vector<Chunk> chunks = split(data, size, chunk_size, size > chunk_size ? std::min(chunk_size, Head_Chunk_Size) : chunk_size);
+        if (chunks.empty())
+            return;
+
+        // The first chunk, a small one holding the start G-code of a file, starts from the incoming modes. The others
+        // assume the modes it ends with and are all parsed at once.
+        chunks.front().assumed_relative_positioning = m_incoming.relative_positioning;
+        chunks.front().assumed_relative_extrusion   = m_incoming.relative_extrusion;
+        ChunkParser(chunks.front()).parse();
+        const State first_out = propagate(chunks.front(), m_incoming);
+        for (size_t i = 1; i < chunks.size(); ++i) {
+            chunks[i].assumed_relative_positioning = first_out.relative_positioning;
+            chunks[i].assumed_relative_extrusion   = first_out.relative_extrusion;
+        }
+        std::for_each(std::execution::par, chunks.begin() + 1, chunks.end(), [](Chunk &chunk) { ChunkParser(chunk).parse(); });
+
+        // modal state fix-up between chunks: the modes a chunk sets do not depend on the ones it assumed, so the
+        // chunks whose moves depend on a wrongly assumed mode are all known at once and parsed again at once
+        std::vector<size_t> wrong;
+        bool                relative_positioning = first_out.relative_positioning, relative_extrusion = first_out.relative_extrusion;
+        for (size_t i = 1; i < chunks.size(); ++i) {
+            Chunk &chunk = chunks[i];
+            if ((chunk.depends_on_positioning && chunk.assumed_relative_positioning != relative_positioning) ||
+                (chunk.depends_on_extrusion && chunk.assumed_relative_extrusion != relative_extrusion)) {
+                chunk.assumed_relative_positioning = relative_positioning;
+                chunk.assumed_relative_extrusion   = relative_extrusion;
+                wrong.push_back(i);
+            }
+            if (chunk.sets_positioning)
+                relative_positioning = chunk.last.relative_positioning;
+            if (chunk.sets_extrusion)
+                relative_extrusion = chunk.last.relative_extrusion;
+        }
+        std::for_each(std::execution::par, wrong.begin(), wrong.end(), [&](size_t i) { ChunkParser(chunks[i]).parse(); });
+
+        std::vector<State> incoming(chunks.size());
+        incoming[0] = m_incoming;
+        for (size_t i = 1; i < chunks.size(); ++i) incoming[i] = propagate(chunks[i - 1], incoming[i - 1]);
+        m_incoming = propagate(chunks.back(), incoming.back());
+
+        // arcs need their resolved start to know how many points they add
+        std::vector<size_t> indices(chunks.size());
+        std::iota(indices.begin(), indices.end(), 0);
+        std::for_each(std::execution::par, indices.begin(), indices.end(), [&](size_t i) { count_points(chunks[i], incoming[i], m_arc_tolerance); });
+        std::vector<size_t> first_point(chunks.size() + 1, 0);
+        for (size_t i = 0; i < chunks.size(); ++i) first_point[i + 1] = first_point[i] + chunks[i].points_count;
+
+        // the held back point gets the attributes of the first move, every move adds the point it ends at
+        const size_t points_count = first_point.back();
+        if (points_count == 0)
+            return;
+        const size_t first = out.size();
+        out.resize(first + points_count + 1, gcode::PathPoint{});
+        out[first] = m_pending;
+        gcode::PathPoint *points = out.data() + first;
+        std::for_each(std::execution::par, indices.begin(), indices.end(), [&](size_t i) {
+            const Chunk &chunk = chunks[i];
+            glm::vec3    start = incoming[i].position;
+            for (size_t m = 0; m < chunk.moves.size(); ++m) {
+                const size_t index = first_point[i] + (chunk.has_arcs ? chunk.first_point[m] : m);
+                const size_t count = chunk.has_arcs ? chunk.first_point[m + 1] - chunk.first_point[m] : 1;
+                glm::vec3    end;
+                resolve(chunk.moves[m], incoming[i], points[index], end);
+                if (count > 1)
+                    tessellate(arc_geometry(chunk.moves[m], start, end), start, end, count, points + index);
+                points[index + count].position = end;
+                start                          = end;
+            }
+        });
+        m_pending = out.back();
+        out.pop_back();
+        m_previous     = out.back();
+        m_moves_count += points_count;
+    }
+
+    // Appends the held back point, nothing starts at it
+    void finish(std::vector<gcode::PathPoint> &out)
+    {
+        gcode::PathPoint last = m_pending;
+        last.encode_flags(Travel_Move, Type_Travel);
+        if (m_moves_count > 0) {
+            last.height      = m_previous.height;
+            last.width       = m_previous.width;
+            last.fanspeed    = m_previous.fanspeed;
+            last.temperature = m_previous.temperature;
+            last.extruderid  = m_previous.extruderid;
+            last.colorid     = m_previous.colorid;
+        }
+        out.push_back(last);
+    }
+
+private:
+    float            m_arc_tolerance;
+    State            m_incoming;
+    gcode::PathPoint m_pending{}; // point 0 is where the printer starts
+    gcode::PathPoint m_previous{};
+    size_t           m_moves_count{0};
+};
+
+static std::vector<gcode::PathPoint> parse(const char *data, size_t size, size_t chunk_size = Default_Chunk_Size,
+                                           float arc_tolerance = Default_Arc_Tolerance)
+{
+    std::vector<gcode::PathPoint> points;
+    if (size == 0)
+        return points;
+    StreamParser parser(arc_tolerance);
+    parser.parse(data, size, points, chunk_size);
+    parser.finish(points);
+    return points;
+}
+
+static bool is_gcode_file(const std::string &filename)
+{
+    auto ends_with = [&](const std::string &suffix) {
+        return filename.size() >= suffix.size() &&
+               std::equal(suffix.rbegin(), suffix.rend(), filename.rbegin(), [](char a, char b) { return std::tolower(a) == b; });
+    };
+    return ends_with(".gcode") || ends_with(".gco") || ends_with(".g");
+}
+
+// Blocks of the file read while the previous one is parsed, large enough for every thread to parse a chunk of each
+static size_t read_block_size() { return std::min(Default_Chunk_Size * std::max(1u, std::thread::hardware_concurrency()), size_t(64) << 20); }
+
+// Parses the blocks of the reader as they arrive, the following ones are read meanwhile. A line cut by the end of a block
+// is completed with the start of the next one. The points are appended to out and consume(out) is called after every
+// block, and once more with the held back last point. Returns false when a read fails or consume returns false.
+template<typename Consume>
+static bool parse_blocks(async_reader::BlockReader &reader, std::vector<gcode::PathPoint> &out, Consume &&consume,
+                         size_t chunk_size = Default_Chunk_Size, float arc_tolerance = Default_Arc_Tolerance)
+{
+    StreamParser parser(arc_tolerance);
+    std::string  line; // start of the line the previous block ended in
+    for (Span<const char> block = reader.next(); !block.empty(); block = reader.next()) {
+        const char *begin = block.data();
+        const char *end   = block.data() + block.size();
+        if (!line.empty()) {
+            const char *newline = static_cast<const char *>(std::memchr(begin, '\n', block.size()));
+            if (newline == nullptr) {
+                line.append(begin, end);
+                continue;
+            }
+            line.append(begin, newline + 1);
+            parser.parse(line.data(), line.size(), out, chunk_size);
+            line.clear();
+            begin = newline + 1;
+        }
+        const char *complete = end;
+        while (complete > begin && complete[-1] != '\n') --complete;
+        parser.parse(begin, size_t(complete - begin), out, chunk_size);
+        line.assign(complete, end);
+        if (!consume(out))
+            return false;
+    }
+    if (reader.failed())
+        return false;
+    parser.parse(line.data(), line.size(), out, chunk_size);
+    if (reader.size() > 0)
+        parser.finish(out);
+    return consume(out);
+}
+
+static std::vector<gcode::PathPoint> parse_file(const std::string &filename, size_t chunk_size = Default_Chunk_Size)
+{
+    async_reader::BlockReader     reader;
+    std::vector<gcode::PathPoint> points;
+    if (reader.open(filename, read_block_size()))
+        parse_blocks(reader, points, [](std::vector<gcode::PathPoint> &) { return true; }, chunk_size);
+    return points;
+}
+
+} // namespace parser
+
+#endif /* PARSER_H_ */
@@ -0,0 +1,211 @@
+#ifndef SCENE_H_
+#define SCENE_H_
+
+#include "bgcode.h"
+#include "container.h"
+#include "gcode.h"
+#include "loader.h"
+#include "parser.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <execution>
+#include <iostream>
+#include <numeric>
+#include <string>
+#include <vector>
+
+// Several prints on one plate. The objects are loaded in parallel, each is placed with its own transform and they are
+// concatenated into a single path, so they share the visibility boxes and an object in front culls the segments of
+// the objects behind it. The last point of every object becomes a travel move, the segment joining two objects is
+// never extruded.
+namespace scene {
+
+// Rotation around Z by angle degrees about the center of the object, then translation by offset
+struct Placement
+{
+    glm::vec3 offset{0.0f};
+    float     angle{0.0f};
+    bool      given{false};
+};
+
+struct Object
+{
+    std::string filename;
+    Placement   placement;
+    // points [first, first + count) of the scene
+    size_t      first{0};
+    size_t      count{0};
+    glm::vec3   min{FLT_MAX};
+    glm::vec3   max{-FLT_MAX};
+};
+
+// "file.gcode" or "file.gcode@x,y[,z[,angle]]"
+static Object parse_object_argument(const std::string &argument)
+{
+    Object       object;
+    const size_t at = argument.rfind('@');
+    object.filename = argument.substr(0, at);
+    if (at == std::string::npos)
+        return object;
+
+    float  values[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+    size_t count     = 0;
+    for (size_t begin = at + 1; begin <= argument.size() && count < 4; ++count) {
+        const size_t end = std::min(argument.find(',', begin), argument.size());
+        values[count]    = std::strtof(argument.substr(begin, end - begin).c_str(), nullptr);
+        begin            = end + 1;
+    }
+    object.placement = {{values[0], values[1], values[2]}, values[3], true};
+    return object;
+}
+
+// Points of a path container, binary G-code, G-code or legacy dump, empty when it cannot be read
+static std::vector<gcode::PathPoint> load_points(const std::string &filename)
+{
+    if (container::is_container(filename)) {
+        gcode::PathStore columns;
+        return container::read(filename, columns) ? gcode::to_path_points(columns) : std::vector<gcode::PathPoint>{};
+    }
+    if (bgcode::is_bgcode_file(filename))
+        return bgcode::parse_file(filename);
+    if (parser::is_gcode_file(filename))
+        return parser::parse_file(filename);
+    loader::PathPointsFile file;
+    if (!file.open(filename))
+        return {};
+    return {file.points().begin(), file.points().end()};
+}
+
+// Columns in the mask of a file of any of the formats above. Path containers read only these columns, the points of the
+// other formats are loaded and the columns extracted from them.
+static bool load_columns(const std::string &filename, unsigned int mask, gcode::PathStore &columns)
+{
+    columns = {};
+    if (container::is_container(filename)) {
+        container::Reader reader;
+        return reader.open(filename) && reader.load_columns(columns, mask);
+    }
+    if (!bgcode::is_bgcode_file(filename) && !parser::is_gcode_file(filename)) {
+        loader::PathPointsFile file;
+        if (!file.open(filename))
+            return false;
+        columns = gcode::to_columns(file.points(), mask);
+        return true;
+    }
+    const std::vector<gcode::PathPoint> points = load_points(filename);
+    columns                                    = gcode::to_columns(points, mask);
+    return !points.empty();
+}
+
+static void update_bounds(Object &object, Span<const glm::vec3> positions)
+{
+    object.min = glm::vec3(FLT_MAX);
+    object.max = glm::vec3(-FLT_MAX);
+    gcode::update_bounds(object.min, object.max, positions);
+}
+
+// Objects without a placement are laid out on a grid next to each other, keeping their heights
+static void arrange(std::vector<Object> &objects, float gap)
+{
+    glm::vec2 cell{0.0f};
+    size_t    unplaced = 0;
+    for (const Object &object : objects) {
+        if (object.placement.given || object.count == 0)
+            continue;
+        cell = glm::max(cell, glm::vec2(object.max - object.min) + gap);
+        ++unplaced;
+    }
+    const size_t columns = size_t(std::ceil(std::sqrt(double(unplaced))));
+    size_t       slot    = 0;
+    for (Object &object : objects) {
+        if (object.placement.given || object.count == 0)
+            continue;
+        const glm::vec2 corner{float(slot % columns) * cell.x, float(slot / columns) * cell.y};
+        object.placement.offset = glm::vec3(corner - glm::vec2(object.min), 0.0f);
+        ++slot;
+    }
+}
+
+static void transform(const Placement &placement, glm::vec3 center, Span<glm::vec3> positions)
+{
+    const float c = std::cos(glm::radians(placement.angle)), s = std::sin(glm::radians(placement.angle));
+    std::for_each(std::execution::par_unseq, positions.begin(), positions.end(), [&](glm::vec3 &p) {
+        const glm::vec2 r = glm::vec2(p) - glm::vec2(center);
+        p                 = glm::vec3(c * r.x - s * r.y + center.x, s * r.x + c * r.y + center.y, p.z) + placement.offset;
+    });
+}
+
+// Loads and places all the objects, returns the columns in the mask of the whole scene. The position and flags columns
+// are always loaded. Objects that cannot be read are left empty.
+static gcode::PathStore load_objects(std::vector<Object> &objects, unsigned int mask = gcode::Core_Columns, float gap = 10.0f)
+{
+    mask |= gcode::column_bit(gcode::Column::Position) | gcode::column_bit(gcode::Column::Flags);
+
+    // every file is parsed in parallel with the others and in parallel chunks itself, so the cores are kept busy
+    // whether there are a few large files or many small ones
+    std::vector<gcode::PathStore> loaded(objects.size());
+    std::vector<size_t>             indices(objects.size());
+    std::iota(indices.begin(), indices.end(), 0);
+    std::for_each(std::execution::par, indices.begin(), indices.end(), [&](size_t i) {
+        if (!load_columns(objects[i].filename, mask, loaded[i]))
+            loaded[i] = {};
+        objects[i].count = loaded[i].count;
+        update_bounds(objects[i], loaded[i].position);
+    });
+
+    arrange(objects, gap);
+    std::for_each(std::execution::par, indices.begin(), indices.end(), [&](size_t i) {
+        if (loaded[i].count == 0)
+            return;
+        transform(objects[i].placement, 0.5f * (objects[i].min + objects[i].max), loaded[i].position);
+        update_bounds(objects[i], loaded[i].position);
+        loaded[i].flags.back() = gcode::PathPoint{}.encode_flags(0, 8);
+    });
+
+    gcode::PathStore columns;
+    for (Object &object : objects) {
+        object.first = columns.count;
+        columns.count += object.count;
+    }
+    for (unsigned int c = 0; c < static_cast<unsigned int>(gcode::Column::Count); ++c)
+        if ((mask & gcode::column_bit(static_cast<gcode::Column>(c))) != 0)
+            columns.resize_column(static_cast<gcode::Column>(c));
+    std::for_each(std::execution::par, indices.begin(), indices.end(), [&](size_t i) {
+        columns.copy_columns(loaded[i], mask, objects[i].first);
+        loaded[i] = {};
+    });
+    return columns;
+}
+
+// Loads the columns in the mask which the scene does not hold yet, from the files of its objects
+static bool fetch_columns(const std::vector<Object> &objects, unsigned int mask, gcode::PathStore &columns)
+{
+    mask &= ~columns.loaded_columns;
+    if (mask == 0)
+        return true;
+    // the columns are allocated up front, the objects fill their rows in parallel
+    for (unsigned int c = 0; c < static_cast<unsigned int>(gcode::Column::Count); ++c)
+        if ((mask & gcode::column_bit(static_cast<gcode::Column>(c))) != 0)
+            columns.resize_column(static_cast<gcode::Column>(c));
+
+    std::vector<char> fetched(objects.size(), 0);
+    std::vector<size_t> indices(objects.size());
+    std::iota(indices.begin(), indices.end(), 0);
+    std::for_each(std::execution::par, indices.begin(), indices.end(), [&](size_t i) {
+        gcode::PathStore object_columns;
+        if (objects[i].count == 0 || (load_columns(objects[i].filename, mask, object_columns) && object_columns.count == objects[i].count)) {
+            columns.copy_columns(object_columns, mask, objects[i].first);
+            fetched[i] = 1;
+        }
+    });
+    const bool all_fetched = std::all_of(fetched.begin(), fetched.end(), [](char f) { return f != 0; });
+    if (!all_fetched)
+        std::cerr << "Cannot fetch the columns of every object, the file changed or is not readable anymore" << std::endl;
+    return all_fetched;
+}
+
+} // namespace scene
+
+#endif /* SCENE_H_ */
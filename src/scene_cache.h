@@ -0,0 +1,389 @@
+#ifndef SCENE_CACHE_H_
+#define SCENE_CACHE_H_
+
+#include "gcode.h"
+#include "loader.h"
+#include "span.h"
+
+#include <array>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <execution>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <numeric>
+#include <string>
+#include <vector>
+
+// Persistent cache of what bufferExtrusionPaths computes on the CPU: the core columns of the points, their
+// height/width/angle, the valid lines and the visibility boxes with their segments and geometry.
+// The cache file is named after a key made from the path, size and modification time of the input file, its first and
+// last Edge_Size bytes and the voxel settings, so that looking it up costs the same for any input size. The hash of the
+// whole input content is stored in the header and checked against the input in the background, a cache file whose input
+// changed is removed. On a hit the file is memory mapped and uploaded to the GPU as it is, no parsing nor voxelization
+// happens.
+//
+// Layout (host byte order, the cache is not meant to be moved between machines):
+//   128 byte header: "GCSC", u32 version, u64 key, u64 points, u64 boxes, u64 box runs, u64 valid line blocks,
+//                   f64 milliseconds the preprocessing took, u64 box segments, f32 voxel size, u32 reserved,
+//                   u64 input content hash, reserved
+//   64 byte aligned sections: positions (vec3), flags (u32), heights (f32), widths (f32), height/width/angle (vec3),
+//                   valid line blocks (u64),
+//                   box coordinates (ivec3), box run offsets (u64, boxes + 1), box runs (u32 first segment),
+//                   box run lengths (u8, segments - 1), box vertices (vec4, 8 per box), box indices (u32, 36 per box)
+// The other attribute columns are not cached, they are fetched from the input file when a visualization needs them.
+// Scenes of 2^32 points or more are not cached, their box segments do not fit in 32 bits.
+namespace scene_cache {
+
+static const char     Magic[4]    = {'G', 'C', 'S', 'C'};
+static const uint32_t Version     = 5;
+static const size_t   Header_Size = 128;
+static const size_t   Alignment   = 64;
+static const size_t   Edge_Size   = size_t(1) << 20;
+
+static const size_t Box_Vertices = std::size(gcode::unit_box_vertices);
+static const size_t Box_Indices  = std::size(gcode::unit_box_indices);
+
+// xxHash64 style hash, four independent lanes keep the multipliers busy
+static uint64_t hash_block(const char *data, size_t size, uint64_t seed)
+{
+    const uint64_t P1 = 0x9E3779B185EBCA87ULL, P2 = 0xC2B2AE3D27D4EB4FULL, P3 = 0x165667B19E3779F9ULL;
+    auto           rotl  = [](uint64_t x, int r) { return (x << r) | (x >> (64 - r)); };
+    auto           round = [&](uint64_t acc, uint64_t word) { return rotl(acc + word * P2, 31) * P1; };
+
+    uint64_t lanes[4] = {seed + P1 + P2, seed + P2, seed, seed - P1};
+    size_t   i        = 0;
+    for (; i + 32 <= size; i += 32) {
+        uint64_t words[4];
+        std::memcpy(words, data + i, sizeof(words));
+        for (int l = 0; l < 4; ++l) lanes[l] = round(lanes[l], words[l]);
+    }
+    uint64_t h = rotl(lanes[0], 1) + rotl(lanes[1], 7) + rotl(lanes[2], 12) + rotl(lanes[3], 18) + size;
+    for (; i + 8 <= size; i += 8) {
+        uint64_t word;
+        std::memcpy(&word, data + i, sizeof(word));
+        h = rotl(h ^ round(0, word), 27) * P1 + P3;
+    }
+    for (; i < size; ++i) h = rotl(h ^ (uint8_t(data[i]) * P3), 11) * P1;
+    h ^= h >> 33;
+    h *= P2;
+    h ^= h >> 29;
+    h *= P3;
+    return h ^ (h >> 32);
+}
+
+// Hash of the data, blocks are hashed in parallel and combined in order
+static uint64_t content_hash(const char *data, size_t size)
+{
+    const size_t          block_size = size_t(1) << 22;
+    std::vector<uint64_t> hashes((size + block_size - 1) / block_size);
+    std::vector<size_t>   blocks(hashes.size());
+    std::iota(blocks.begin(), blocks.end(), 0);
+    std::for_each(std::execution::par, blocks.begin(), blocks.end(), [&](size_t b) {
+        hashes[b] = hash_block(data + b * block_size, std::min(block_size, size - b * block_size), b);
+    });
+    return hash_block(reinterpret_cast<const char *>(hashes.data()), hashes.size() * sizeof(uint64_t), size);
+}
+
+// Settings the preprocessing depends on: the voxel size, or the targets it is tuned for
+static std::array<float, 3> voxel_settings()
+{
+    if (config::auto_voxel_size)
+        return {0.0f, config::target_segments_per_voxel, float(config::max_visibility_boxes)};
+    return {config::voxel_size, 0.0f, 0.0f};
+}
+
+// Hash of the whole content of the input file, 0 if the file cannot be read
+static uint64_t file_content_hash(const std::string &filename)
+{
+    loader::MappedFile file;
+    if (!file.open(filename))
+        return 0;
+    const uint64_t hash = content_hash(file.data(), file.size());
+    return hash != 0 ? hash : 1;
+}
+
+// Cache key of an input file for the given voxel settings, 0 if the file cannot be read. Only the metadata of the file and
+// its first and last Edge_Size bytes are read.
+static uint64_t file_key(const std::string &filename, const std::array<float, 3> &settings)
+{
+    std::error_code             error;
+    const std::filesystem::path path = std::filesystem::absolute(filename, error);
+    const uint64_t              size = error ? 0 : uint64_t(std::filesystem::file_size(path, error));
+    if (error || size == 0)
+        return 0;
+    const auto modified = std::filesystem::last_write_time(path, error);
+    if (error)
+        return 0;
+
+    std::ifstream file(path, std::ios::binary);
+    std::string   edges(size_t(std::min<uint64_t>(size, 2 * Edge_Size)), '\0');
+    const size_t  head = std::min(edges.size(), Edge_Size);
+    file.read(edges.data(), std::streamsize(head));
+    file.seekg(std::streamoff(size - (edges.size() - head)));
+    file.read(edges.data() + head, std::streamsize(edges.size() - head));
+    if (!file)
+        return 0;
+
+    const std::string path_name    = path.string();
+    const uint64_t    parameters[] = {hash_block(edges.data(), edges.size(), 0), size, uint64_t(modified.time_since_epoch().count()), Version,
+                                      uint64_t(sizeof(gcode::PathPoint))};
+    uint64_t          key          = hash_block(reinterpret_cast<const char *>(parameters), sizeof(parameters), 0);
+    key                            = hash_block(path_name.data(), path_name.size(), key);
+    key                            = hash_block(reinterpret_cast<const char *>(settings.data()), sizeof(settings), key);
+    return key != 0 ? key : 1;
+}
+
+// Directory of the cache files, GCODE_VIEWER_CACHE overrides the default one in the working directory
+static std::filesystem::path cache_directory()
+{
+    const char *directory = std::getenv("GCODE_VIEWER_CACHE");
+    return directory != nullptr && directory[0] != '\0' ? std::filesystem::path(directory) : std::filesystem::path("gcode_viewer_cache");
+}
+
+static std::filesystem::path cache_filename(uint64_t key)
+{
+    char name[32];
+    std::snprintf(name, sizeof(name), "%016llx.scene", static_cast<unsigned long long>(key));
+    return cache_directory() / name;
+}
+
+struct Header
+{
+    char     magic[4];
+    uint32_t version;
+    uint64_t key;
+    uint64_t points_count;
+    uint64_t boxes_count;
+    uint64_t box_runs_count;
+    uint64_t valid_blocks_count;
+    double   preprocessing_ms;
+    uint64_t box_segments_count;
+    float    voxel_size;
+    uint32_t reserved0;
+    uint64_t content_hash;
+    uint32_t reserved[12];
+};
+static_assert(sizeof(Header) == Header_Size, "the cache header is 128 bytes");
+
+// Byte offsets of the sections, computed the same way when writing and reading
+struct Layout
+{
+    enum Section { Positions, Flags, Heights, Widths, HeightWidthAngle, ValidBlocks, BoxCoords, BoxOffsets, BoxRuns, BoxRunLengths, BoxVertices, BoxIndices, Count };
+
+    uint64_t offsets[Count];
+    uint64_t sizes[Count];
+    uint64_t file_size;
+
+    explicit Layout(const Header &header)
+    {
+        sizes[Positions]        = header.points_count * sizeof(glm::vec3);
+        sizes[Flags]            = header.points_count * sizeof(uint32_t);
+        sizes[Heights]          = header.points_count * sizeof(float);
+        sizes[Widths]           = header.points_count * sizeof(float);
+        sizes[HeightWidthAngle] = header.points_count * sizeof(glm::vec3);
+        sizes[ValidBlocks]      = header.valid_blocks_count * sizeof(uint64_t);
+        sizes[BoxCoords]        = header.boxes_count * sizeof(glm::ivec3);
+        sizes[BoxOffsets]       = (header.boxes_count + 1) * sizeof(uint64_t);
+        sizes[BoxRuns]          = header.box_runs_count * sizeof(uint32_t);
+        sizes[BoxRunLengths]    = header.box_runs_count * sizeof(uint8_t);
+        sizes[BoxVertices]      = header.boxes_count * Box_Vertices * sizeof(glm::vec4);
+        sizes[BoxIndices]       = header.boxes_count * Box_Indices * sizeof(GLuint);
+        uint64_t offset         = Header_Size;
+        for (int s = 0; s < Count; ++s) {
+            offsets[s] = offset;
+            offset     = (offset + sizes[s] + Alignment - 1) / Alignment * Alignment;
+        }
+        file_size = offset;
+    }
+};
+
+// Writes the preprocessed scene of the input whose content has the given hash. The file is written next to its final name
+// and renamed once complete, so an interrupted write never leaves a truncated cache behind.
+static bool write(uint64_t key, uint64_t content, const gcode::PathStore &columns, Span<const glm::vec3> height_width_angle, const bitset::BitSet<> &valid_lines,
+                  const std::vector<glm::ivec3> &box_coords, const gcode::BoxSegmentIndex &boxes, double preprocessing_ms)
+{
+    assert(height_width_angle.size() == columns.count && (columns.loaded_columns & gcode::Core_Columns) == gcode::Core_Columns);
+    if (columns.count > size_t(UINT32_MAX)) {
+        std::cerr << "The scene has too many points to be cached" << std::endl;
+        return false;
+    }
+
+    // the index in a single dense level of absolute segments, the runs split by the levels are joined
+    gcode::BoxSegmentIndex::Level level;
+    level.row_starts.reserve(box_coords.size() + 1);
+    level.runs.reserve(boxes.runs());
+    level.run_lengths.reserve(boxes.runs());
+    for (size_t b = 0; b < box_coords.size(); ++b) {
+        const size_t row_start = level.runs.size();
+        boxes.for_each_run(uint32_t(b), [&](size_t first, size_t count) { level.push_run(uint32_t(first), count, row_start); });
+        level.row_starts.push_back(level.runs.size());
+    }
+    std::vector<glm::vec4> box_vertices;
+    std::vector<GLuint>    box_indices;
+    gcode::buildVisibilityBoxes(box_coords, 0, box_coords.size(), box_vertices, box_indices);
+
+    Header header{};
+    std::memcpy(header.magic, Magic, sizeof(Magic));
+    header.version            = Version;
+    header.key                = key;
+    header.points_count       = columns.count;
+    header.boxes_count        = box_coords.size();
+    header.box_runs_count     = level.runs.size();
+    header.box_segments_count = level.memberships;
+    header.valid_blocks_count = valid_lines.blocks.size();
+    header.preprocessing_ms   = preprocessing_ms;
+    header.voxel_size         = config::voxel_size;
+    header.content_hash       = content;
+    const Layout layout(header);
+
+    const void *sections[Layout::Count] = {columns.position.data(),   columns.flags.data(),  columns.height.data(),
+                                           columns.width.data(),      height_width_angle.data(), valid_lines.blocks.data(),
+                                           box_coords.data(),         level.row_starts.data(), level.runs.data(),
+                                           level.run_lengths.data(),  box_vertices.data(),     box_indices.data()};
+
+    std::error_code error;
+    std::filesystem::create_directories(cache_directory(), error);
+    const std::filesystem::path filename = cache_filename(key);
+    std::filesystem::path       partial  = filename;
+    partial += ".partial";
+    {
+        std::ofstream file(partial, std::ios::binary);
+        if (!file) {
+            std::cerr << "Cannot write scene cache " << partial << std::endl;
+            return false;
+        }
+        file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        const char padding[Alignment] = {};
+        for (int s = 0; s < Layout::Count; ++s) {
+            file.write(padding, std::streamsize(layout.offsets[s] - uint64_t(file.tellp())));
+            file.write(static_cast<const char *>(sections[s]), std::streamsize(layout.sizes[s]));
+        }
+        file.write(padding, std::streamsize(layout.file_size - uint64_t(file.tellp())));
+        if (!file) {
+            std::cerr << "Error writing scene cache " << partial << std::endl;
+            file.close();
+            std::filesystem::remove(partial, error);
+            return false;
+        }
+    }
+    std::filesystem::rename(partial, filename, error);
+    return !error;
+}
+
+// Memory mapped cache file of a preprocessed scene
+class SceneFile
+{
+public:
+    // Maps the cache file of the key, returns false on a miss or when the file is not valid
+    bool open(uint64_t key)
+    {
+        m_file.close();
+        if (!m_file.open(cache_filename(key).string()))
+            return false;
+        if (m_file.size() < Header_Size) {
+            m_file.close();
+            return false;
+        }
+        std::memcpy(&m_header, m_file.data(), sizeof(m_header));
+        if (std::memcmp(m_header.magic, Magic, sizeof(Magic)) != 0 || m_header.version != Version || m_header.key != key ||
+            m_header.valid_blocks_count != bitset::BitSet<>(size_t(m_header.points_count)).blocks.size() ||
+            Layout(m_header).file_size > m_file.size()) {
+            std::cerr << "Ignoring invalid scene cache " << cache_filename(key) << std::endl;
+            m_file.close();
+            return false;
+        }
+        return true;
+    }
+
+    double preprocessing_ms() const { return m_header.preprocessing_ms; }
+
+    // Voxel size the boxes of the scene were built with
+    float voxel_size() const { return m_header.voxel_size; }
+
+    // Hash of the content of the input the scene was preprocessed from
+    uint64_t content_hash() const { return m_header.content_hash; }
+
+    // Copy of the cached core columns
+    gcode::PathStore columns() const
+    {
+        gcode::PathStore columns;
+        columns.count = size_t(m_header.points_count);
+        const Layout::Section sections[] = {Layout::Positions, Layout::Flags, Layout::Heights, Layout::Widths};
+        const gcode::Column   cached[]   = {gcode::Column::Position, gcode::Column::Flags, gcode::Column::Height, gcode::Column::Width};
+        for (size_t c = 0; c < std::size(cached); ++c)
+            std::memcpy(columns.resize_column(cached[c]), section<char>(sections[c]), columns.count * gcode::PathStore::element_size(cached[c]));
+        return columns;
+    }
+
+    // Creates the buffered path from the cached data, the GPU buffers are filled straight from the mapping
+    gcode::BufferedPath upload() const
+    {
+        const size_t count       = size_t(m_header.points_count);
+        const size_t boxes_count = size_t(m_header.boxes_count);
+
+        gcode::BufferedPath path = gcode::createBufferedPath();
+        path.valid_lines_bitset  = bitset::BitSet<>(count);
+        std::memcpy(path.valid_lines_bitset.blocks.data(), section<uint64_t>(Layout::ValidBlocks), m_header.valid_blocks_count * sizeof(uint64_t));
+        path.visible_lines_bitset = bitset::BitSet<std::atomic_size_t>(count);
+        path.visible_lines_bitset.clear();
+
+        // box 0 is the empty box createBufferedPath added
+        const glm::ivec3 *box_coords   = section<glm::ivec3>(Layout::BoxCoords);
+        const uint64_t   *box_offsets     = section<uint64_t>(Layout::BoxOffsets);
+        const uint32_t   *box_runs        = section<uint32_t>(Layout::BoxRuns);
+        const uint8_t    *box_run_lengths = section<uint8_t>(Layout::BoxRunLengths);
+        path.visibility_box_coords.assign(box_coords, box_coords + boxes_count);
+        path.visibility_box_ids.reserve(boxes_count);
+        for (size_t b = 1; b < boxes_count; ++b) path.visibility_box_ids.emplace(box_coords[b], uint32_t(b));
+        if (m_header.box_runs_count > 0) {
+            gcode::BoxSegmentIndex::Level level;
+            level.end_segment = count > 0 ? count - 1 : 0;
+            level.row_starts.assign(box_offsets, box_offsets + boxes_count + 1);
+            level.runs.assign(box_runs, box_runs + m_header.box_runs_count);
+            level.run_lengths.assign(box_run_lengths, box_run_lengths + m_header.box_runs_count);
+            level.memberships = size_t(m_header.box_segments_count);
+            path.visibility_box_segments.levels.push_back(std::move(level));
+        }
+        if (boxes_count > 1)
+            gcode::uploadVisibilityBoxes(path, boxes_count, section<glm::vec4>(Layout::BoxVertices) + Box_Vertices,
+                                         section<GLuint>(Layout::BoxIndices) + Box_Indices);
+
+        glBindVertexArray(gcode::gcodeVAO);
+        gcode::upload_positions(path, Span<const glm::vec3>(section<glm::vec3>(Layout::Positions), count), 0);
+        gcode::upload_height_width_angle(path, Span<const glm::vec3>(section<glm::vec3>(Layout::HeightWidthAngle), count), 0);
+        glBindVertexArray(0);
+
+        path.total_points_count = count;
+        return path;
+    }
+
+private:
+    template<typename T> const T *section(Layout::Section s) const
+    {
+        return reinterpret_cast<const T *>(m_file.data() + Layout(m_header).offsets[s]);
+    }
+
+    loader::MappedFile m_file;
+    Header             m_header{};
+};
+
+// Removes the cache file of the key when the content of the input file is not the one it was written from anymore. A file
+// rewritten with the same size, modification time and edges keeps the key of its former content, only this catches it.
+// Returns true when the content is the same.
+static bool check_content(const std::string &filename, uint64_t key, uint64_t content)
+{
+    if (file_content_hash(filename) == content)
+        return true;
+    std::cerr << "The content of " << filename << " changed since its scene cache was written, the cache is removed" << std::endl;
+    std::error_code error;
+    std::filesystem::remove(cache_filename(key), error);
+    return false;
+}
+
+} // namespace scene_cache
+
+#endif /* SCENE_CACHE_H_ */
@@ -9,6 +9,8 @@
 
 namespace shaderProgram {
 GLuint gcode_v_shader, gcode_f_shader, gcode_program;
+// the gcode program reading the segment records, 0 without OpenGL 4.3
+GLuint gcode_records_v_shader, gcode_records_program = 0;
 
 GLuint visibility_v_shader, visibility_f_shader, visibility_program;
 
@@ -48,10 +50,13 @@ bool check_program(GLuint id, GLenum st) {
 	return (status == GL_TRUE);
 }
 
-void loadAndCompileShader(const std::string& source, GLuint& destination, GLenum type) {
+// A header given replaces the #version line of the source
+void loadAndCompileShader(const std::string& source, GLuint& destination, GLenum type, const std::string& header = "") {
 	std::ifstream shaderSource(source);
 	std::string shaderCode;
 	getline(shaderSource, shaderCode, (char) shaderSource.eof());
+	if (!header.empty())
+		shaderCode = header + shaderCode.substr(shaderCode.find('\n') + 1);
 	const char *shaderCodeCString = shaderCode.data();
 
 	destination = glCreateShader(type);
@@ -77,6 +82,21 @@ void createGCodeProgram() {
 		exit(-1);
 }
 
+// The gcode vertex shader with SEGMENT_RECORDS defined, it needs GLSL 4.30 for the shader storage buffer
+void createGCodeRecordsProgram() {
+	if (!GLAD_GL_VERSION_4_3)
+		return;
+	loadAndCompileShader(shaders_path + "gcode_shaders/v_shader.glsl", gcode_records_v_shader,
+	GL_VERTEX_SHADER, "#version 430\n#define SEGMENT_RECORDS\n");
+
+	gcode_records_program = glCreateProgram();
+	glAttachShader(gcode_records_program, gcode_records_v_shader);
+	glAttachShader(gcode_records_program, gcode_f_shader);
+	glLinkProgram(gcode_records_program);
+	if (!check_program(gcode_records_program, GL_LINK_STATUS))
+		exit(-1);
+}
+
 void createVisibilityProgram() {
 	loadAndCompileShader(shaders_path + "gcode_shaders/visibility_v_shader.glsl", visibility_v_shader,
 	GL_VERTEX_SHADER);
@@ -0,0 +1,50 @@
+#ifndef SPAN_H_
+#define SPAN_H_
+
+#include <cassert>
+#include <cstddef>
+#include <type_traits>
+
+// Non-owning view over a contiguous range of elements (std::span is C++20).
+template<typename T>
+class Span
+{
+public:
+    Span() = default;
+    Span(T *data, size_t size) : m_data(data), m_size(size) {}
+
+    // Any container exposing data() and size(), e.g. std::vector
+    template<typename Container, typename = std::enable_if_t<!std::is_same_v<std::decay_t<Container>, Span>>>
+    Span(Container &container) : m_data(container.data()), m_size(container.size())
+    {}
+
+    // Span<T> -> Span<const T>
+    template<typename U, typename = std::enable_if_t<std::is_same_v<const U, T>>>
+    Span(const Span<U> &other) : m_data(other.data()), m_size(other.size())
+    {}
+
+    T     *data() const { return m_data; }
+    size_t size() const { return m_size; }
+    bool   empty() const { return m_size == 0; }
+
+    T *begin() const { return m_data; }
+    T *end() const { return m_data + m_size; }
+
+    T &operator[](size_t index) const
+    {
+        assert(index < m_size);
+        return m_data[index];
+    }
+
+    Span subspan(size_t offset, size_t count) const
+    {
+        assert(offset + count <= m_size);
+        return Span(m_data + offset, count);
+    }
+
+private:
+    T     *m_data{nullptr};
+    size_t m_size{0};
+};
+
+#endif /* SPAN_H_ */
@@ -0,0 +1,343 @@
+#ifndef STREAMING_H_
+#define STREAMING_H_
+
+#include "async_reader.h"
+#include "bgcode.h"
+#include "container.h"
+#include "gcode.h"
+#include "live.h"
+#include "loader.h"
+#include "parser.h"
+#include "span.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Progressive loading: a background thread reads the file in batches which the render loop picks up with poll(),
+// so the first layers are on screen long before the whole file is in memory. A live stream receives the points
+// another process writes into a shared memory ring instead. The reading waits while Max_Pending_Batches are not
+// picked up yet, and poll() picks up one batch per frame, so that every frame indexes a batch at most.
+//
+// With config::auto_voxel_size the voxel size is tuned on a sample of the input made before the first batch is handed
+// out, the same for every run: legacy dumps and path containers from Tune_Runs runs of Tune_Run_Points points spread
+// evenly over the file, G-code from its first Tune_Prefix_Bytes of text, both extrapolated to the size of the file, a
+// live stream from its first Tune_Live_Points points.
+namespace streaming {
+
+static const size_t Default_Batch_Points = size_t(1) << 20;
+static const size_t Max_Pending_Batches  = 4;
+static const size_t Tune_Prefix_Bytes    = size_t(32) << 20;
+static const size_t Tune_Runs            = 8;
+static const size_t Tune_Run_Points      = size_t(1) << 18;
+static const size_t Tune_Live_Points     = size_t(1) << 18;
+
+class PathStream
+{
+public:
+    ~PathStream() { stop(); }
+
+    // Starts reading the file in the background. Path containers, binary G-code, G-code and legacy dumps are supported.
+    // Path containers only read the columns in the mask, the other columns of the points are zero.
+    bool open(const std::string &filename, size_t batch_points = Default_Batch_Points, unsigned int columns_mask = gcode::All_Columns)
+    {
+        stop();
+        m_pending.clear();
+        m_columns_mask = columns_mask;
+        m_finished     = false;
+        m_cancel       = false;
+        m_batch_points = std::max<size_t>(batch_points, 1);
+        m_tune         = config::auto_voxel_size;
+        m_voxel_sample = gcode::VoxelSample();
+
+        if (container::is_container(filename)) {
+            if (!m_container.open(filename))
+                return false;
+            m_worker = std::thread([this]() { read_container(); });
+        } else if (bgcode::is_bgcode_file(filename)) {
+            if (!m_file.open(filename) || !bgcode::read_structure(m_file.data(), m_file.size(), m_bgcode)) {
+                std::cerr << "Error opening file: " << filename << std::endl;
+                m_file.close();
+                return false;
+            }
+            m_worker = std::thread([this]() { parse_bgcode(); });
+        } else if (parser::is_gcode_file(filename)) {
+            // the prefix the voxel size is tuned on is parsed from a mapping of the file
+            if (!m_reader.open(filename, parser::read_block_size()) || (m_tune && !m_file.open(filename)))
+                return false;
+            m_worker = std::thread([this]() { parse_gcode(); });
+        } else {
+            if (!m_dump.open(filename))
+                return false;
+            m_worker = std::thread([this]() { read_dump(); });
+        }
+        return true;
+    }
+
+    // Creates the shared memory ring of the given name and receives the points a producer process writes into it
+    bool open_live(const std::string &name, size_t batch_points = Default_Batch_Points)
+    {
+        stop();
+        m_pending.clear();
+        m_columns_mask = gcode::All_Columns;
+        m_finished     = false;
+        m_cancel       = false;
+        m_batch_points = std::max<size_t>(batch_points, 1);
+        m_tune         = config::auto_voxel_size;
+        m_voxel_sample = gcode::VoxelSample();
+
+        if (!m_live.create(name))
+            return false;
+        m_worker = std::thread([this]() { receive_live(); });
+        return true;
+    }
+
+    // Appends the oldest batch read and not picked up yet to the loaded columns, returns true if there was one
+    bool poll(gcode::PathStore &columns)
+    {
+        Batch batch;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (m_pending.empty())
+                return false;
+            batch = std::move(m_pending.front());
+            m_pending.pop_front();
+        }
+        m_drained.notify_one();
+        if (batch.columns.count > 0)
+            columns.append(batch.columns);
+        else
+            columns.append(batch.span());
+        return true;
+    }
+
+    // Sample of the input to tune the voxel size on, complete once poll() picked up a batch
+    const gcode::VoxelSample &voxel_sample() const { return m_voxel_sample; }
+
+    // True once the whole file was read and poll() picked up all of it
+    bool finished() const
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_finished && m_pending.empty();
+    }
+
+    void stop()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_cancel = true;
+        }
+        m_drained.notify_all();
+        if (m_worker.joinable())
+            m_worker.join();
+        m_file.close();
+        m_reader.close();
+    }
+
+private:
+    // Points read by the worker, a view of the mapped dump, or rows of the columns of a path container
+    struct Batch
+    {
+        std::vector<gcode::PathPoint> points;
+        Span<const gcode::PathPoint>  view;
+        gcode::PathStore              columns;
+
+        Span<const gcode::PathPoint> span() const { return points.empty() ? view : Span<const gcode::PathPoint>(points); }
+        bool                         empty() const { return span().empty() && columns.count == 0; }
+    };
+
+    // Hands the batch to poll(), waits while Max_Pending_Batches are pending
+    void publish(Batch &&batch)
+    {
+        if (batch.empty())
+            return;
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_drained.wait(lock, [this]() { return m_pending.size() < Max_Pending_Batches || m_cancel; });
+        if (!m_cancel)
+            m_pending.push_back(std::move(batch));
+    }
+
+    void publish(std::vector<gcode::PathPoint> &&points) { publish(Batch{std::move(points), {}, {}}); }
+
+    // The rows are handed out as columns, they are appended to the loaded columns without going through PathPoint
+    void read_container()
+    {
+        gcode::PathStore columns;
+        const size_t     total = m_container.points_count();
+        if (m_tune) {
+            sample_runs(total, [&](size_t first, size_t count) {
+                if (m_container.load_rows(columns, gcode::column_bit(gcode::Column::Position) | gcode::column_bit(gcode::Column::Flags), first, count))
+                    m_voxel_sample.add(columns.view<gcode::Column::Position>(), columns.view<gcode::Column::Flags>());
+            });
+        }
+        for (size_t first = 0; first < total && !m_cancel; first += m_batch_points) {
+            const size_t count = std::min(m_batch_points, total - first);
+            if (!m_container.load_rows(columns, m_columns_mask, first, count) && first == 0)
+                std::cerr << "Some columns are missing in the path container" << std::endl;
+            publish(Batch{{}, {}, std::move(columns)});
+            columns = {};
+        }
+        m_finished = true;
+    }
+
+    // Samples Tune_Runs runs of Tune_Run_Points of the total points spread evenly from the first to the last one, all the
+    // points when there are not more. add(first, count) adds the points of a run to the sample.
+    template <typename Add> void sample_runs(size_t total, Add &&add)
+    {
+        const bool   whole = total <= Tune_Runs * Tune_Run_Points;
+        const size_t runs = whole ? 1 : Tune_Runs, count = whole ? total : Tune_Run_Points;
+        m_voxel_sample    = gcode::VoxelSample(runs * count);
+        for (size_t run = 0; run < runs && !m_cancel; ++run) {
+            add(whole ? 0 : (total - count) * run / (runs - 1), count);
+            m_voxel_sample.break_path();
+        }
+        m_voxel_sample.scale = m_voxel_sample.points() > 0 ? double(total) / double(m_voxel_sample.points()) : 1.0;
+    }
+
+    // Samples the points of the complete lines of the first Tune_Prefix_Bytes of the text, of total_size bytes in all
+    void sample_prefix(const char *text, size_t size, size_t total_size)
+    {
+        size_t prefix = std::min(size, Tune_Prefix_Bytes);
+        if (prefix < total_size)
+            while (prefix > 0 && text[prefix - 1] != '\n') --prefix;
+        parser::StreamParser          parser;
+        std::vector<gcode::PathPoint> points;
+        parser.parse(text, prefix, points);
+        parser.finish(points);
+        m_voxel_sample = gcode::VoxelSample(points.size());
+        m_voxel_sample.add(points);
+        m_voxel_sample.scale = prefix > 0 ? double(total_size) / double(prefix) : 1.0;
+    }
+
+    void parse_gcode()
+    {
+        if (m_tune) {
+            sample_prefix(m_file.data(), m_file.size(), m_file.size());
+            m_file.close();
+        }
+        // every block is parsed by all the threads while the next ones are read, the last point of a block waits for the next one
+        std::vector<gcode::PathPoint> batch;
+        parser::parse_blocks(m_reader, batch, [this](std::vector<gcode::PathPoint> &points) {
+            publish(std::move(points));
+            points.clear();
+            return !m_cancel;
+        });
+        m_finished = true;
+    }
+
+    void parse_bgcode()
+    {
+        // every wave decodes enough blocks to keep all the threads busy, a line cut by a block boundary is completed
+        // by the next wave
+        const size_t                  wave_size = parser::Default_Chunk_Size * std::max(1u, std::thread::hardware_concurrency());
+        parser::StreamParser          parser;
+        std::vector<gcode::PathPoint> batch;
+        std::string                   text;
+        bool                          parsed = false;
+        if (m_tune) {
+            size_t last = 0, prefix = 0, total = 0;
+            for (const bgcode::Block &block : m_bgcode.blocks) total += block.uncompressed_size;
+            while (last < m_bgcode.blocks.size() && prefix < Tune_Prefix_Bytes) prefix += m_bgcode.blocks[last++].uncompressed_size;
+            if (bgcode::decode_gcode(m_file.data(), m_bgcode, 0, last, text))
+                sample_prefix(text.data(), text.size(), total);
+            text.clear();
+        }
+        for (size_t first = 0; first < m_bgcode.blocks.size() && !m_cancel;) {
+            size_t last = first, bytes = 0;
+            while (last < m_bgcode.blocks.size() && bytes < wave_size) bytes += m_bgcode.blocks[last++].uncompressed_size;
+            if (!bgcode::decode_gcode(m_file.data(), m_bgcode, first, last, text))
+                break;
+            first = last;
+
+            const size_t complete = last == m_bgcode.blocks.size() ? text.size() : text.rfind('\n') + 1;
+            if (complete == 0) // no complete line yet, npos + 1 wraps to 0 as well
+                continue;
+            batch.clear();
+            parser.parse(text.data(), complete, batch);
+            publish(std::move(batch));
+            text.erase(0, complete);
+            parsed = true;
+        }
+        if (!m_cancel && parsed) {
+            batch.clear();
+            parser.finish(batch);
+            publish(std::move(batch));
+        }
+        m_finished = true;
+    }
+
+    // The batches are views of the mapped records, no copy of them is made
+    void read_dump()
+    {
+        const Span<const gcode::PathPoint> points = m_dump.points();
+        if (m_tune)
+            sample_runs(points.size(), [&](size_t first, size_t count) { m_voxel_sample.add(points.subspan(first, count)); });
+        for (size_t first = 0; first < points.size() && !m_cancel; first += m_batch_points)
+            publish(Batch{{}, points.subspan(first, std::min(m_batch_points, points.size() - first)), {}});
+        m_finished = true;
+    }
+
+    // Without a size to extrapolate to, the points received are held back until the first Tune_Live_Points of them are
+    // sampled, or the producer finished
+    void receive_live()
+    {
+        std::vector<gcode::PathPoint> batch, prefix;
+        bool                          tuned = !m_tune;
+        auto                          tune  = [&]() {
+            const size_t sampled = std::min(prefix.size(), Tune_Live_Points);
+            m_voxel_sample       = gcode::VoxelSample(sampled);
+            m_voxel_sample.add(Span<const gcode::PathPoint>(prefix.data(), sampled));
+            for (size_t first = 0; first < prefix.size(); first += m_batch_points)
+                publish(std::vector<gcode::PathPoint>(prefix.begin() + first, prefix.begin() + std::min(prefix.size(), first + m_batch_points)));
+            prefix = {};
+            tuned  = true;
+        };
+        while (!m_cancel) {
+            batch.clear();
+            if (m_live.read(batch, m_batch_points) > 0) {
+                if (tuned) {
+                    publish(std::move(batch));
+                    continue;
+                }
+                prefix.insert(prefix.end(), batch.begin(), batch.end());
+                if (prefix.size() >= Tune_Live_Points)
+                    tune();
+                continue;
+            }
+            if (m_live.finished())
+                break;
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        if (!tuned)
+            tune();
+        m_finished = true;
+    }
+
+    size_t                        m_batch_points{Default_Batch_Points};
+    container::Reader             m_container;
+    loader::MappedFile            m_file;
+    async_reader::BlockReader     m_reader;
+    bgcode::FileInfo              m_bgcode;
+    loader::PathPointsFile        m_dump;
+    live::RingConsumer            m_live;
+    gcode::VoxelSample            m_voxel_sample;
+    bool                          m_tune{false};
+    std::thread                   m_worker;
+    mutable std::mutex            m_mutex;
+    std::condition_variable       m_drained; // poll() picked up a batch
+    std::deque<Batch>             m_pending;
+    unsigned int                  m_columns_mask{gcode::All_Columns};
+    std::atomic<bool>             m_finished{false};
+    std::atomic<bool>             m_cancel{false};
+};
+
+} // namespace streaming
+
+#endif /* STREAMING_H_ */
@@ -0,0 +1,25 @@
+// Converts a legacy PathPoint dump (size_t count + raw PathPoint records) into the columnar path container.
+//
+// usage: convert_dump <legacy_dump> <output_container>
+
+#include "../container.h"
+#include "../loader.h"
+
+int main(int argc, char *argv[])
+{
+    if (argc < 3) {
+        std::cout << "usage: convert_dump <legacy_dump> <output_container>" << std::endl;
+        return 1;
+    }
+
+    loader::PathPointsFile input;
+    if (!input.open(argv[1]))
+        return 1;
+
+    const gcode::PathStore columns = gcode::to_columns(input.points());
+    if (!container::write(argv[2], columns))
+        return 1;
+
+    std::cout << "Converted " << columns.count << " points to " << argv[2] << std::endl;
+    return 0;
+}
@@ -0,0 +1,70 @@
+// Replays a path into the shared memory ring of a viewer started with --live, as a slicer generating G-code would.
+// Batches are written at the given rate (0 writes as fast as the viewer consumes them), the achieved throughput
+// and the time spent waiting on a full ring are reported.
+//
+// usage: live_producer <input> [points_per_second] [batch_points] [ring_name]
+
+#include "../bgcode.h"
+#include "../container.h"
+#include "../live.h"
+#include "../loader.h"
+#include "../parser.h"
+
+#include <chrono>
+#include <thread>
+
+int main(int argc, char *argv[])
+{
+    if (argc < 2) {
+        std::cout << "usage: live_producer <input> [points_per_second] [batch_points] [ring_name]" << std::endl;
+        return 1;
+    }
+    const std::string filename          = argv[1];
+    const double      points_per_second = argc > 2 ? std::stod(argv[2]) : 0.0;
+    const size_t      batch_points      = argc > 3 ? std::max<size_t>(std::stoul(argv[3]), 1) : 10000;
+    const std::string name              = argc > 4 ? argv[4] : live::Default_Name;
+
+    loader::PathPointsFile        points_file;
+    std::vector<gcode::PathPoint> loaded_points;
+    Span<const gcode::PathPoint>  points;
+    if (container::is_container(filename)) {
+        gcode::PathStore columns;
+        if (!container::read(filename, columns))
+            return 1;
+        loaded_points = gcode::to_path_points(columns);
+        points        = loaded_points;
+    } else if (bgcode::is_bgcode_file(filename)) {
+        loaded_points = bgcode::parse_file(filename);
+        points        = loaded_points;
+    } else if (parser::is_gcode_file(filename)) {
+        loaded_points = parser::parse_file(filename);
+        points        = loaded_points;
+    } else {
+        if (!points_file.open(filename))
+            return 1;
+        points = points_file.points();
+    }
+
+    // the viewer owns the ring, it may not be running yet
+    live::RingProducer ring;
+    std::cout << "Waiting for the ring " << name << std::endl;
+    while (!ring.open(name)) std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    std::cout << "Replaying " << points.size() << " points into a ring of " << ring.capacity() << " points" << std::endl;
+
+    using clock      = std::chrono::steady_clock;
+    const auto start = clock::now();
+    double     waited_ms = 0.0;
+    for (size_t first = 0; first < points.size(); first += batch_points) {
+        const size_t count = std::min(batch_points, points.size() - first);
+        if (points_per_second > 0.0)
+            std::this_thread::sleep_until(start + std::chrono::duration_cast<clock::duration>(std::chrono::duration<double>(double(first) / points_per_second)));
+        waited_ms += ring.write(points.subspan(first, count));
+    }
+    ring.finish();
+
+    const double elapsed_ms = std::chrono::duration<double, std::milli>(clock::now() - start).count();
+    std::printf("%zu points in %.2f ms: %.0f points/s, %.1f MB/s, %.2f ms waiting on a full ring\n", points.size(), elapsed_ms,
+                double(points.size()) / (elapsed_ms / 1000.0), double(points.size() * sizeof(gcode::PathPoint)) / (1024.0 * 1024.0) / (elapsed_ms / 1000.0),
+                waited_ms);
+    return 0;
+}
@@ -0,0 +1,194 @@
+// Checks that the packed heights, widths and angles (--pack), and optionally the quantized positions (--quantize),
+// keep the rendered geometry within a tolerance. The vertex positions of every drawn segment are computed the way
+// v_shader.glsl computes them, once from the float attributes and once from the decoded compact ones, for a few
+// cameras around the scene, and the largest distance between the two is reported.
+//
+// The shader picks an outline of the segment from the camera: which end is close, which sides face the camera and
+// whether the view is horizontal or vertical. Close to a threshold of these choices the two encodings may pick
+// differently, and the vertex then moves by up to a width or a height. Such vertices are counted apart with their own
+// largest distance, and the check fails when more than a fraction of the vertices change outline, 0.1% by default.
+//
+// vertex_position() is a copy of main() of v_shader.glsl, nothing keeps the two in step: a change of the geometry in
+// the shader must be made here too.
+//
+// usage: validate_packing <path_file> [tolerance_mm] [--quantize[=step_mm]] [--max-outline-changes=fraction]
+
+#include "../scene.h"
+
+#include <atomic>
+#include <mutex>
+
+namespace {
+
+const glm::vec2 Horizontal_Vertical_View_Signs[16] = {
+    // horizontal view
+    {1.0f, 0.0f}, {0.0f, 1.0f}, {-1.0f, 0.0f}, {0.0f, -1.0f}, {0.0f, -1.0f}, {1.0f, 0.0f}, {0.0f, 1.0f}, {0.0f, 1.0f},
+    // vertical view
+    {0.0f, 1.0f}, {-1.0f, 0.0f}, {0.0f, -1.0f}, {1.0f, 0.0f}, {1.0f, 0.0f}, {0.0f, 1.0f}, {-1.0f, 0.0f}, {-1.0f, 0.0f}};
+
+struct Vertex
+{
+    glm::vec3    position;
+    unsigned int outline; // the choices of main(), the side signs take two bits
+};
+
+// main() of v_shader.glsl for the segment a -> b, copied from the shader which has to be kept in step with it
+Vertex vertex_position(glm::vec3 pos_a, glm::vec3 pos_b, glm::vec3 hwa_a, glm::vec3 hwa_b, int vertex_id, glm::vec3 camera_position)
+{
+    const glm::vec3 up(0.0f, 0.0f, 1.0f);
+    const glm::vec3 line   = pos_b - pos_a;
+    const glm::vec3 view_a = pos_a - camera_position;
+    const glm::vec3 view_b = pos_b - camera_position;
+
+    const float     line_len  = glm::length(line);
+    const glm::vec3 line_dir  = line_len < 1e-4f ? glm::vec3(1.0f, 0.0f, 0.0f) : line / line_len;
+    const glm::vec3 right_dir = std::abs(glm::dot(line_dir, up)) > 0.9f ? glm::normalize(glm::cross(glm::vec3(1.0f, 0.0f, 0.0f), line_dir))
+                                                                        : glm::normalize(glm::cross(line_dir, up));
+    const glm::vec3 up_dir = glm::normalize(glm::cross(right_dir, line_dir));
+
+    const float dir_sign = glm::sign(glm::dot(view_b, view_b) - glm::dot(view_a, view_a));
+    const bool  a_close  = !(dir_sign < 0.0f);
+    const bool  a_final  = vertex_id < 4 ? a_close : !a_close;
+
+    const glm::vec3 camera_view_dir          = glm::normalize((a_close ? pos_a : pos_b) - camera_position);
+    const glm::vec3 close_height_width_angle = a_close ? hwa_a : hwa_b;
+    const glm::vec3 diagonal_dir_border      = glm::normalize(close_height_width_angle.x * up_dir + close_height_width_angle.y * right_dir);
+    const bool      vertical_view            = std::abs(glm::dot(camera_view_dir, up_dir)) / std::abs(glm::dot(diagonal_dir_border, up_dir)) >
+                                 std::abs(glm::dot(camera_view_dir, right_dir)) / std::abs(glm::dot(diagonal_dir_border, right_dir));
+
+    const glm::vec2 signs                    = Horizontal_Vertical_View_Signs[vertex_id + 8 * int(vertical_view)];
+    const glm::vec3 final_height_width_angle = a_final ? hwa_a : hwa_b;
+    const float     half_height              = 0.5f * final_height_width_angle.x;
+    const float     half_width               = 0.5f * final_height_width_angle.y;
+
+    const glm::vec3 horizontal_dir = half_width * right_dir * -glm::sign(glm::dot(view_a, right_dir));
+    const glm::vec3 vertical_dir   = half_height * up_dir * -glm::sign(glm::dot(view_a, up_dir));
+
+    const glm::vec3 segment_pos = a_final ? pos_a : pos_b;
+    glm::vec3       pos         = segment_pos + signs.x * horizontal_dir + signs.y * vertical_dir;
+    if (vertex_id == 2 || vertex_id == 7) {
+        const float line_dir_sign = a_final ? -1.0f : 1.0f;
+        pos = segment_pos + line_dir_sign * line_dir * final_height_width_angle.y * 0.5f * std::sin(final_height_width_angle.z * 0.5f);
+        pos += right_dir * final_height_width_angle.y * 0.5f * std::cos(final_height_width_angle.z * 0.5f);
+    }
+    const unsigned int outline = unsigned(a_close) | unsigned(vertical_view) << 1 | unsigned(glm::sign(glm::dot(view_a, right_dir)) + 1.0f) << 2 |
+                                 unsigned(glm::sign(glm::dot(view_a, up_dir)) + 1.0f) << 4;
+    return {pos, outline};
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    if (argc < 2) {
+        std::cout << "usage: validate_packing <path_file> [tolerance_mm] [--quantize[=step_mm]] [--max-outline-changes=fraction]" << std::endl;
+        return 1;
+    }
+    float  tolerance           = 0.005f;
+    bool   quantize            = false;
+    float  step                = config::position_precision;
+    double max_outline_changes = 0.001;
+    for (int i = 2; i < argc; ++i) {
+        const std::string argument = argv[i];
+        if (argument.rfind("--quantize", 0) == 0) {
+            quantize = true;
+            if (argument.size() > 11 && argument[10] == '=')
+                step = std::stof(argument.substr(11));
+        } else if (argument.rfind("--max-outline-changes=", 0) == 0) {
+            max_outline_changes = std::stod(argument.substr(22));
+        } else {
+            tolerance = std::stof(argument);
+        }
+    }
+
+    gcode::PathStore columns;
+    if (!scene::load_columns(argv[1], gcode::Core_Columns, columns) || columns.count < 2) {
+        std::cerr << "Cannot load a path from " << argv[1] << std::endl;
+        return 1;
+    }
+    const size_t count = columns.count;
+
+    // the attributes as the float path uploads them, and decoded from the compact encodings
+    std::vector<glm::vec3> height_width_angle(count), unpacked(count), positions(columns.position.begin(), columns.position.end());
+    float                  position_error = 0.0f;
+    for (size_t i = 0; i < count; ++i) {
+        height_width_angle[i] = gcode::point_height_width_angle(columns, i);
+        unpacked[i]           = gcode::unpack_height_width_angle(gcode::pack_height_width_angle(height_width_angle[i]));
+    }
+    if (quantize) {
+        const gcode::QuantizedPositions quantized = gcode::quantize_positions(columns.position, 0, step);
+        for (size_t i = 0; i < count; ++i) {
+            const glm::vec4 chunk = quantized.chunks[i / gcode::Position_Chunk_Points];
+            const uint16_t *o     = &quantized.offsets[3 * i];
+            positions[i]          = glm::vec3(chunk) + chunk.w * glm::vec3(float(o[0]), float(o[1]), float(o[2]));
+        }
+        position_error = quantized.max_error;
+    }
+
+    // cameras above the corners of the scene and one looking down on it, off the grid the coordinates of a print are on
+    glm::vec3 min(FLT_MAX), max(-FLT_MAX);
+    gcode::update_bounds(min, max, columns.position);
+    const glm::vec3              center = 0.5f * (min + max) + glm::vec3(0.37f, 0.61f, 0.0f);
+    const float                  size   = std::max(glm::length(max - min), 1.0f);
+    const std::vector<glm::vec3> cameras{center + glm::vec3(size, size, 0.5f * size), center + glm::vec3(-size, size, 0.5f * size),
+                                         center + glm::vec3(size, -size, 0.2f * size), center + glm::vec3(-size, -size, 0.2f * size),
+                                         center + glm::vec3(0.0f, 0.0f, size)};
+
+    std::vector<size_t> segments;
+    for (size_t i = 0; i + 1 < count; ++i)
+        if (gcode::extract_type_from_flags(columns.flags[i]) != 8)
+            segments.push_back(i);
+
+    std::mutex          mutex;
+    float               max_error = 0.0f, max_outline_error = 0.0f;
+    size_t              worst     = 0;
+    double              sum       = 0.0;
+    std::atomic<size_t> compared{0}, outline_changes{0};
+    std::for_each(std::execution::par, segments.begin(), segments.end(), [&](size_t i) {
+        float  segment_max = 0.0f, segment_outline_max = 0.0f;
+        double segment_sum = 0.0;
+        size_t segment_compared = 0, segment_changes = 0;
+        for (const glm::vec3 &camera : cameras) {
+            for (int vertex_id = 0; vertex_id < 8; ++vertex_id) {
+                const Vertex reference = vertex_position(columns.position[i], columns.position[i + 1], height_width_angle[i], height_width_angle[i + 1],
+                                                         vertex_id, camera);
+                const Vertex compact   = vertex_position(positions[i], positions[i + 1], unpacked[i], unpacked[i + 1], vertex_id, camera);
+                const float error = glm::length(reference.position - compact.position);
+                if (reference.outline != compact.outline) {
+                    segment_outline_max = std::max(segment_outline_max, error);
+                    ++segment_changes;
+                    continue;
+                }
+                segment_max       = std::max(segment_max, error);
+                segment_sum += error;
+                ++segment_compared;
+            }
+        }
+        compared += segment_compared;
+        outline_changes += segment_changes;
+        std::lock_guard<std::mutex> lock(mutex);
+        sum += segment_sum;
+        max_outline_error = std::max(max_outline_error, segment_outline_max);
+        if (segment_max > max_error) {
+            max_error = segment_max;
+            worst     = i;
+        }
+    });
+
+    const size_t float_bytes = count * (quantize ? 2 : 1) * sizeof(glm::vec3);
+    const size_t packed_bytes =
+        count * sizeof(uint32_t) + (quantize ? count * 3 * sizeof(uint16_t) + (count + gcode::Position_Chunk_Points - 1) / gcode::Position_Chunk_Points * sizeof(glm::vec4) : 0);
+    std::cout << count << " points, " << segments.size() << " drawn segments, " << cameras.size() << " cameras" << std::endl;
+    std::printf("packed height, width, angle%s: %.1f MB instead of %.1f MB\n", quantize ? " and quantized positions" : "",
+                double(packed_bytes) / (1024.0 * 1024.0), double(float_bytes) / (1024.0 * 1024.0));
+    if (quantize)
+        std::printf("position error %.4f mm with steps of %.4f mm\n", position_error, step);
+    std::printf("vertex error: max %.4f mm at segment %zu, mean %.5f mm over %zu vertices\n", max_error, worst, compared > 0 ? sum / double(compared) : 0.0,
+                size_t(compared));
+    const double outline_share = double(outline_changes) / double(std::max<size_t>(1, compared + outline_changes));
+    std::printf("%zu vertices with another outline (%.4f%%), moved by up to %.4f mm\n", size_t(outline_changes), 100.0 * outline_share, max_outline_error);
+    const bool within = max_error <= tolerance && outline_share <= max_outline_changes;
+    std::cout << "within " << tolerance << " mm, at most " << 100.0 * max_outline_changes << "% of the vertices with another outline: " << (within ? "yes" : "NO")
+              << std::endl;
+    return within ? 0 : 1;
+}